@@ -0,0 +1,387 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+#include "GlobalObject.h"
+#include "dataManagement/CorridorPlanner.h"
+#include "dataManagement/Downloadable_SingleFile.h"
+#include "navigation/FlightRoute.h"
+#include "navigation/Navigator.h"
+#include "positioning/PositionProvider.h"
+
+using namespace std::chrono_literals;
+using namespace Qt::Literals::StringLiterals;
+
+
+namespace {
+
+// Meters per degree of latitude
+constexpr double metersPerDegree = 111320.0;
+
+// Items that the planner prefetches and evicts. Raster maps are left out,
+// because they are very large and usually chosen deliberately.
+bool isManaged(DataManagement::Downloadable_Abstract* item)
+{
+    auto* singleFile = qobject_cast<DataManagement::Downloadable_SingleFile*>(item);
+    if ((singleFile == nullptr) || !singleFile->url().isValid() || !singleFile->boundingBox().isValid())
+    {
+        return false;
+    }
+    auto type = singleFile->contentType();
+    return (type == DataManagement::Downloadable_Abstract::AviationMap)
+           || (type == DataManagement::Downloadable_Abstract::BaseMapVector)
+           || (type == DataManagement::Downloadable_Abstract::TerrainMap);
+}
+
+// Total size of the files of an item
+qint64 fileSize(DataManagement::Downloadable_Abstract* item)
+{
+    qint64 result = 0;
+    foreach(auto fileName, item->files())
+    {
+        result += QFileInfo(fileName).size();
+    }
+    return result;
+}
+
+} // namespace
+
+
+DataManagement::CorridorPlanner::CorridorPlanner(DataManagement::Downloadable_MultiFile* items, DataManagement::DownloadScheduler* scheduler, QObject* parent)
+    : QObject(parent),
+    m_items(items),
+    m_scheduler(scheduler),
+    m_lastUsedFileName(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + u"/lastUsed.dat"_s)
+{
+    QSettings const settings;
+    m_autoPrefetch = settings.value(u"DataManager/autoPrefetch"_s, false).toBool();
+    m_diskQuota = settings.value(u"DataManager/diskQuota"_s, 0).toULongLong();
+    load();
+
+    m_routeTimer.setSingleShot(true);
+    m_routeTimer.setInterval(2s);
+    connect(&m_routeTimer, &QTimer::timeout, this, [this]() {
+        if (m_autoPrefetch)
+        {
+            prefetch();
+        }
+    });
+
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(10s);
+    connect(&m_saveTimer, &QTimer::timeout, this, &CorridorPlanner::save);
+
+    // Enforce the quota whenever the download queue runs empty
+    connect(m_scheduler, &DownloadScheduler::pendingChanged, this, [this]() {
+        if (m_scheduler->pending() == 0)
+        {
+            enforceQuota();
+        }
+    });
+}
+
+
+DataManagement::CorridorPlanner::~CorridorPlanner()
+{
+    if (m_saveTimer.isActive())
+    {
+        save();
+    }
+}
+
+
+void DataManagement::CorridorPlanner::start()
+{
+    connect(GlobalObject::navigator()->flightRoute(), &Navigation::FlightRoute::waypointsChanged, &m_routeTimer, qOverload<>(&QTimer::start));
+    m_positionNotifier = GlobalObject::positionProvider()->bindableApproximateLastValidCoordinate().addNotifier([this]() {
+        touch(downloadablesForPosition(GlobalObject::positionProvider()->approximateLastValidCoordinate()));
+    });
+    touch(downloadablesForPosition(GlobalObject::positionProvider()->approximateLastValidCoordinate()));
+    enforceQuota();
+}
+
+
+
+//
+// Setter Methods
+//
+
+void DataManagement::CorridorPlanner::setAutoPrefetch(bool autoPrefetch)
+{
+    if (autoPrefetch == m_autoPrefetch)
+    {
+        return;
+    }
+    m_autoPrefetch = autoPrefetch;
+    QSettings().setValue(u"DataManager/autoPrefetch"_s, m_autoPrefetch);
+    emit autoPrefetchChanged();
+    if (m_autoPrefetch)
+    {
+        prefetch();
+    }
+}
+
+
+void DataManagement::CorridorPlanner::setDiskQuota(Units::ByteSize quota)
+{
+    if (quota == m_diskQuota)
+    {
+        return;
+    }
+    m_diskQuota = quota;
+    QSettings().setValue(u"DataManager/diskQuota"_s, QVariant::fromValue<qulonglong>(m_diskQuota));
+    emit diskQuotaChanged();
+    enforceQuota();
+}
+
+
+
+//
+// Methods
+//
+
+QVector<DataManagement::Downloadable_Abstract*> DataManagement::CorridorPlanner::downloadablesForRoute()
+{
+    if (m_items.isNull())
+    {
+        return {};
+    }
+    auto corridor = routeCorridor();
+    if (corridor.isEmpty())
+    {
+        return {};
+    }
+
+    QVector<DataManagement::Downloadable_Abstract*> result;
+    foreach(auto item, m_items->downloadables())
+    {
+        if (!isManaged(item))
+        {
+            continue;
+        }
+        auto bBox = item->boundingBox();
+        if (std::any_of(corridor.cbegin(), corridor.cend(), [&bBox](const QGeoRectangle& rect) { return bBox.intersects(rect); }))
+        {
+            result << item;
+        }
+    }
+    return result;
+}
+
+
+void DataManagement::CorridorPlanner::enforceQuota()
+{
+    if ((m_diskQuota == 0) || m_items.isNull())
+    {
+        return;
+    }
+
+    // Total size of all installed items, including those that are never
+    // evicted
+    qint64 total = 0;
+    QVector<DataManagement::Downloadable_Abstract*> candidates;
+    foreach(auto item, m_items->downloadables())
+    {
+        if (!item->hasFile())
+        {
+            continue;
+        }
+        total += fileSize(item);
+        if (isManaged(item) && !item->downloading())
+        {
+            candidates << item;
+        }
+    }
+    if (total <= qint64(m_diskQuota))
+    {
+        return;
+    }
+
+    // Maps in use are never evicted
+    auto inUse = downloadablesForRoute();
+    inUse += downloadablesForPosition(GlobalObject::positionProvider()->approximateLastValidCoordinate());
+
+    std::sort(candidates.begin(), candidates.end(), [this](Downloadable_Abstract* first, Downloadable_Abstract* second) {
+        return lastUsed(first) < lastUsed(second);
+    });
+    foreach(auto item, candidates)
+    {
+        if (total <= qint64(m_diskQuota))
+        {
+            break;
+        }
+        if (inUse.contains(item))
+        {
+            continue;
+        }
+        total -= fileSize(item);
+        m_lastUsed.remove(qobject_cast<Downloadable_SingleFile*>(item)->fileName());
+        item->deleteFiles();
+    }
+    m_saveTimer.start();
+}
+
+
+void DataManagement::CorridorPlanner::prefetch()
+{
+    if (m_scheduler.isNull())
+    {
+        return;
+    }
+    auto items = downloadablesForRoute();
+    touch(items);
+    foreach(auto item, items)
+    {
+        if (!item->hasFile())
+        {
+            m_scheduler->enqueue(item, DownloadScheduler::Download);
+        }
+    }
+}
+
+
+
+//
+// Private Methods
+//
+
+QList<QGeoRectangle> DataManagement::CorridorPlanner::routeCorridor()
+{
+    auto geoPath = GlobalObject::navigator()->flightRoute()->geoPath();
+
+    // Sample each leg at intervals of the corridor half width and cover each
+    // sample point with a square. The squares overlap, so that the union
+    // covers the corridor.
+    QList<QGeoRectangle> result;
+    auto cover = [&result](const QGeoCoordinate& point) {
+        auto dLat = corridorHalfWidthInM/metersPerDegree;
+        auto dLon = dLat/qMax(0.01, std::cos(qDegreesToRadians(point.latitude())));
+        result << QGeoRectangle(QGeoCoordinate(qMin(90.0, point.latitude()+dLat), qMax(-180.0, point.longitude()-dLon)),
+                                QGeoCoordinate(qMax(-90.0, point.latitude()-dLat), qMin(180.0, point.longitude()+dLon)));
+    };
+    for(qsizetype i = 0; i < geoPath.size(); i++)
+    {
+        const auto& start = geoPath.at(i);
+        cover(start);
+        if (i+1 >= geoPath.size())
+        {
+            break;
+        }
+        const auto& end = geoPath.at(i+1);
+        auto distance = start.distanceTo(end);
+        auto azimuth = start.azimuthTo(end);
+        auto steps = qCeil(distance/corridorHalfWidthInM);
+        for(int step = 1; step < steps; step++)
+        {
+            cover(start.atDistanceAndAzimuth(distance*step/steps, azimuth));
+        }
+    }
+    return result;
+}
+
+
+QVector<DataManagement::Downloadable_Abstract*> DataManagement::CorridorPlanner::downloadablesForPosition(const QGeoCoordinate& position)
+{
+    if (m_items.isNull() || !position.isValid())
+    {
+        return {};
+    }
+    QVector<DataManagement::Downloadable_Abstract*> result;
+    foreach(auto item, m_items->downloadables4Location(position))
+    {
+        if (isManaged(item))
+        {
+            result << item;
+        }
+    }
+    return result;
+}
+
+
+QDateTime DataManagement::CorridorPlanner::lastUsed(DataManagement::Downloadable_Abstract* item) const
+{
+    auto* singleFile = qobject_cast<Downloadable_SingleFile*>(item);
+    if (singleFile == nullptr)
+    {
+        return {};
+    }
+    auto result = m_lastUsed.value(singleFile->fileName());
+    if (!result.isValid())
+    {
+        result = QFileInfo(singleFile->fileName()).lastModified();
+    }
+    return result;
+}
+
+
+void DataManagement::CorridorPlanner::touch(const QVector<DataManagement::Downloadable_Abstract*>& items)
+{
+    auto now = QDateTime::currentDateTimeUtc();
+    foreach(auto item, items)
+    {
+        auto* singleFile = qobject_cast<Downloadable_SingleFile*>(item);
+        if (singleFile != nullptr)
+        {
+            m_lastUsed.insert(singleFile->fileName(), now);
+        }
+    }
+    if (!items.isEmpty())
+    {
+        m_saveTimer.start();
+    }
+}
+
+
+void DataManagement::CorridorPlanner::load()
+{
+    QFile file(m_lastUsedFileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return;
+    }
+    QDataStream stream(&file);
+    QHash<QString, QDateTime> lastUsed;
+    stream >> lastUsed;
+    if (stream.status() == QDataStream::Ok)
+    {
+        m_lastUsed = lastUsed;
+    }
+}
+
+
+void DataManagement::CorridorPlanner::save() const
+{
+    QSaveFile file(m_lastUsedFileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return;
+    }
+    QDataStream stream(&file);
+    stream << m_lastUsed;
+    file.commit();
+}
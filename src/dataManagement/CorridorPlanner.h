@@ -0,0 +1,213 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QGeoRectangle>
+#include <QPointer>
+#include <QProperty>
+#include <QQmlEngine>
+#include <QTimer>
+
+#include "dataManagement/DownloadScheduler.h"
+#include "dataManagement/Downloadable_MultiFile.h"
+#include "units/ByteSize.h"
+
+namespace DataManagement {
+
+
+/*! \brief Prefetch along the flight route, and eviction under a disk quota
+ *
+ *  This class ties downloaded regions to where the user actually flies.
+ *
+ *  - The method prefetch() intersects a corridor around the current flight
+ *    route with the bounding boxes of the aviation maps, base maps in vector
+ *    format and terrain maps, and queues all missing items in the
+ *    DownloadScheduler. If the property autoPrefetch is set, this happens
+ *    automatically whenever the flight route changes.
+ *
+ *  - The class remembers when each installed map was last used, that is, when
+ *    it contained the current position or met the route corridor. If the
+ *    property diskQuota is set, the method enforceQuota() deletes least
+ *    recently used maps until the installed maps fit into the quota. Maps
+ *    that contain the current position or meet the route corridor are never
+ *    deleted, and neither are manually imported files or databases. The quota
+ *    is enforced automatically whenever the download queue runs empty.
+ *
+ *  There exists one instance of this class, owned by the DataManager.
+ */
+
+class CorridorPlanner : public QObject {
+    Q_OBJECT
+    QML_ELEMENT
+    QML_UNCREATABLE("")
+
+public:
+    /*! \brief Standard constructor
+     *
+     *  @param items Downloadable_MultiFile holding all items of the DataManager
+     *
+     *  @param scheduler DownloadScheduler used for prefetching
+     *
+     *  @param parent The standard QObject parent pointer.
+     */
+    explicit CorridorPlanner(DataManagement::Downloadable_MultiFile* items, DataManagement::DownloadScheduler* scheduler, QObject* parent = nullptr);
+
+    /*! \brief Standard destructor
+     *
+     *  The destructor saves the time of last use of all maps.
+     */
+    ~CorridorPlanner() override;
+
+    /*! \brief Connect to flight route and position
+     *
+     *  This method must be called once, after the navigator and the position
+     *  provider have been constructed.
+     */
+    void start();
+
+    /*! \brief Half width of the route corridor, in meters */
+    static constexpr double corridorHalfWidthInM = 25000.0;
+
+
+
+    //
+    // PROPERTIES
+    //
+
+    /*! \brief Prefetch automatically when the flight route changes
+     *
+     *  This property is saved in QSettings and defaults to false.
+     */
+    Q_PROPERTY(bool autoPrefetch READ autoPrefetch WRITE setAutoPrefetch NOTIFY autoPrefetchChanged)
+
+    /*! \brief Disk quota for maps
+     *
+     *  Maximal total size of installed maps. A value of zero means that there
+     *  is no quota. This property is saved in QSettings and defaults to zero.
+     */
+    Q_PROPERTY(Units::ByteSize diskQuota READ diskQuota WRITE setDiskQuota NOTIFY diskQuotaChanged)
+
+
+
+    //
+    // Getter Methods
+    //
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property autoPrefetch
+     */
+    [[nodiscard]] bool autoPrefetch() const { return m_autoPrefetch; }
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property diskQuota
+     */
+    [[nodiscard]] Units::ByteSize diskQuota() const { return m_diskQuota; }
+
+
+
+    //
+    // Setter Methods
+    //
+
+    /*! \brief Setter function for the property with the same name
+     *
+     *  @param autoPrefetch Property autoPrefetch
+     */
+    void setAutoPrefetch(bool autoPrefetch);
+
+    /*! \brief Setter function for the property with the same name
+     *
+     *  @param quota Property diskQuota
+     */
+    void setDiskQuota(Units::ByteSize quota);
+
+
+
+    //
+    // Methods
+    //
+
+    /*! \brief Maps along the current flight route
+     *
+     *  @returns Aviation maps, base maps in vector format and terrain maps
+     *  whose bounding box meets the route corridor, installed or not
+     */
+    [[nodiscard]] Q_INVOKABLE QVector<DataManagement::Downloadable_Abstract*> downloadablesForRoute();
+
+    /*! \brief Delete least recently used maps until the quota is met
+     *
+     *  If diskQuota is zero, this method does nothing.
+     */
+    Q_INVOKABLE void enforceQuota();
+
+    /*! \brief Queue missing maps along the current flight route for download */
+    Q_INVOKABLE void prefetch();
+
+signals:
+    /*! \brief Notifier signal */
+    void autoPrefetchChanged();
+
+    /*! \brief Notifier signal */
+    void diskQuotaChanged();
+
+private:
+    Q_DISABLE_COPY_MOVE(CorridorPlanner)
+
+    // Rectangles that cover the corridor around the current flight route
+    [[nodiscard]] static QList<QGeoRectangle> routeCorridor();
+
+    // Maps whose bounding box contains the given position
+    [[nodiscard]] QVector<DataManagement::Downloadable_Abstract*> downloadablesForPosition(const QGeoCoordinate& position);
+
+    // Time of last use of a map, falling back to the modification time of its
+    // file
+    [[nodiscard]] QDateTime lastUsed(DataManagement::Downloadable_Abstract* item) const;
+
+    // Records that the installed items among the given ones are in use now
+    void touch(const QVector<DataManagement::Downloadable_Abstract*>& items);
+
+    // Reads and writes m_lastUsed
+    void load();
+    void save() const;
+
+    QPointer<DataManagement::Downloadable_MultiFile> m_items;
+    QPointer<DataManagement::DownloadScheduler> m_scheduler;
+
+    bool m_autoPrefetch {false};
+    Units::ByteSize m_diskQuota {0};
+
+    // Time of last use, by local file name
+    QHash<QString, QDateTime> m_lastUsed;
+    const QString m_lastUsedFileName;
+
+    // Timer used to collect route changes, so that editing the route does not
+    // trigger a prefetch for every single waypoint
+    QTimer m_routeTimer;
+
+    // Timer used to save m_lastUsed
+    QTimer m_saveTimer;
+
+    QPropertyNotifier m_positionNotifier;
+};
+
+} // namespace DataManagement
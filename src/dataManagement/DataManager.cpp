@@ -19,16 +19,23 @@
  ***************************************************************************/
 
 #include <QCoreApplication>
+#include <QDataStream>
 #include <QDirIterator>
+#include <QFileInfo>
+#include <QFutureWatcher>
 #include <QGuiApplication>
 #include <QImage>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QLockFile>
+#include <QPromise>
+#include <QSaveFile>
+#include <QSet>
 #include <QSettings>
-#include <QStack>
 #include <QTemporaryDir>
+#include <QtConcurrent/QtConcurrentRun>
+#include <optional>
 
 #include "config.h"
 #include "dataManagement/DataManager.h"
@@ -39,15 +46,136 @@ using namespace std::chrono_literals;
 using namespace Qt::Literals::StringLiterals;
 
 
+namespace {
+
+// Parsed content of the file maps.json. The catalogue is kept in binary form
+// next to maps.json, so that the list of items can be built at startup without
+// reading and parsing JSON.
+struct CatalogueEntry
+{
+    QString path;
+    QDateTime time;
+    qint64 size {-1};
+    QList<double> bbox; // left, bottom, right, top, or empty
+    QByteArray sha256;
+};
+
+struct Catalogue
+{
+    QString url;
+    QString minAppVersion;
+    QString whatsNew;
+    QList<CatalogueEntry> maps;
+};
+
+QDataStream& operator<<(QDataStream& stream, const CatalogueEntry& entry)
+{
+    return stream << entry.path << entry.time << entry.size << entry.bbox << entry.sha256;
+}
+
+QDataStream& operator>>(QDataStream& stream, CatalogueEntry& entry)
+{
+    return stream >> entry.path >> entry.time >> entry.size >> entry.bbox >> entry.sha256;
+}
+
+QDataStream& operator<<(QDataStream& stream, const Catalogue& catalogue)
+{
+    return stream << catalogue.url << catalogue.minAppVersion << catalogue.whatsNew << catalogue.maps;
+}
+
+QDataStream& operator>>(QDataStream& stream, Catalogue& catalogue)
+{
+    return stream >> catalogue.url >> catalogue.minAppVersion >> catalogue.whatsNew >> catalogue.maps;
+}
+
+// Version of the binary catalogue format. Increase when changing the
+// structures above.
+constexpr quint32 catalogueVersion = 1;
+
+// Returns the catalogue described in the file maps.json. The binary form is
+// used if it was made from the present file maps.json. Otherwise, the file is
+// parsed and the binary form is written. Returns std::nullopt if the file
+// cannot be parsed.
+std::optional<Catalogue> readCatalogue(const DataManagement::Downloadable_SingleFile& mapList, const QString& catalogueFileName)
+{
+    // The binary form records size and modification time of the file maps.json
+    // it was made from
+    QFileInfo const mapListInfo(mapList.fileName());
+    {
+        QFile file(catalogueFileName);
+        if (file.open(QIODevice::ReadOnly))
+        {
+            QDataStream stream(&file);
+            quint32 version = 0;
+            qint64 size = -1;
+            QDateTime lastModified;
+            Catalogue catalogue;
+            stream >> version >> size >> lastModified >> catalogue;
+            if ((stream.status() == QDataStream::Ok) && (version == catalogueVersion)
+                && (size == mapListInfo.size()) && (lastModified == mapListInfo.lastModified()))
+            {
+                return catalogue;
+            }
+        }
+    }
+
+    QJsonParseError parseError{};
+    auto doc = QJsonDocument::fromJson(mapList.fileContent(), &parseError);
+    if (parseError.error != QJsonParseError::NoError)
+    {
+        return {};
+    }
+    auto top = doc.object();
+
+    Catalogue catalogue;
+    catalogue.url = top.value(QStringLiteral("url")).toString();
+    catalogue.minAppVersion = top.value(QStringLiteral("minAppVersion")).toString();
+    catalogue.whatsNew = top.value(QStringLiteral("whatsNew")).toString();
+    for (const auto &map : top.value(QStringLiteral("maps")).toArray())
+    {
+        auto obj = map.toObject();
+        CatalogueEntry entry;
+        entry.path = obj.value(QStringLiteral("path")).toString();
+        entry.time = QDateTime::fromString(obj.value(QStringLiteral("time")).toString(), QStringLiteral("yyyyMMdd"));
+        entry.size = qRound64(obj.value(QStringLiteral("size")).toDouble());
+        if (obj.contains(u"bbox"_s))
+        {
+            auto bboxData = obj.value(u"bbox"_s).toArray();
+            for(auto index = 0; index < 4; index++)
+            {
+                entry.bbox << bboxData.at(index).toDouble();
+            }
+        }
+        entry.sha256 = QByteArray::fromHex(obj.value(u"sha256"_s).toString().toLatin1());
+        catalogue.maps << entry;
+    }
+
+    QSaveFile file(catalogueFileName);
+    if (file.open(QIODevice::WriteOnly))
+    {
+        QDataStream stream(&file);
+        stream << catalogueVersion << mapListInfo.size() << mapListInfo.lastModified() << catalogue;
+        file.commit();
+    }
+    return catalogue;
+}
+
+} // namespace
+
+
 DataManagement::DataManager::DataManager(QObject* parent) : GlobalObject(parent)
 {
-    // Delete funny files that might have made their way into our data directory
-    cleanDataDirectory();
+    // Read the inventory of the data directory from the last run. The data
+    // directory is cleaned and scanned later, on a worker thread.
+    loadInventory();
 
     // Wire up the Dowloadable object "_maps_json"
     connect(&m_mapList, &DataManagement::Downloadable_SingleFile::fileContentChanged, this, &DataManager::updateDataItemListAndWhatsNew);
     connect(&m_mapList, &DataManagement::Downloadable_SingleFile::fileContentChanged, this, []()
     { QSettings().setValue(QStringLiteral("DataManager/MapListTimeStamp"), QDateTime::currentDateTimeUtc()); });
+    connect(&m_mapList, &DataManagement::Downloadable_SingleFile::fileNotModified, this, []()
+    { QSettings().setValue(QStringLiteral("DataManager/MapListTimeStamp"), QDateTime::currentDateTimeUtc()); });
+    m_mapList.setConditionalDownload(true);
     connect(&m_mapList, &DataManagement::Downloadable_SingleFile::error, this, [this](const QString & /*unused*/, const QString& message)
     { emit error(message); });
 
@@ -64,6 +192,13 @@ void DataManagement::DataManager::deferredInitialization()
     // If there is a downloaded maps.json file, we read it.
     updateDataItemListAndWhatsNew();
 
+    // Delete funny files that might have made their way into our data
+    // directory, and bring the inventory up to date
+    startInventoryScan();
+
+    // Prefetch along the flight route, evict maps that are not used
+    m_corridorPlanner.start();
+
     // Update maps.json file if that is too old. Check that whenever the app comes forward.
     updateRemoteDataItemListIfOutdated();
     connect(qGuiApp, &QGuiApplication::applicationStateChanged, this,
@@ -77,18 +212,78 @@ void DataManagement::DataManager::deferredInitialization()
 }
 
 
-void DataManagement::DataManager::cleanDataDirectory()
+void DataManagement::DataManager::addToInventory(const QString& fileName)
+{
+    QFileInfo const info(fileName);
+    if (info.exists())
+    {
+        m_inventory.insert(info.absoluteFilePath(), {info.size(), info.lastModified()});
+        saveInventory();
+    }
+}
+
+
+void DataManagement::DataManager::loadInventory()
+{
+    QFile file(m_inventoryFileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return;
+    }
+    QDataStream stream(&file);
+    Inventory inventory;
+    stream >> inventory;
+    if (stream.status() == QDataStream::Ok)
+    {
+        m_inventory = inventory;
+    }
+}
+
+
+void DataManagement::DataManager::saveInventory() const
+{
+    QSaveFile file(m_inventoryFileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return;
+    }
+    QDataStream stream(&file);
+    stream << m_inventory;
+    file.commit();
+}
+
+
+auto DataManagement::DataManager::scanDataDirectory(const QString& dataDirectory) -> Inventory
 {
+    Inventory inventory;
+    QStringList directories;
     QStringList misnamedFiles;
     QStringList unexpectedFiles;
-    QDirIterator fileIterator(m_dataDirectory, QDir::Files, QDirIterator::Subdirectories);
+    auto now = QDateTime::currentDateTime();
+    QDirIterator fileIterator(dataDirectory, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
     while (fileIterator.hasNext())
     {
         fileIterator.next();
+        auto info = fileIterator.fileInfo();
+        if (info.isDir())
+        {
+            directories += fileIterator.filePath();
+            continue;
+        }
         if (fileIterator.filePath().endsWith(u".geojson.geojson"_s)
                 || fileIterator.filePath().endsWith(u".mbtiles.mbtiles"_s))
         {
             misnamedFiles += fileIterator.filePath();
+            continue;
+        }
+        // Partial downloads are kept for resumption, unless they are old
+        if (fileIterator.filePath().endsWith(u".part"_s) || fileIterator.filePath().endsWith(u".part.info"_s))
+        {
+            if (info.lastModified().daysTo(now) > 30)
+            {
+                unexpectedFiles += fileIterator.filePath();
+            }
+            continue;
         }
         if (!fileIterator.filePath().endsWith(u".terrain"_s) &&
                 !fileIterator.filePath().endsWith(u".geojson"_s) &&
@@ -96,7 +291,13 @@ void DataManagement::DataManager::cleanDataDirectory()
                 !fileIterator.filePath().endsWith(u".raster"_s) &&
                 !fileIterator.filePath().endsWith(u".txt"_s))
         {
-            unexpectedFiles += fileIterator.filePath();
+            // The scan runs while the app is in use. Lock files and SQLite
+            // journals of files that are being written are left alone.
+            if (info.lastModified().secsTo(now) > 60*60)
+            {
+                unexpectedFiles += fileIterator.filePath();
+            }
+            continue;
         }
 
         // Delete aviation map files that are no longer supported, though they existed in earlier versions of this app
@@ -107,46 +308,57 @@ void DataManagement::DataManager::cleanDataDirectory()
                 fileIterator.filePath().endsWith(u"United States.geojson"_s))
         {
             unexpectedFiles += fileIterator.filePath();
+            continue;
         }
+
+        inventory.insert(fileIterator.filePath(), {info.size(), info.lastModified()});
     }
     foreach (auto misnamedFile, misnamedFiles)
     {
-        QFile::rename(misnamedFile, misnamedFile.section('.', 0, -2));
+        auto newName = misnamedFile.section('.', 0, -2);
+        if (QFile::rename(misnamedFile, newName))
+        {
+            QFileInfo const info(newName);
+            inventory.insert(newName, {info.size(), info.lastModified()});
+        }
     }
     foreach (auto unexpectedFile, unexpectedFiles)
     {
         QFile::remove(unexpectedFile);
     }
 
-    // Recurse into m_dataDirectory and delete all empty (sub)directories.
-    // Also delete directories that became empty because
-    // some of its subdirectories got deleted in the process.
-    bool directoryDeleted = true;
-    while(directoryDeleted)
+    // Delete all empty subdirectories. Directories are handled deepest first,
+    // so that directories which become empty because their subdirectories got
+    // deleted are deleted in the same pass. QDir::rmdir() fails on directories
+    // that are not empty.
+    std::sort(directories.begin(), directories.end(), [](const QString& first, const QString& second) {
+        return first.count('/') > second.count('/');
+    });
+    foreach (auto directory, directories)
     {
-        directoryDeleted = false;
-        QStack<QString> stack;
-        stack.push(m_dataDirectory);
+        QDir().rmdir(directory);
+    }
 
-        while (!stack.isEmpty()) {
-            const QString currentPath = stack.pop();
-            const QDir dir(currentPath);
+    return inventory;
+}
 
-            if (dir.exists()) {
-                const QFileInfoList entries = dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
-                for (const QFileInfo& entry : entries)
-                {
-                    stack.push(entry.filePath());
-                }
 
-                if (dir.entryList(QDir::NoDotAndDotDot | QDir::AllEntries).isEmpty())
-                {
-                    dir.rmdir(currentPath);
-                    directoryDeleted = true;
-                }
-            }
+void DataManagement::DataManager::startInventoryScan()
+{
+    auto* watcher = new QFutureWatcher<Inventory>(this);
+    connect(watcher, &QFutureWatcher<Inventory>::finished, this, [this, watcher]() {
+        watcher->deleteLater();
+        auto inventory = watcher->result();
+        auto oldFiles = QSet<QString>(m_inventory.keyBegin(), m_inventory.keyEnd());
+        auto newFiles = QSet<QString>(inventory.keyBegin(), inventory.keyEnd());
+        m_inventory = inventory;
+        saveInventory();
+        if (oldFiles != newFiles)
+        {
+            updateDataItemListAndWhatsNew();
         }
-    }
+    });
+    watcher->setFuture(QtConcurrent::run(&DataManager::scanDataDirectory, m_dataDirectory));
 }
 
 
@@ -182,6 +394,7 @@ QString DataManagement::DataManager::import(const QString& fileName, const QStri
         return tr("Unable to copy map file to data directory.");
     }
 
+    addToInventory(newFileName);
     updateDataItemListAndWhatsNew();
 
     return {};
@@ -190,13 +403,48 @@ QString DataManagement::DataManager::import(const QString& fileName, const QStri
 
 QString DataManagement::DataManager::importOpenAir(const QString& fileName, const QString& newName)
 {
+    auto result = writeOpenAir(fileName, m_dataDirectory+"/Unsupported", newName);
+    addToInventory(m_dataDirectory + "/Unsupported/" + newName + u".geojson"_s);
+    updateDataItemListAndWhatsNew();
+    return result;
+}
+
+
+void DataManagement::DataManager::startImportOpenAir(const QString& fileName, const QString& newName)
+{
+    emit importOpenAirStatus(0.0);
+
+    auto* watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::progressValueChanged, this, [this](int progressValue) {
+        emit importOpenAirStatus(qMin(0.99, progressValue/100.0));
+    });
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, newName]() {
+        watcher->deleteLater();
+        addToInventory(m_dataDirectory + "/Unsupported/" + newName + u".geojson"_s);
+        updateDataItemListAndWhatsNew();
+        emit importOpenAirStatus(1.0);
+        emit importOpenAirFinished(watcher->future().result());
+    });
 
     auto path = m_dataDirectory+"/Unsupported";
-    auto newFileName = path + "/" + newName;
+    watcher->setFuture(QtConcurrent::run([fileName, path, newName](QPromise<QString>& promise) {
+        promise.setProgressRange(0, 100);
+        promise.addResult(writeOpenAir(fileName, path, newName, [&promise](double percent) {
+            promise.setProgressValue(qRound(100.0*percent));
+        }));
+    }));
+}
+
 
+QString DataManagement::DataManager::writeOpenAir(const QString& fileName, const QString& path, const QString& newName, const std::function<void(double)>& progress)
+{
     QStringList errors;
     QStringList warnings;
-    auto json = GeoMaps::openAir::parse(fileName, errors, warnings);
+    auto geoJSON = GeoMaps::openAir::toGeoJSON(fileName, errors, warnings, progress);
+    if (geoJSON.isEmpty() && errors.isEmpty())
+    {
+        errors += tr("No airspace data found in file '%1'.").arg(fileName);
+    }
 
     if (!errors.isEmpty())
     {
@@ -215,19 +463,14 @@ QString DataManagement::DataManager::importOpenAir(const QString& fileName, cons
     {
         return tr("Unable to create directory '%1'.").arg(path);
     }
-    newFileName = newFileName+u".geojson"_s;
-    QFile::remove(newFileName);
-    QFile file(newFileName);
+    auto newFileName = path + "/" + newName + u".geojson"_s;
+    QSaveFile file(newFileName);
     file.open(QIODeviceBase::WriteOnly);
-    file.write(json.toJson());
-    file.close();
-    if (file.error() != QFileDevice::NoError)
+    file.write(geoJSON);
+    if (!file.commit())
     {
-        QFile::remove(newFileName);
-        updateDataItemListAndWhatsNew();
         return tr("Error writing file '%1': %2.").arg(newFileName, file.errorString());
     }
-    updateDataItemListAndWhatsNew();
     return {};
 }
 
@@ -263,19 +506,12 @@ void DataManagement::DataManager::onItemFileChanged()
 DataManagement::Downloadable_SingleFile* DataManagement::DataManager::createOrRecycleItem(const QUrl& url, const QString& localFileName, const QGeoRectangle& bBox)
 {
     // If a data item with the given local file name and the given URL already exists,
-    // update that remoteFileDate and remoteFileSize of that element, annd delete its
-    // entry in oldMaps
-    foreach (auto mapPtrX, m_items.downloadables())
+    // return that item
+    const std::pair<QString, QUrl> itemKey {localFileName, url};
+    auto existingItem = m_itemIndex.value(itemKey);
+    if (!existingItem.isNull())
     {
-        auto* mapPtr = qobject_cast<DataManagement::Downloadable_SingleFile*>(mapPtrX);
-        if (mapPtr == nullptr)
-        {
-            continue;
-        }
-        if ((mapPtr->fileName() == localFileName) && (mapPtr->url() == url))
-        {
-            return mapPtr;
-        }
+        return existingItem;
     }
 
     // Construct a new downloadable object and add to appropriate groups
@@ -296,30 +532,23 @@ DataManagement::Downloadable_SingleFile* DataManagement::DataManager::createOrRe
             downloadable->setSection("<a name>"+tr("Manually Imported"));
         }
 
-        bool hasMapSet = false;
-        foreach(auto mapSetX, m_mapSets.downloadables())
+        const std::pair<QString, QString> mapSetKey {downloadable->section(), downloadable->objectName()};
+        auto mapSet = m_mapSetIndex.value(mapSetKey);
+        if (!mapSet.isNull())
         {
-            auto* mapSet = qobject_cast<DataManagement::Downloadable_MultiFile*>(mapSetX);
-            if (mapSet == nullptr)
-            {
-                continue;
-            }
-            if ((mapSet->objectName() == downloadable->objectName()) && (mapSet->section() == downloadable->section()))
-            {
-                mapSet->add(downloadable);
-                hasMapSet = true;
-                break;
-            }
+            mapSet->add(downloadable);
         }
-        if (!hasMapSet)
+        else
         {
             auto* newMapSet = new DataManagement::Downloadable_MultiFile(Downloadable_MultiFile::MultiUpdate, this);
             newMapSet->add(downloadable);
             m_mapSets.add(newMapSet);
+            m_mapSetIndex.insert(mapSetKey, newMapSet);
         }
     }
 
     m_items.add(downloadable);
+    m_itemIndex.insert(itemKey, downloadable);
     if (localFileName.endsWith(u"terrain"_s))
     {
         m_terrainMaps.add(downloadable);
@@ -353,32 +582,33 @@ void DataManagement::DataManager::updateDataItemListAndWhatsNew()
         return;
     }
 
-    // Get List of file in the directory
-    QList<QString> files;
-    QDirIterator fileIterator(m_dataDirectory, QDir::Files, QDirIterator::Subdirectories);
-    while (fileIterator.hasNext())
-    {
-        fileIterator.next();
-        files.append(fileIterator.filePath());
-    }
+    // Get List of files in the directory from the inventory. Files of
+    // existing items are added, so that files downloaded since the last scan
+    // are not missed.
+    QSet<QString> files(m_inventory.keyBegin(), m_inventory.keyEnd());
 
     // List of maps as we have them now
-    auto oldMaps = m_items.downloadables();
+    QSet<DataManagement::Downloadable_Abstract*> oldMaps;
+    foreach(auto map, m_items.downloadables())
+    {
+        oldMaps.insert(map);
+        foreach(auto fileName, map->files())
+        {
+            files.insert(fileName);
+        }
+    }
 
     // To begin, we handle the maps described in the maps.json file. If these
     // maps were already present in the old list, we re-use them. Otherwise, we
     // create new Downloadable objects.
-    QJsonParseError parseError{};
-    auto doc = QJsonDocument::fromJson(m_mapList.fileContent(), &parseError);
-    if (parseError.error != QJsonParseError::NoError)
+    auto catalogue = readCatalogue(m_mapList, m_catalogueFileName);
+    if (!catalogue.has_value())
     {
         return;
     }
 
-    auto top = doc.object();
-
     // Prepare strings to check if the present version
-    auto minVersionString = top.value(QStringLiteral("minAppVersion")).toString();
+    auto minVersionString = catalogue->minAppVersion;
     QString currentVersionString(QStringLiteral(ENROUTE_VERSION_STRING));
     { // Ensure that strings have the format xx.yy.zz
         if ((minVersionString.size() >= 2) && (minVersionString[1] == '.'))
@@ -423,44 +653,45 @@ void DataManagement::DataManager::updateDataItemListAndWhatsNew()
             emit appUpdateRequiredChanged();
         }
 
-        auto baseURL = top.value(QStringLiteral("url")).toString();
-        for (const auto &map : top.value(QStringLiteral("maps")).toArray())
+        for (const auto& map : std::as_const(catalogue->maps))
         {
-            auto obj = map.toObject();
-            auto mapFileName = obj.value(QStringLiteral("path")).toString();
-            auto localFileName = m_dataDirectory + "/" + mapFileName;
-            auto mapUrlName = baseURL + "/" + obj.value(QStringLiteral("path")).toString();
-            QUrl const mapUrl(mapUrlName);
-            auto fileModificationDateTime = QDateTime::fromString(obj.value(QStringLiteral("time")).toString(), QStringLiteral("yyyyMMdd"));
-            qint64 const fileSize = qRound64(obj.value(QStringLiteral("size")).toDouble());
+            auto localFileName = m_dataDirectory + "/" + map.path;
+            QUrl const mapUrl(catalogue->url + "/" + map.path);
 
             QGeoRectangle bbox;
-            if (obj.contains(u"bbox"_s))
+            if (map.bbox.size() == 4)
             {
-                auto bboxData = obj.value(u"bbox"_s).toArray();
-                auto left = bboxData.at(0).toDouble();
-                auto bottom = bboxData.at(1).toDouble();
+                auto left = map.bbox.at(0);
+                auto bottom = map.bbox.at(1);
 
-                auto right = bboxData.at(2).toDouble();
-                auto top = bboxData.at(3).toDouble();
+                auto right = map.bbox.at(2);
+                auto top = map.bbox.at(3);
                 bbox.setTopLeft( {top, left} );
                 bbox.setBottomRight( {bottom, right} );
             }
 
             auto* downloadable = createOrRecycleItem(mapUrl, localFileName, bbox);
-            oldMaps.removeAll(downloadable);
-            downloadable->setRemoteFileDate(fileModificationDateTime);
-            downloadable->setRemoteFileSize(fileSize);
+            oldMaps.remove(downloadable);
+            downloadable->setRemoteFileDate(map.time);
+            downloadable->setRemoteFileSize(map.size);
+            downloadable->setRemoteFileHash(map.sha256);
 
-            files.removeAll(localFileName);
+            files.remove(localFileName);
         }
     }
 
     // Next, we create or recycle items for all files that that we have found in the directory.
     foreach (auto localFileName, files)
     {
+        // Validate the inventory lazily, for the few files that are not
+        // described in maps.json
+        if (!QFile::exists(localFileName))
+        {
+            m_inventory.remove(localFileName);
+            continue;
+        }
         auto *downloadable = createOrRecycleItem(QUrl(), localFileName, {});
-        oldMaps.removeAll(downloadable);
+        oldMaps.remove(downloadable);
         downloadable->setObjectName(localFileName.section(QStringLiteral("/"), -1, -1));
     }
     qDeleteAll(oldMaps);
@@ -483,10 +714,12 @@ void DataManagement::DataManager::updateDataItemListAndWhatsNew()
     foreach(auto mapSet, dump)
     {
         m_mapSets.remove(mapSet);
+        m_mapSetIndex.removeIf([mapSet](decltype(m_mapSetIndex)::iterator entry) { return entry.value() == mapSet; });
     }
+    m_itemIndex.removeIf([](decltype(m_itemIndex)::iterator entry) { return entry.value().isNull(); });
 
     // Update the whatsNew property
-    auto newWhatsNew = top.value(QStringLiteral("whatsNew")).toString();
+    auto newWhatsNew = catalogue->whatsNew;
     if (!newWhatsNew.isEmpty() && (newWhatsNew != m_whatsNew))
     {
         m_whatsNew = newWhatsNew;
@@ -20,10 +20,15 @@
 
 #pragma once
 
+#include <QDateTime>
+#include <QHash>
 #include <QQmlEngine>
 #include <QStandardPaths>
+#include <functional>
 
 #include "GlobalObject.h"
+#include "dataManagement/CorridorPlanner.h"
+#include "dataManagement/DownloadScheduler.h"
 #include "dataManagement/Downloadable_MultiFile.h"
 #include "dataManagement/Downloadable_SingleFile.h"
 #include "units/ByteSize.h"
@@ -59,6 +64,13 @@ namespace DataManagement {
  *
  *  https://github.com/Akaflieg-Freiburg/enrouteServer/wiki/The-file-maps.json
  *
+ *  If an entry of the file contains a field "sha256" with the hex-encoded
+ *  SHA-256 digest of the file, downloads are checked against that digest.
+ *
+ *  The list is fetched with conditional requests, so that the server transfers
+ *  it only if it has changed. Once parsed, the list is kept in binary form in
+ *  a file "maps.dat" next to "maps.json", and read from there on later starts.
+ *
  *  Locally installed items are saved in the directory "aviation_maps" in
  *  QStandardPaths::writableLocation(QStandardPaths::AppDataLocation), or into a
  *  suitable subdirectory of this.
@@ -137,12 +149,26 @@ public:
      */
     Q_PROPERTY(DataManagement::Downloadable_MultiFile* baseMaps READ baseMaps CONSTANT)
 
+    /*! \brief Prefetch along the flight route and eviction under a disk quota
+     *
+     *  Pointer to the CorridorPlanner that manages the maps of this
+     *  DataManager.
+     */
+    Q_PROPERTY(DataManagement::CorridorPlanner* corridorPlanner READ corridorPlanner CONSTANT)
+
     /*! \brief Downloadable_MultiFile that holds all databases
      *
      *  Pointer to a Downloadable_MultiFile that holds all databases.
      */
     Q_PROPERTY(DataManagement::Downloadable_MultiFile* databases READ databases CONSTANT)
 
+    /*! \brief Queue for downloads and updates
+     *
+     *  Pointer to the DownloadScheduler that starts the downloads and updates
+     *  requested through any of the Downloadable_MultiFile instances.
+     */
+    Q_PROPERTY(DataManagement::DownloadScheduler* downloadScheduler READ downloadScheduler CONSTANT)
+
     /*! \brief Downloadable_MultiFile that holds all data items
      *
      *  Pointer to a Downloadable_MultiFile that holds all data items.  This
@@ -209,12 +235,24 @@ public:
      */
     [[nodiscard]] DataManagement::Downloadable_MultiFile* baseMapsVector() { return &m_baseMapsVector; }
 
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property corridorPlanner
+     */
+    [[nodiscard]] DataManagement::CorridorPlanner* corridorPlanner() { return &m_corridorPlanner; }
+
     /*! \brief Getter function for the property with the same name
      *
      *  @returns Property databases
      */
     [[nodiscard]] DataManagement::Downloadable_MultiFile* databases() { return &m_databases; }
 
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property downloadScheduler
+     */
+    [[nodiscard]] DataManagement::DownloadScheduler* downloadScheduler() { return &m_downloadScheduler; }
+
     /*! \brief Getter function for the property with the same name
      *
      *  @returns Property items
@@ -298,6 +336,22 @@ public:
      */
     Q_INVOKABLE QString importOpenAir(const QString& fileName, const QString& newName);
 
+    /*! \brief Import airspace data into the library of locally installed
+     * maps, in the background
+     *
+     * This method works like importOpenAir(), but reads and converts the file
+     * in the global thread pool. Progress is reported by the signal
+     * importOpenAirStatus(). Once the import is done, the signal
+     * importOpenAirFinished() is emitted.
+     *
+     * @param fileName File name of locally raster or vector map, in OpenAir
+     * format.
+     *
+     * @param newName Name under which the map is available in the library. If
+     * the name exists, the library entry will be replaced.
+     */
+    Q_INVOKABLE void startImportOpenAir(const QString& fileName, const QString& newName);
+
 public slots:
     /*! \brief Triggers an update of the list of remotely available data items
      *
@@ -319,20 +373,57 @@ signals:
      */
     void error(const QString& message);
 
+    /*! \brief Progress of an import started with startImportOpenAir()
+     *
+     *  @param percent A number between 0.0 and 1.0. The number 1.0 is
+     *  reported once the import has finished.
+     */
+    void importOpenAirStatus(double percent);
+
+    /*! \brief Import started with startImportOpenAir() has finished
+     *
+     *  @param errorString A human-readable HTML string on error, or an empty
+     *  string on success
+     */
+    void importOpenAirFinished(const QString& errorString);
+
     /*! \brief Notifier signal */
     void whatsNewChanged();
 
 private:
     Q_DISABLE_COPY_MOVE(DataManager)
 
-    // Clean the data directory.
+    // Inventory of the data directory: size and modification time of every
+    // data file, by path. Partial downloads are not included.
+    using Inventory = QHash<QString, std::pair<qint64, QDateTime>>;
+
+    // Cleans the data directory and returns an inventory of its content. This
+    // method does not touch the DataManager and runs on a worker thread.
     //
     // - delete all files with unexpected file names
     // - earlier versions of this program constructed files with names ending in
     //   ".geojson.geojson" or ".mbtiles.mbtiles". We correct those file names
     //   here.
-    // - remove all empty sub directories
-    void cleanDataDirectory();
+    // - remove all empty sub directories, bottom-up in one pass
+    static Inventory scanDataDirectory(const QString& dataDirectory);
+
+    // Scans the data directory on a worker thread. Once the scan is done,
+    // m_inventory is replaced and saved, and the list of items is updated if
+    // files appeared or disappeared.
+    void startInventoryScan();
+
+    // Adds a file that has been written to the data directory to m_inventory
+    void addToInventory(const QString& fileName);
+
+    // Reads and writes m_inventory
+    void loadInventory();
+    void saveInventory() const;
+
+    // Converts the OpenAir file fileName to GeoJSON and writes it to the file
+    // newName.geojson in the directory path. Returns a human-readable HTML
+    // string on error, or an empty string on success. This method does not
+    // touch the DataManager and can be called from any thread.
+    static QString writeOpenAir(const QString& fileName, const QString& path, const QString& newName, const std::function<void(double)>& progress = {});
 
     // This slot is called when a local file of one of the Downloadables changes
     // content or existence. If the Downloadable in question has no file
@@ -352,18 +443,41 @@ private:
     // then returned.
     DataManagement::Downloadable_SingleFile* createOrRecycleItem(const QUrl& url, const QString& localFileName, const QGeoRectangle& bBox);
 
+    // Indices for createOrRecycleItem(), so that the catalogue can be
+    // refreshed without scanning all items for every entry of maps.json. The
+    // first index is keyed by local file name and URL, the second by section
+    // and object name. Entries whose objects have been deleted are removed
+    // lazily.
+    QHash<std::pair<QString, QUrl>, QPointer<DataManagement::Downloadable_SingleFile>> m_itemIndex;
+    QHash<std::pair<QString, QString>, QPointer<DataManagement::Downloadable_MultiFile>> m_mapSetIndex;
+
     bool m_appUpdateRequired {false};
 
     // Full path name of data directory, without trailing slash
     QString m_dataDirectory {QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/aviation_maps"};
 
+    // Inventory of the data directory, as of the last scan, and the file
+    // where it is saved between runs. The inventory is used instead of walking
+    // the data directory, which is slow on devices with many files. Entries
+    // are validated when they are used.
+    Inventory m_inventory;
+    QString m_inventoryFileName {QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/dataInventory.dat"};
+
     // The current whats new string from _aviationMaps.
     QString m_whatsNew;
 
+    // Binary form of the parsed file maps.json, see readCatalogue() in the
+    // implementation file
+    QString m_catalogueFileName {QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/maps.dat"};
+
     // This Downloadable object manages the central text file that describes the
     // remotely available aviation maps.
     DataManagement::Downloadable_SingleFile m_mapList { QUrl(QStringLiteral("https://enroute-data.akaflieg-freiburg.de/enroute-GeoJSONv003/maps.json")), QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/maps.json" };
 
+    // Queue for downloads. This member is declared before the Downloadables,
+    // so that it outlives them.
+    DataManagement::DownloadScheduler m_downloadScheduler;
+
     // List of geographic maps
     DataManagement::Downloadable_MultiFile m_aviationMaps {DataManagement::Downloadable_MultiFile::SingleUpdate};
     DataManagement::Downloadable_MultiFile m_baseMaps {DataManagement::Downloadable_MultiFile::SingleUpdate};
@@ -376,6 +490,10 @@ private:
 
     // List of geographic map sets
     DataManagement::Downloadable_MultiFile m_mapSets  {DataManagement::Downloadable_MultiFile::SingleUpdate};
+
+    // Prefetch and eviction. This member is declared after the Downloadables,
+    // so that it is destructed before them.
+    DataManagement::CorridorPlanner m_corridorPlanner {&m_items, &m_downloadScheduler};
 };
 
 } // namespace DataManagement
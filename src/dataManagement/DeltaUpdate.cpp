@@ -0,0 +1,238 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "DeltaUpdate.h"
+#include "GlobalObject.h"
+
+using namespace Qt::Literals::StringLiterals;
+
+
+DataManagement::DeltaUpdate::DeltaUpdate(const QUrl& url, const QString& baseRelease, QObject* parent)
+    : QObject(parent), m_baseRelease(baseRelease)
+{
+    m_manifestURL = url;
+    m_manifestURL.setPath(url.path(QUrl::FullyEncoded) + u".delta/"_s + QString::fromLatin1(QUrl::toPercentEncoding(baseRelease)) + u".json"_s, QUrl::TolerantMode);
+
+    m_manifestReply = GlobalObject::networkAccessManager()->get(QNetworkRequest(m_manifestURL));
+    connect(m_manifestReply, &QNetworkReply::finished, this, &DeltaUpdate::manifestFinished);
+}
+
+
+DataManagement::DeltaUpdate::~DeltaUpdate()
+{
+    // Emit no signals while aborting
+    m_finished = true;
+
+    if (!m_manifestReply.isNull())
+    {
+        m_manifestReply->abort();
+        delete m_manifestReply;
+    }
+    for(const auto& reply : std::as_const(m_tileReplies))
+    {
+        if (!reply.isNull())
+        {
+            reply->abort();
+            delete reply;
+        }
+    }
+}
+
+
+void DataManagement::DeltaUpdate::fail(const QString& reason)
+{
+    if (m_finished)
+    {
+        return;
+    }
+    m_finished = true;
+    qWarning() << "Delta update from" << m_manifestURL << "failed:" << reason;
+
+    if (!m_manifestReply.isNull())
+    {
+        m_manifestReply->abort();
+        m_manifestReply->deleteLater();
+    }
+    for(const auto& reply : std::as_const(m_tileReplies))
+    {
+        if (!reply.isNull())
+        {
+            reply->abort();
+            reply->deleteLater();
+        }
+    }
+    m_tileReplies.clear();
+    m_tiles.clear();
+    emit finished(false);
+}
+
+
+void DataManagement::DeltaUpdate::fetchTiles()
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    // Forget about finished requests
+    m_tileReplies.removeIf([](const QPointer<QNetworkReply>& reply) { return reply.isNull(); });
+
+    while(!m_pendingTiles.isEmpty() && (m_tileReplies.size() < maxParallelRequests))
+    {
+        auto index = m_pendingTiles.dequeue();
+        const auto& tile = m_tiles.at(index);
+        auto path = m_tileURLTemplate;
+        path.replace(u"{z}"_s, QString::number(tile.zoom));
+        path.replace(u"{x}"_s, QString::number(tile.x));
+        path.replace(u"{y}"_s, QString::number(tile.y));
+
+        // Vector tiles are stored gzip-compressed. Ask for the bytes as they
+        // are, so that the network stack does not decompress them and the hash
+        // refers to the data that goes into the file.
+        QNetworkRequest request(m_manifestURL.resolved(QUrl(path)));
+        request.setRawHeader("Accept-Encoding", "identity");
+        auto* reply = GlobalObject::networkAccessManager()->get(request);
+        connect(reply, &QNetworkReply::finished, this, [this, reply, index]() { tileFinished(reply, index); });
+        m_tileReplies << reply;
+    }
+
+    if (m_pendingTiles.isEmpty() && m_tileReplies.isEmpty())
+    {
+        m_finished = true;
+        emit progress(100);
+        emit finished(true);
+    }
+}
+
+
+void DataManagement::DeltaUpdate::manifestFinished()
+{
+    if (m_manifestReply.isNull())
+    {
+        return;
+    }
+    QNetworkReply* reply = m_manifestReply;
+    m_manifestReply = nullptr;
+    reply->deleteLater();
+    if (reply->error() != QNetworkReply::NoError)
+    {
+        fail(reply->errorString());
+        return;
+    }
+
+    QJsonParseError parseError {};
+    auto document = QJsonDocument::fromJson(reply->readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError)
+    {
+        fail(parseError.errorString());
+        return;
+    }
+    auto manifest = document.object();
+    m_release = manifest[u"release"_s].toString();
+    m_tileURLTemplate = manifest[u"tiles"_s].toString();
+    if ((manifest[u"base"_s].toString() != m_baseRelease) || m_release.isEmpty() || m_tileURLTemplate.isEmpty())
+    {
+        fail(u"Manifest does not match local file"_s);
+        return;
+    }
+
+    auto changed = manifest[u"changed"_s].toArray();
+    auto removed = manifest[u"removed"_s].toArray();
+    if (changed.size()+removed.size() > maxTiles)
+    {
+        fail(u"Too many changed tiles"_s);
+        return;
+    }
+
+    // Read tile coordinates. Zoom levels above 24 are not used by any map and
+    // are rejected, to avoid overflows.
+    auto readTile = [](const QJsonArray& entry, FileFormats::MBTILES::TileData& tile) {
+        tile.zoom = entry.at(0).toInt(-1);
+        tile.x = entry.at(1).toInt(-1);
+        tile.y = entry.at(2).toInt(-1);
+        return (tile.zoom >= 0) && (tile.zoom <= 24)
+               && (tile.x >= 0) && (tile.x < (1<<tile.zoom))
+               && (tile.y >= 0) && (tile.y < (1<<tile.zoom));
+    };
+    for(const auto& value : std::as_const(changed))
+    {
+        auto entry = value.toArray();
+        FileFormats::MBTILES::TileData tile;
+        auto hash = QByteArray::fromHex(entry.at(3).toString().toLatin1());
+        if (!readTile(entry, tile) || (hash.size() != 32))
+        {
+            fail(u"Invalid entry in list of changed tiles"_s);
+            return;
+        }
+        m_pendingTiles.enqueue(m_tiles.size());
+        m_tiles << tile;
+        m_hashes << hash;
+    }
+    for(const auto& value : std::as_const(removed))
+    {
+        FileFormats::MBTILES::TileData tile;
+        if (!readTile(value.toArray(), tile))
+        {
+            fail(u"Invalid entry in list of removed tiles"_s);
+            return;
+        }
+        m_tiles << tile;
+        m_hashes << QByteArray();
+    }
+    m_tilesToDownload = m_pendingTiles.size();
+    fetchTiles();
+}
+
+
+void DataManagement::DeltaUpdate::tileFinished(QNetworkReply* reply, qsizetype index)
+{
+    reply->deleteLater();
+    if (m_finished)
+    {
+        return;
+    }
+    if (reply->error() != QNetworkReply::NoError)
+    {
+        fail(reply->errorString());
+        return;
+    }
+
+    // Tiles without data would be mistaken for removed tiles
+    auto data = reply->readAll();
+    if (data.isEmpty() || (QCryptographicHash::hash(data, QCryptographicHash::Sha256) != m_hashes.at(index)))
+    {
+        fail(u"Tile data does not match manifest"_s);
+        return;
+    }
+    m_tiles[index].data = data;
+
+    m_tilesReceived++;
+    emit progress(static_cast<int>((100*m_tilesReceived)/qMax(qsizetype(1), m_tilesToDownload)));
+
+    // The reply is deleted later, so remove it from the list of running
+    // requests right away
+    m_tileReplies.removeIf([reply](const QPointer<QNetworkReply>& pointer) { return pointer == reply; });
+    fetchTiles();
+}
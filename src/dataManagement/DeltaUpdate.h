@@ -0,0 +1,173 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QNetworkReply>
+#include <QPointer>
+#include <QQueue>
+
+#include "fileFormats/MBTILES.h"
+
+namespace DataManagement
+{
+
+/*! \brief Tile-level delta update for MBTILES files
+ *
+ *  For every release of a map in MBTILES format, the server can publish
+ *  manifests that list the tiles which changed since an earlier release. If
+ *  the local copy of the map is at release "base", the manifest is found at
+ *  the URL of the map, followed by ".delta/base.json". It is a JSON object of
+ *  the following form.
+ *
+ *  @code
+ *  {
+ *    "base": "2025-05",
+ *    "release": "2025-06",
+ *    "tiles": "https://example.org/tiles/2025-06/{z}/{x}/{y}.pbf",
+ *    "changed": [ [z, x, y, "SHA-256 of the tile data, hex-encoded"], … ],
+ *    "removed": [ [z, x, y], … ]
+ *  }
+ *  @endcode
+ *
+ *  Tile coordinates follow the XYZ scheme, with rows counted from the top. The
+ *  tile URL template may be relative to the URL of the manifest.
+ *
+ *  This class downloads the manifest and all changed tiles, checks the hash
+ *  of every tile and then emits the signal finished(). The tiles can then be
+ *  written to the MBTILES file with FileFormats::MBTILES::writeTiles(). If no
+ *  manifest exists, or if anything goes wrong, the update fails and the caller
+ *  should download the whole file instead.
+ */
+
+class DeltaUpdate : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Standard constructor
+     *
+     *  The constructor starts the download of the manifest.
+     *
+     *  @param url URL of the MBTILES file
+     *
+     *  @param baseRelease Value of the metadata entry "release" of the local
+     *  copy of the MBTILES file
+     *
+     *  @param parent The standard QObject parent pointer
+     */
+    explicit DeltaUpdate(const QUrl& url, const QString& baseRelease, QObject* parent = nullptr);
+
+    /*! \brief Standard destructor
+     *
+     *  The destructor aborts all running downloads.
+     */
+    ~DeltaUpdate() override;
+
+    /*! \brief Maximal number of tiles in a delta update
+     *
+     *  If more tiles have changed, downloading the whole file is more efficient
+     *  and the update fails.
+     */
+    static constexpr qsizetype maxTiles = 20000;
+
+    /*! \brief New release
+     *
+     *  @returns Value of the metadata entry "release" after the update. This
+     *  is meaningful only after the update finished successfully.
+     */
+    [[nodiscard]] QString release() const { return m_release; }
+
+    /*! \brief Changed tiles
+     *
+     *  @returns List of tiles that need to be written to the MBTILES file,
+     *  with empty data for tiles that need to be removed. This is meaningful
+     *  only after the update finished successfully.
+     */
+    [[nodiscard]] QList<FileFormats::MBTILES::TileData> tiles() const { return m_tiles; }
+
+signals:
+    /*! \brief Download progress
+     *
+     *  @param percentage An integer between 0 and 100
+     */
+    void progress(int percentage);
+
+    /*! \brief Update finished
+     *
+     *  This signal is emitted exactly once.
+     *
+     *  @param success True if the manifest and all tiles have been downloaded
+     *  and verified
+     */
+    void finished(bool success);
+
+private:
+    Q_DISABLE_COPY_MOVE(DeltaUpdate)
+
+    // Maximal number of tile requests that run in parallel
+    static constexpr qsizetype maxParallelRequests = 8;
+
+    // Aborts all requests and emits finished()
+    void fail(const QString& reason);
+
+    // Starts tile requests, until maxParallelRequests are running. Emits
+    // finished() when all tiles have been received.
+    void fetchTiles();
+
+    // Parses the manifest and fills m_pendingTiles and m_tiles
+    void manifestFinished();
+
+    // Checks tile data and stores it in m_tiles
+    void tileFinished(QNetworkReply* reply, qsizetype index);
+
+    // Manifest download, or nullptr
+    QPointer<QNetworkReply> m_manifestReply;
+
+    // Running tile downloads
+    QList<QPointer<QNetworkReply>> m_tileReplies;
+
+    // Indices into m_tiles of tiles that still need to be requested
+    QQueue<qsizetype> m_pendingTiles;
+
+    // Expected SHA-256 hashes of the tiles in m_tiles, empty for removed tiles
+    QList<QByteArray> m_hashes;
+
+    // Tiles that have changed
+    QList<FileFormats::MBTILES::TileData> m_tiles;
+
+    // Number of tiles received so far, and number of tiles to download
+    qsizetype m_tilesReceived {0};
+    qsizetype m_tilesToDownload {0};
+
+    // Base release, as set in the constructor, and new release
+    QString m_baseRelease;
+    QString m_release;
+
+    // URL of the manifest, and URL template of the tiles, possibly relative
+    // to the URL of the manifest
+    QUrl m_manifestURL;
+    QString m_tileURLTemplate;
+
+    // Set once finished() has been emitted
+    bool m_finished {false};
+};
+
+} // namespace DataManagement
@@ -0,0 +1,270 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include "dataManagement/DownloadScheduler.h"
+#include "dataManagement/Downloadable_SingleFile.h"
+#include "positioning/PositionProvider.h"
+
+using namespace std::chrono_literals;
+
+
+namespace {
+
+// Order in which items of different content types are started
+int priorityClass(DataManagement::Downloadable_Abstract* item)
+{
+    switch(item->contentType())
+    {
+    case DataManagement::Downloadable_Abstract::AviationMap:
+    case DataManagement::Downloadable_Abstract::Data:
+        return 0;
+    case DataManagement::Downloadable_Abstract::VAC:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+} // namespace
+
+
+DataManagement::DownloadScheduler::DownloadScheduler(QObject* parent)
+    : QObject(parent)
+{
+    m_statisticsTimer.setInterval(1s);
+    connect(&m_statisticsTimer, &QTimer::timeout, this, &DownloadScheduler::updateStatistics);
+}
+
+
+
+//
+// Setter Methods
+//
+
+void DataManagement::DownloadScheduler::setMaxConcurrentDownloads(int max)
+{
+    if ((max < 1) || (max == m_maxConcurrentDownloads))
+    {
+        return;
+    }
+    m_maxConcurrentDownloads = max;
+    emit maxConcurrentDownloadsChanged();
+    schedule();
+}
+
+
+
+//
+// Methods
+//
+
+void DataManagement::DownloadScheduler::cancel(DataManagement::Downloadable_Abstract* item)
+{
+    auto oldPending = pending();
+    m_queue.removeIf([item](const Job& job) { return job.item == item; });
+    if (pending() != oldPending)
+    {
+        emit pendingChanged();
+        schedule();
+    }
+}
+
+
+void DataManagement::DownloadScheduler::enqueue(DataManagement::Downloadable_Abstract* item, DataManagement::DownloadScheduler::Action action)
+{
+    if ((item == nullptr) || item->downloading() || m_running.contains(item))
+    {
+        return;
+    }
+    if (std::any_of(m_queue.cbegin(), m_queue.cend(), [item](const Job& job) { return job.item == item; }))
+    {
+        return;
+    }
+
+    m_queue.append({item, action});
+    connect(item, &Downloadable_Abstract::downloadingChanged, this, &DownloadScheduler::schedule, Qt::UniqueConnection);
+    emit pendingChanged();
+    schedule();
+}
+
+
+
+//
+// Private Methods
+//
+
+auto DataManagement::DownloadScheduler::bytesDone() const -> qint64
+{
+    auto result = m_bytesFinished;
+    for(const auto& item : m_running)
+    {
+        auto* singleFile = qobject_cast<Downloadable_SingleFile*>(item);
+        if ((singleFile != nullptr) && (singleFile->remoteFileSize() > 0))
+        {
+            result += (singleFile->remoteFileSize()*singleFile->downloadProgress())/100;
+        }
+    }
+    return result;
+}
+
+
+auto DataManagement::DownloadScheduler::bytesRemaining() const -> qint64
+{
+    qint64 result = 0;
+    for(const auto& item : m_running)
+    {
+        auto* singleFile = qobject_cast<Downloadable_SingleFile*>(item);
+        if ((singleFile != nullptr) && (singleFile->remoteFileSize() > 0))
+        {
+            result += (singleFile->remoteFileSize()*(100-singleFile->downloadProgress()))/100;
+        }
+    }
+    for(const auto& job : m_queue)
+    {
+        if (!job.item.isNull() && (job.item->remoteFileSize() > 0))
+        {
+            result += job.item->remoteFileSize();
+        }
+    }
+    return result;
+}
+
+
+void DataManagement::DownloadScheduler::schedule()
+{
+    if (m_scheduling)
+    {
+        return;
+    }
+    m_scheduling = true;
+    auto oldPending = pending();
+
+    // Remove items that have finished. Items that are deleted while
+    // downloading are simply forgotten.
+    for(auto it = m_running.begin(); it != m_running.end(); )
+    {
+        if (it->isNull())
+        {
+            it = m_running.erase(it);
+            continue;
+        }
+        if (!(*it)->downloading())
+        {
+            m_bytesFinished += qMax(qint64(0), (*it)->remoteFileSize());
+            disconnect(*it, nullptr, this, nullptr);
+            it = m_running.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    m_queue.removeIf([](const Job& job) { return job.item.isNull(); });
+
+    // Start queued items
+    auto position = Positioning::PositionProvider::lastValidCoordinate();
+    while(!m_queue.isEmpty() && (m_running.size() < m_maxConcurrentDownloads))
+    {
+        // Find the queued item that should be started next. Items without
+        // bounding box are treated as nearby.
+        auto distance = [&position](Downloadable_Abstract* item) {
+            auto bBox = item->boundingBox();
+            if (!position.isValid() || !bBox.isValid())
+            {
+                return 0.0;
+            }
+            return bBox.contains(position) ? 0.0 : bBox.center().distanceTo(position);
+        };
+        auto best = std::min_element(m_queue.begin(), m_queue.end(), [&distance](const Job& first, const Job& second) {
+            auto firstClass = priorityClass(first.item);
+            auto secondClass = priorityClass(second.item);
+            if (firstClass != secondClass)
+            {
+                return firstClass < secondClass;
+            }
+            return distance(first.item) < distance(second.item);
+        });
+        auto job = *best;
+        m_queue.erase(best);
+
+        if (job.action == Update)
+        {
+            job.item->update();
+        }
+        else
+        {
+            job.item->startDownload();
+        }
+
+        // Items with nothing to download do not occupy a slot
+        if (job.item->downloading())
+        {
+            m_running.append(job.item);
+        }
+        else
+        {
+            disconnect(job.item, nullptr, this, nullptr);
+        }
+    }
+
+    // Start or stop statistics
+    if (m_running.isEmpty() && m_queue.isEmpty())
+    {
+        m_statisticsTimer.stop();
+        m_bytesFinished = 0;
+        m_bytesAtLastSample = 0;
+        m_throughput = 0;
+        m_eta = {};
+        emit statisticsChanged();
+    }
+    else if (!m_statisticsTimer.isActive())
+    {
+        m_bytesAtLastSample = bytesDone();
+        m_statisticsTimer.start();
+    }
+
+    m_scheduling = false;
+    if (pending() != oldPending)
+    {
+        emit pendingChanged();
+    }
+}
+
+
+void DataManagement::DownloadScheduler::updateStatistics()
+{
+    // Exponential moving average of the bytes received per second, so that
+    // the estimate does not jump with every network hiccup
+    auto done = bytesDone();
+    auto sample = static_cast<double>(qMax(qint64(0), done-m_bytesAtLastSample));
+    m_bytesAtLastSample = done;
+    auto throughput = (m_throughput == 0) ? sample : (0.7*static_cast<double>(m_throughput) + 0.3*sample);
+    m_throughput = static_cast<size_t>(throughput);
+
+    if (throughput > 0.0)
+    {
+        m_eta = Units::Timespan::fromS(static_cast<double>(bytesRemaining())/throughput);
+    }
+    else
+    {
+        m_eta = {};
+    }
+    emit statisticsChanged();
+}
@@ -0,0 +1,222 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QPointer>
+#include <QQmlEngine>
+#include <QTimer>
+
+#include "dataManagement/Downloadable_Abstract.h"
+#include "units/ByteSize.h"
+#include "units/Timespan.h"
+
+namespace DataManagement {
+
+
+/*! \brief Queue for downloads and updates
+ *
+ *  This class limits the number of downloads that run at the same time. Items
+ *  are started in the following order.
+ *
+ *  - Aviation maps and data, which are small and needed for safe operation
+ *
+ *  - Visual approach charts
+ *
+ *  - All other items, ordered by the distance of their bounding box to the
+ *    last valid position, nearest first
+ *
+ *  Items of the same order are started in the order in which they were
+ *  queued. The class also estimates the aggregate throughput of all downloads
+ *  and the time until the queue is empty.
+ *
+ *  There exists one instance of this class, owned by the DataManager.
+ */
+
+class DownloadScheduler : public QObject {
+    Q_OBJECT
+    QML_ELEMENT
+    QML_UNCREATABLE("")
+
+public:
+    /*! \brief Action for an item in the queue */
+    enum Action : quint8 {
+        Download, /*!< \brief Call startDownload() */
+        Update    /*!< \brief Call update() */
+    };
+    Q_ENUM(Action)
+
+    /*! \brief Standard constructor
+     *
+     *  @param parent The standard QObject parent pointer.
+     */
+    explicit DownloadScheduler(QObject* parent = nullptr);
+
+    /*! \brief Standard destructor */
+    ~DownloadScheduler() override = default;
+
+
+
+    //
+    // PROPERTIES
+    //
+
+    /*! \brief Estimated time until all queued downloads are finished
+     *
+     *  If no estimate is available, this property holds a timespan that is not
+     *  finite.
+     */
+    Q_PROPERTY(Units::Timespan eta READ eta NOTIFY statisticsChanged)
+
+    /*! \brief Maximal number of downloads that run at the same time
+     *
+     *  The default value is 2. Values smaller than 1 are ignored.
+     */
+    Q_PROPERTY(int maxConcurrentDownloads READ maxConcurrentDownloads WRITE setMaxConcurrentDownloads NOTIFY maxConcurrentDownloadsChanged)
+
+    /*! \brief Number of items that are queued or downloading */
+    Q_PROPERTY(qsizetype pending READ pending NOTIFY pendingChanged)
+
+    /*! \brief Aggregate throughput of all running downloads, in bytes per second */
+    Q_PROPERTY(Units::ByteSize throughput READ throughput NOTIFY statisticsChanged)
+
+
+
+    //
+    // Getter Methods
+    //
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property eta
+     */
+    [[nodiscard]] Units::Timespan eta() const { return m_eta; }
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property maxConcurrentDownloads
+     */
+    [[nodiscard]] int maxConcurrentDownloads() const { return m_maxConcurrentDownloads; }
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property pending
+     */
+    [[nodiscard]] qsizetype pending() const { return m_queue.size() + m_running.size(); }
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property throughput
+     */
+    [[nodiscard]] Units::ByteSize throughput() const { return m_throughput; }
+
+
+
+    //
+    // Setter Methods
+    //
+
+    /*! \brief Setter function for the property with the same name
+     *
+     *  @param max Property maxConcurrentDownloads
+     */
+    void setMaxConcurrentDownloads(int max);
+
+
+
+    //
+    // Methods
+    //
+
+    /*! \brief Remove an item from the queue
+     *
+     *  Downloads that are already running are not affected.
+     *
+     *  @param item Item to be removed
+     */
+    Q_INVOKABLE void cancel(DataManagement::Downloadable_Abstract* item);
+
+    /*! \brief Add an item to the queue
+     *
+     *  If the item is already queued or downloading, nothing happens. Items of
+     *  type Downloadable_MultiFile should not be queued; queue their children
+     *  instead.
+     *
+     *  @param item Item to be queued
+     *
+     *  @param action Method of the item that will be called once the item is
+     *  started
+     */
+    Q_INVOKABLE void enqueue(DataManagement::Downloadable_Abstract* item, DataManagement::DownloadScheduler::Action action);
+
+signals:
+    /*! \brief Notifier signal */
+    void maxConcurrentDownloadsChanged();
+
+    /*! \brief Notifier signal */
+    void pendingChanged();
+
+    /*! \brief Notifier signal for the properties eta and throughput */
+    void statisticsChanged();
+
+private:
+    Q_DISABLE_COPY_MOVE(DownloadScheduler)
+
+    // Bytes downloaded so far in the current batch, and bytes still to be
+    // downloaded. These numbers are estimated from the remote file sizes and
+    // the download progress of the items.
+    [[nodiscard]] qint64 bytesDone() const;
+    [[nodiscard]] qint64 bytesRemaining() const;
+
+    // Removes finished items from m_running and starts queued items, as long
+    // as fewer than m_maxConcurrentDownloads items are running
+    void schedule();
+
+    // Updates throughput and ETA. Called once per second while items are
+    // running.
+    void updateStatistics();
+
+    struct Job
+    {
+        QPointer<DataManagement::Downloadable_Abstract> item;
+        Action action {Download};
+    };
+
+    // Queued and running items
+    QList<Job> m_queue;
+    QList<QPointer<DataManagement::Downloadable_Abstract>> m_running;
+
+    int m_maxConcurrentDownloads {2};
+
+    // Set while schedule() runs, to avoid recursion through the
+    // downloadingChanged() signals of the items that are started
+    bool m_scheduling {false};
+
+    // Statistics for the current batch of downloads. A batch begins when an
+    // item is queued while the queue is empty, and ends when the queue is
+    // empty again.
+    qint64 m_bytesFinished {0};
+    qint64 m_bytesAtLastSample {0};
+    Units::ByteSize m_throughput {0};
+    Units::Timespan m_eta;
+    QTimer m_statisticsTimer;
+};
+
+} // namespace DataManagement
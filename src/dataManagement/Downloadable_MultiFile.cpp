@@ -21,6 +21,7 @@
 #include <QPointer>
 
 #include "Downloadable_MultiFile.h"
+#include "dataManagement/DataManager.h"
 
 using namespace Qt::Literals::StringLiterals;
 
@@ -130,8 +131,11 @@ auto DataManagement::Downloadable_MultiFile::infoText() -> QString
 
 void DataManagement::Downloadable_MultiFile::add(DataManagement::Downloadable_Abstract* map)
 {
-    if (rawAdd(map))
+    auto list = m_downloadables.value();
+    if (rawAdd(map, list))
     {
+        m_downloadables = list;
+
         evaluateDownloading();
         evaluateFiles();
         evaluateRemoteFileSize();
@@ -145,14 +149,17 @@ void DataManagement::Downloadable_MultiFile::add(DataManagement::Downloadable_Ab
 
 void DataManagement::Downloadable_MultiFile::add(const QVector<DataManagement::Downloadable_Abstract*>& maps)
 {
-    auto cache = m_downloadables.value().size();
+    auto list = m_downloadables.value();
+    bool added = false;
     foreach(auto map, maps)
     {
-        rawAdd(map);
+        added = rawAdd(map, list) || added;
     }
 
-    if (cache != m_downloadables.value().size())
+    if (added)
     {
+        m_downloadables = list;
+
         evaluateDownloading();
         evaluateFiles();
         evaluateRemoteFileSize();
@@ -176,6 +183,7 @@ void DataManagement::Downloadable_MultiFile::clear()
         disconnect(map, nullptr, this, nullptr);
     }
     m_downloadables = QVector<QPointer<DataManagement::Downloadable_Abstract>>();
+    invalidateDownloadablesSorted();
 
     emit descriptionChanged();
     emit downloadablesChanged();
@@ -202,6 +210,11 @@ void DataManagement::Downloadable_MultiFile::deleteFiles()
 
 QVector<DataManagement::Downloadable_Abstract*> DataManagement::Downloadable_MultiFile::downloadables()
 {
+    if (m_downloadablesSortedValid)
+    {
+        return m_downloadablesSorted;
+    }
+
     QVector<DataManagement::Downloadable_Abstract*> result;
     foreach(auto downloadable, m_downloadables.value())
     {
@@ -227,6 +240,8 @@ QVector<DataManagement::Downloadable_Abstract*> DataManagement::Downloadable_Mul
     }
     );
 
+    m_downloadablesSorted = result;
+    m_downloadablesSortedValid = true;
     return result;
 }
 
@@ -301,7 +316,7 @@ void DataManagement::Downloadable_MultiFile::startDownload()
         {
             continue;
         }
-        map->startDownload();
+        schedule(map, false);
     }
 }
 
@@ -314,6 +329,7 @@ void DataManagement::Downloadable_MultiFile::stopDownload()
         {
             continue;
         }
+        GlobalObject::dataManager()->downloadScheduler()->cancel(map);
         map->stopDownload();
     }
 }
@@ -335,13 +351,13 @@ void DataManagement::Downloadable_MultiFile::update()
 
         if (map->hasFile())
         {
-            map->update();
+            schedule(map, true);
         }
         else
         {
             if (m_updatePolicy == MultiUpdate)
             {
-                map->startDownload();
+                schedule(map, false);
             }
         }
     }
@@ -359,6 +375,7 @@ void DataManagement::Downloadable_MultiFile::remove(DataManagement::Downloadable
     auto tmp = m_downloadables.value();
     tmp.removeAll(map);
     m_downloadables = tmp;
+    invalidateDownloadablesSorted();
 
     emit descriptionChanged();
     emit downloadablesChanged();
@@ -496,14 +513,33 @@ void DataManagement::Downloadable_MultiFile::evaluateUpdateSize()
 }
 
 
-bool DataManagement::Downloadable_MultiFile::rawAdd(DataManagement::Downloadable_Abstract* map)
+void DataManagement::Downloadable_MultiFile::schedule(DataManagement::Downloadable_Abstract* map, bool update)
+{
+    auto* multiFile = qobject_cast<Downloadable_MultiFile*>(map);
+    if (multiFile != nullptr)
+    {
+        if (update)
+        {
+            multiFile->update();
+        }
+        else
+        {
+            multiFile->startDownload();
+        }
+        return;
+    }
+    GlobalObject::dataManager()->downloadScheduler()->enqueue(map, update ? DownloadScheduler::Update : DownloadScheduler::Download);
+}
+
+
+bool DataManagement::Downloadable_MultiFile::rawAdd(DataManagement::Downloadable_Abstract* map, QVector<QPointer<DataManagement::Downloadable_Abstract>>& list)
 {
     // Safety checks
     if (map == nullptr)
     {
         return false;
     }
-    if (m_downloadables.value().contains(map))
+    if (list.contains(map))
     {
         return false;
     }
@@ -523,6 +559,13 @@ bool DataManagement::Downloadable_MultiFile::rawAdd(DataManagement::Downloadable
     connect(map, &DataManagement::Downloadable_Abstract::remoteFileSizeChanged, this, &DataManagement::Downloadable_MultiFile::evaluateUpdateSize, Qt::QueuedConnection);
     connect(map, &DataManagement::Downloadable_Abstract::updateSizeChanged, this, &DataManagement::Downloadable_MultiFile::evaluateUpdateSize, Qt::QueuedConnection);
 
+    // Wire up: the sorted list of members is outdated when members change
+    // their name or get destroyed. Connect directly, so that the cached list
+    // never holds dangling pointers.
+    connect(map, &QObject::destroyed, this, &DataManagement::Downloadable_MultiFile::invalidateDownloadablesSorted);
+    connect(map, &QObject::objectNameChanged, this, &DataManagement::Downloadable_MultiFile::invalidateDownloadablesSorted);
+    connect(map, &DataManagement::Downloadable_Abstract::sectionChanged, this, &DataManagement::Downloadable_MultiFile::invalidateDownloadablesSorted);
+
     // Wire up: when the new member gets destroyed, we need to change all properties.
     connect(map, &QObject::destroyed, this, &DataManagement::Downloadable_MultiFile::descriptionChanged);
     connect(map, &QObject::destroyed, this, &DataManagement::Downloadable_MultiFile::downloadablesChanged);
@@ -542,9 +585,8 @@ bool DataManagement::Downloadable_MultiFile::rawAdd(DataManagement::Downloadable
     setBoundingBox(map->boundingBox());
 
     // Add downloadable
-    auto tmp = m_downloadables.value();
-    tmp.append(map);
-    m_downloadables = tmp;
+    list.append(map);
+    invalidateDownloadablesSorted();
 
     return true;
 }
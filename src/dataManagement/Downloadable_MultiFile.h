@@ -82,6 +82,8 @@ public:
     [[nodiscard]] auto description() -> QString override;
 
     /*! \brief Getter function for the property with the same name
+     *
+     *   The sorted list is cached, so that repeated calls are cheap.
      *
      *   @returns Property downloadables
      */
@@ -172,13 +174,25 @@ public:
      */
     Q_INVOKABLE void remove(DataManagement::Downloadable_Abstract* map);
 
-    /*! \brief Implementation of pure virtual method from Downloadable_Abstract */
+    /*! \brief Implementation of pure virtual method from Downloadable_Abstract
+     *
+     *  The children are not started directly, but queued in the
+     *  DownloadScheduler of the DataManager.
+     */
     Q_INVOKABLE void startDownload() override;
 
-    /*! \brief Implementation of pure virtual method from Downloadable_Abstract */
+    /*! \brief Implementation of pure virtual method from Downloadable_Abstract
+     *
+     *  This method also removes the children from the queue of the
+     *  DownloadScheduler.
+     */
     Q_INVOKABLE void stopDownload() override;
 
-    /*! \brief Implementation of pure virtual method from Downloadable_Abstract */
+    /*! \brief Implementation of pure virtual method from Downloadable_Abstract
+     *
+     *  The children are not updated directly, but queued in the
+     *  DownloadScheduler of the DataManager.
+     */
     Q_INVOKABLE void update() override;
 
 signals:
@@ -193,9 +207,19 @@ private:
     void evaluateRemoteFileSize();
     void evaluateUpdateSize();
 
-    // Similar to 'add', but does not emit any notifier signals
-    // Returns 'true' if item has actually been added.
-    bool rawAdd(DataManagement::Downloadable_Abstract* map);
+    // Downloads or updates a child. Children of type Downloadable_MultiFile
+    // handle this themselves, all others are queued in the DownloadScheduler.
+    void schedule(DataManagement::Downloadable_Abstract* map, bool update);
+
+    // Similar to 'add', but does not emit any notifier signals and appends the
+    // item to 'list' rather than to m_downloadables, so that several items can
+    // be added without copying m_downloadables each time. Returns 'true' if
+    // item has actually been added.
+    bool rawAdd(DataManagement::Downloadable_Abstract* map, QVector<QPointer<DataManagement::Downloadable_Abstract>>& list);
+
+    // Marks m_downloadablesSorted as outdated. Called whenever children are
+    // added, removed or destroyed, or when their section or name changes.
+    void invalidateDownloadablesSorted() { m_downloadablesSortedValid = false; }
 
     bool m_downloading {false};
     QStringList m_files;
@@ -203,6 +227,10 @@ private:
     qint64 m_updateSize {0};
 
     QProperty<QVector<QPointer<DataManagement::Downloadable_Abstract>>> m_downloadables;
+
+    // Cached return value of downloadables()
+    QVector<DataManagement::Downloadable_Abstract*> m_downloadablesSorted;
+    bool m_downloadablesSortedValid {false};
     DataManagement::Downloadable_MultiFile::UpdatePolicy m_updatePolicy;
 };
 
@@ -18,19 +18,128 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QDataStream>
 #include <QDir>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QLocale>
 #include <QLockFile>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QtConcurrent/QtConcurrentRun>
+#include <filesystem>
 
 #include "Downloadable_SingleFile.h"
 #include "GlobalObject.h"
 #include "GlobalSettings.h"
+#include "dataManagement/DataManager.h"
 #include "fileFormats/MBTILES.h"
 
 using namespace Qt::Literals::StringLiterals;
 
 
+namespace {
+
+// Information about a partial download, stored next to the partial data. The
+// validators are used with an "If-Range" header, so that the server sends the
+// full file if it has changed in the meantime.
+struct PartialDownloadInfo
+{
+    QUrl url;
+    QDateTime lastModified;
+    QByteArray eTag;
+    qint64 totalSize {-1};
+};
+
+QDataStream& operator<<(QDataStream& stream, const PartialDownloadInfo& info)
+{
+    return stream << info.url << info.lastModified << info.eTag << info.totalSize;
+}
+
+QDataStream& operator>>(QDataStream& stream, PartialDownloadInfo& info)
+{
+    return stream >> info.url >> info.lastModified >> info.eTag >> info.totalSize;
+}
+
+// Checks that a downloaded file is structurally sound, so that broken files
+// never reach the map engine. The type of the file is deduced from the name of
+// the local file. If expectedHash is not empty, the SHA-256 digest of the file
+// is checked as well. Returns a human-readable error message, or an empty
+// string on success. This function is reentrant and runs on a worker thread.
+QString verifyFile(const QString& fileName, const QString& localFileName, const QByteArray& expectedHash)
+{
+    if (!expectedHash.isEmpty())
+    {
+        QFile file(fileName);
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        if (!file.open(QIODevice::ReadOnly) || !hash.addData(&file))
+        {
+            return file.errorString();
+        }
+        if (hash.result() != expectedHash)
+        {
+            return QObject::tr("checksum mismatch", "DataManagement::Downloadable_SingleFile");
+        }
+    }
+
+    if (localFileName.endsWith(u".geojson"_s))
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return file.errorString();
+        }
+        QJsonParseError parseError {};
+        auto document = QJsonDocument::fromJson(file.readAll(), &parseError);
+        if (parseError.error != QJsonParseError::NoError)
+        {
+            return parseError.errorString();
+        }
+        if (!document.isObject())
+        {
+            return QObject::tr("no JSON object", "DataManagement::Downloadable_SingleFile");
+        }
+        return {};
+    }
+
+    if (localFileName.endsWith(u".mbtiles"_s) || localFileName.endsWith(u".raster"_s) || localFileName.endsWith(u".terrain"_s))
+    {
+        QString result;
+        auto connectionName = u"DataManagement::Downloadable_SingleFile %1,%2"_s.arg(fileName).arg(QRandomGenerator::global()->generate());
+        {
+            auto dataBase = QSqlDatabase::addDatabase(u"QSQLITE"_s, connectionName);
+            dataBase.setDatabaseName(fileName);
+            dataBase.setConnectOptions(u"QSQLITE_OPEN_READONLY"_s);
+            if (dataBase.open())
+            {
+                QSqlQuery query(dataBase);
+                if (!query.exec(u"PRAGMA quick_check;"_s) || !query.first() || (query.value(0).toString() != u"ok"_s))
+                {
+                    result = QObject::tr("SQLite integrity check failed", "DataManagement::Downloadable_SingleFile");
+                }
+                else if (!query.exec(u"select name, value from metadata;"_s) || !query.exec(u"select zoom_level from tiles limit 1;"_s))
+                {
+                    result = QObject::tr("no MBTILES file", "DataManagement::Downloadable_SingleFile");
+                }
+                query.finish();
+                dataBase.close();
+            }
+            else
+            {
+                result = QObject::tr("unable to open SQLite database", "DataManagement::Downloadable_SingleFile");
+            }
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+        return result;
+    }
+
+    return {};
+}
+
+} // namespace
+
+
 DataManagement::Downloadable_SingleFile::Downloadable_SingleFile(QUrl url, const QString& fileName, const QGeoRectangle& bBox, QObject* parent)
     : Downloadable_Abstract(parent), m_url(std::move(url))
 {
@@ -104,7 +213,9 @@ DataManagement::Downloadable_SingleFile::~Downloadable_SingleFile()
         m_networkReplyDownloadHeader->abort();
         delete m_networkReplyDownloadHeader;
     }
-    delete m_saveFile;
+    delete m_partFile;
+    delete m_deltaUpdate;
+    delete m_verifier;
 }
 
 
@@ -288,6 +399,17 @@ void DataManagement::Downloadable_SingleFile::setRemoteFileDate(const QDateTime
 }
 
 
+void DataManagement::Downloadable_SingleFile::setRemoteFileHash(const QByteArray& hash)
+{
+    if (hash == m_remoteFileHash)
+    {
+        return;
+    }
+    m_remoteFileHash = hash;
+    emit remoteFileHashChanged();
+}
+
+
 void DataManagement::Downloadable_SingleFile::setRemoteFileSize(qint64 size)
 {
     // Paranoid safety checks
@@ -324,6 +446,12 @@ void DataManagement::Downloadable_SingleFile::setRemoteFileSize(qint64 size)
 
 void DataManagement::Downloadable_SingleFile::deleteFiles()
 {
+    // Make sure that the scheduler does not start a queued download later
+    if (GlobalObject::canConstruct())
+    {
+        GlobalObject::dataManager()->downloadScheduler()->cancel(this);
+    }
+
     // If the local file does not exist, there is nothing to do
     if (!QFile::exists(m_fileName))
     {
@@ -338,7 +466,12 @@ void DataManagement::Downloadable_SingleFile::deleteFiles()
     lockFile.lock();
     QFile::remove(m_fileName);
     lockFile.unlock();
+    QFile::remove(validatorsFileName());
     m_hasFile = QFile::exists(m_fileName);
+    if (!downloading())
+    {
+        discardPartialDownload();
+    }
     emit fileContentChanged();
 
     // Emit signals as appropriate
@@ -363,8 +496,8 @@ void DataManagement::Downloadable_SingleFile::startDownload()
     auto oldDownloadProgress = m_downloadProgress;
     auto oldIsDownloading = downloading();
 
-    // Clear temporary file
-    delete m_saveFile;
+    // Close partial file, if still open
+    delete m_partFile;
 
     // Create directory that will hold the local file, if it does not yet exist
     QDir const dir(QFileInfo(m_fileName).dir());
@@ -373,14 +506,114 @@ void DataManagement::Downloadable_SingleFile::startDownload()
         dir.mkpath(QStringLiteral("."));
     }
 
-    // Copy the temporary file to the local file
-    m_saveFile = new QSaveFile(m_fileName, this);
-    m_saveFile->open(QIODevice::WriteOnly);
+    // Check if an earlier download can be resumed. This requires information
+    // about the partial data, for the same URL. If the remote file is known to
+    // be newer than the partial data, the partial data is useless.
+    PartialDownloadInfo info;
+    {
+        QFile infoFile(partInfoFileName());
+        if (infoFile.open(QIODevice::ReadOnly))
+        {
+            QDataStream stream(&infoFile);
+            stream >> info;
+            if (stream.status() != QDataStream::Ok)
+            {
+                info = {};
+            }
+        }
+    }
+    bool resumable = (info.url == m_url)
+                     && (info.lastModified.isValid() || !info.eTag.isEmpty())
+                     && (!m_remoteFileDate.isValid() || !info.lastModified.isValid() || (m_remoteFileDate <= info.lastModified))
+                     && ((m_remoteFileSize <= 0) || (info.totalSize <= 0) || (m_remoteFileSize == info.totalSize));
+    if (!resumable)
+    {
+        discardPartialDownload();
+    }
+
+    // If the partial data is complete, an earlier attempt to install it has
+    // failed. Check and install it again, without asking the server for bytes
+    // beyond the end of the file.
+    if (resumable && (info.totalSize > 0) && (QFileInfo(partFileName()).size() == info.totalSize))
+    {
+        m_responseLastModified = info.lastModified;
+        m_responseETag = info.eTag;
+        m_downloadProgress = 100;
+        m_verifier = new QFutureWatcher<QString>(this);
+        connect(m_verifier, &QFutureWatcher<QString>::finished, this, &Downloadable_SingleFile::installDownloadedFile);
+        m_verifier->setFuture(QtConcurrent::run(verifyFile, partFileName(), m_fileName, m_remoteFileHash));
+        if (m_downloadProgress != oldDownloadProgress)
+        {
+            emit downloadProgressChanged(m_downloadProgress);
+        }
+        emit downloadingChanged();
+        return;
+    }
 
-    // Start download
-    QNetworkRequest const request(m_url);
+    // Open the file for partial data. Data received is appended.
+    m_partFile = new QFile(partFileName(), this);
+    if (!m_partFile->open(QIODevice::Append))
+    {
+        auto message = m_partFile->errorString();
+        delete m_partFile;
+        emit error(objectName(), tr("cannot write file %1 (%2)").arg(partFileName(), message));
+        return;
+    }
+    m_resumeOffset = m_partFile->size();
+    m_expectedSize = -1;
+    m_responseChecked = false;
+    m_responseAccepted = false;
+    m_responseLastModified = {};
+    m_responseETag = {};
+
+    // The digest covers only the data received from now on. If the download
+    // is resumed, the whole file is hashed on a worker thread once it is
+    // complete.
+    m_partFileHash.reset();
+
+    // Start download. If partial data exists, ask only for the missing bytes.
+    // Compression is switched off for resumed downloads, because the byte
+    // offsets refer to the uncompressed file.
+    QNetworkRequest request(m_url);
+    if (m_resumeOffset > 0)
+    {
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(m_resumeOffset) + "-");
+        request.setRawHeader("Accept-Encoding", "identity");
+        if (!info.eTag.isEmpty() && !info.eTag.startsWith("W/"))
+        {
+            request.setRawHeader("If-Range", info.eTag);
+        }
+        else
+        {
+            request.setRawHeader("If-Range", QLocale::c().toString(info.lastModified.toUTC(), u"ddd, dd MMM yyyy hh:mm:ss 'GMT'"_s).toLatin1());
+        }
+    }
+    else if (m_conditionalDownload && m_hasFile)
+    {
+        // Ask the server to send data only if the remote file differs from the
+        // local file
+        PartialDownloadInfo validators;
+        QFile validatorsFile(validatorsFileName());
+        if (validatorsFile.open(QIODevice::ReadOnly))
+        {
+            QDataStream stream(&validatorsFile);
+            stream >> validators;
+        }
+        if (validators.url == m_url)
+        {
+            if (!validators.eTag.isEmpty())
+            {
+                request.setRawHeader("If-None-Match", validators.eTag);
+            }
+            if (validators.lastModified.isValid())
+            {
+                request.setRawHeader("If-Modified-Since", QLocale::c().toString(validators.lastModified.toUTC(), u"ddd, dd MMM yyyy hh:mm:ss 'GMT'"_s).toLatin1());
+            }
+        }
+    }
     m_networkReplyDownloadFile = GlobalObject::networkAccessManager()->get(request);
     connect(m_networkReplyDownloadFile, &QNetworkReply::finished, this, &Downloadable_SingleFile::downloadFileFinished);
+    connect(m_networkReplyDownloadFile, &QNetworkReply::metaDataChanged, this, &Downloadable_SingleFile::downloadFileMetaDataReceiver);
     connect(m_networkReplyDownloadFile, &QNetworkReply::readyRead, this, &Downloadable_SingleFile::downloadFilePartialDataReceiver);
     connect(m_networkReplyDownloadFile, &QNetworkReply::downloadProgress, this, &Downloadable_SingleFile::downloadFileProgressReceiver);
     connect(m_networkReplyDownloadFile, &QNetworkReply::errorOccurred, this, &Downloadable_SingleFile::downloadFileErrorReceiver);
@@ -420,6 +653,12 @@ void DataManagement::Downloadable_SingleFile::startInfoDownload()
 
 void DataManagement::Downloadable_SingleFile::stopDownload()
 {
+    // A download that is queued in the scheduler but not yet running is
+    // removed from the queue
+    if (GlobalObject::canConstruct())
+    {
+        GlobalObject::dataManager()->downloadScheduler()->cancel(this);
+    }
 
     // Do stop a new download if none is already running
     if (!downloading())
@@ -430,10 +669,16 @@ void DataManagement::Downloadable_SingleFile::stopDownload()
     // Save old value to see if anything changed
     auto oldUpdateSize = updateSize();
 
-    // Stop the download
-    m_networkReplyDownloadFile->deleteLater();
-    m_networkReplyDownloadFile = nullptr;
-    delete m_saveFile;
+    // Stop the download. The partial data is kept, so that the download can be
+    // resumed later.
+    if (!m_networkReplyDownloadFile.isNull())
+    {
+        m_networkReplyDownloadFile->deleteLater();
+        m_networkReplyDownloadFile = nullptr;
+    }
+    delete m_partFile;
+    delete m_deltaUpdate;
+    delete m_verifier;
 
     // Emit signals as appropriate
     if (oldUpdateSize != updateSize())
@@ -448,7 +693,10 @@ void DataManagement::Downloadable_SingleFile::update()
 {
     if (updateSize() != 0)
     {
-        startDownload();
+        if (!startDeltaUpdate())
+        {
+            startDownload();
+        }
     }
 }
 
@@ -642,8 +890,7 @@ void DataManagement::Downloadable_SingleFile::downloadFileErrorReceiver(QNetwork
 void DataManagement::Downloadable_SingleFile::downloadFileFinished()
 {
     // Paranoid safety checks
-    //  Q_ASSERT(!_networkReplyDownloadFile.isNull() && !_tmpFile.isNull());
-    if (m_networkReplyDownloadFile.isNull() || m_saveFile.isNull())
+    if (m_networkReplyDownloadFile.isNull() || m_partFile.isNull())
     {
         stopDownload();
         return;
@@ -654,8 +901,53 @@ void DataManagement::Downloadable_SingleFile::downloadFileFinished()
         return;
     }
 
+    // If the remote file has not changed, the local file is still current
+    if (m_networkReplyDownloadFile->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+    {
+        stopDownload();
+        discardPartialDownload();
+        emit fileNotModified();
+        return;
+    }
+
     // Read the last remaining bits of data, then close the temporary file
     downloadFilePartialDataReceiver();
+    if (m_partFile.isNull())
+    {
+        return;
+    }
+    m_partFile->close();
+
+    // The server did not send file data. The partial data is kept.
+    if (!m_responseAccepted)
+    {
+        downloadFileErrorReceiver(QNetworkReply::UnknownServerError);
+        return;
+    }
+
+    // Check that the file is complete. Servers sometimes close the connection
+    // without error before all data has been sent.
+    if ((m_expectedSize > 0) && (m_partFile->size() != m_expectedSize))
+    {
+        downloadFileErrorReceiver(QNetworkReply::RemoteHostClosedError);
+        return;
+    }
+
+    // Check the digest. Corrupted data cannot be resumed and is deleted. The
+    // digest of resumed downloads is checked together with the structure of
+    // the file.
+    QByteArray expectedHash;
+    if (m_resumeOffset > 0)
+    {
+        expectedHash = m_remoteFileHash;
+    }
+    else if (!m_remoteFileHash.isEmpty() && (m_partFileHash.result() != m_remoteFileHash))
+    {
+        stopDownload();
+        discardPartialDownload();
+        emit error(objectName(), tr("the downloaded data is corrupted (checksum mismatch)"));
+        return;
+    }
 
     // Download is now finished to 100%
     if (m_downloadProgress != 100)
@@ -664,29 +956,15 @@ void DataManagement::Downloadable_SingleFile::downloadFileFinished()
         emit downloadProgressChanged(m_downloadProgress);
     }
 
-    // Save old value to see if anything changed
-    auto oldUpdateSize = updateSize();
-
-    // Copy the temporary file to the local file
-    emit aboutToChangeFile(m_fileName);
-    QLockFile lockFile(m_fileName + ".lock");
-    lockFile.lock();
-    m_saveFile->commit();
-    lockFile.unlock();
-    m_hasFile = QFile::exists(m_fileName);
-    emit fileContentChanged();
-
-    // Delete the data structures for the download
-    delete m_saveFile;
+    // Delete the data structures for the download and check the file on a
+    // worker thread. The property downloading stays true until the file is
+    // installed.
+    delete m_partFile;
     m_networkReplyDownloadFile->deleteLater();
     m_networkReplyDownloadFile = nullptr;
-
-    // Emit signals as appropriate
-    if (oldUpdateSize != updateSize())
-    {
-        emit updateSizeChanged();
-    }
-    emit downloadingChanged();
+    m_verifier = new QFutureWatcher<QString>(this);
+    connect(m_verifier, &QFutureWatcher<QString>::finished, this, &Downloadable_SingleFile::installDownloadedFile);
+    m_verifier->setFuture(QtConcurrent::run(verifyFile, partFileName(), m_fileName, expectedHash));
 }
 
 
@@ -695,10 +973,16 @@ void DataManagement::Downloadable_SingleFile::downloadFileProgressReceiver(qint6
     auto oldDownloadProgress = m_downloadProgress;
 
     // If the content is compressed, then Qt does not know the total size and will set 'bytesTotal' to -1. In that case, the number _remoteFileSize might be a better estimate.
+    // For resumed downloads, the numbers refer to the missing bytes only.
+    if (bytesTotal >= 0)
+    {
+        bytesTotal += m_resumeOffset;
+    }
     if ((bytesTotal < 0) && (m_remoteFileSize > 0))
     {
         bytesTotal = m_remoteFileSize;
     }
+    bytesReceived += m_resumeOffset;
     if (bytesTotal <= 0)
     {
         m_downloadProgress = 0;
@@ -718,10 +1002,85 @@ void DataManagement::Downloadable_SingleFile::downloadFileProgressReceiver(qint6
 }
 
 
+void DataManagement::Downloadable_SingleFile::downloadFileMetaDataReceiver()
+{
+    // Paranoid safety checks
+    if (m_networkReplyDownloadFile.isNull() || m_partFile.isNull() || m_responseChecked)
+    {
+        return;
+    }
+    if (m_networkReplyDownloadFile->error() != QNetworkReply::NoError)
+    {
+        return;
+    }
+    m_responseChecked = true;
+
+    // A conditional request found the local file current. There is no data.
+    auto status = m_networkReplyDownloadFile->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 304)
+    {
+        return;
+    }
+    m_responseLastModified = m_networkReplyDownloadFile->header(QNetworkRequest::LastModifiedHeader).toDateTime();
+    m_responseETag = m_networkReplyDownloadFile->rawHeader("ETag");
+
+    // If the server sends the requested range, append. If the server sends
+    // the full file, either because it does not support ranges or because the
+    // file has changed, start from scratch. Any other response, such as an
+    // error page from a flaky network, leaves the partial data and the info
+    // file alone. Qt reports HTTP errors only once the reply has finished.
+    auto contentRange = m_networkReplyDownloadFile->rawHeader("Content-Range");
+    qint64 totalSize = -1;
+    if ((status == 206) && (m_resumeOffset > 0) && contentRange.startsWith("bytes " + QByteArray::number(m_resumeOffset) + "-"))
+    {
+        totalSize = contentRange.section('/', 1, 1).toLongLong();
+    }
+    else if (status == 200)
+    {
+        m_resumeOffset = 0;
+        m_partFile->resize(0);
+        m_partFileHash.reset();
+        auto contentLength = m_networkReplyDownloadFile->header(QNetworkRequest::ContentLengthHeader);
+        if (contentLength.isValid())
+        {
+            totalSize = contentLength.toLongLong();
+        }
+    }
+    else
+    {
+        return;
+    }
+    m_expectedSize = totalSize;
+    m_responseAccepted = true;
+
+    // Store information about the partial download. If the server compresses
+    // the content or offers no validator, the download cannot be resumed.
+    PartialDownloadInfo info;
+    info.url = m_url;
+    info.lastModified = m_responseLastModified;
+    info.eTag = m_responseETag;
+    info.totalSize = totalSize;
+    auto contentEncoding = m_networkReplyDownloadFile->rawHeader("Content-Encoding");
+    if ((!contentEncoding.isEmpty() && (contentEncoding != "identity"))
+        || (!info.lastModified.isValid() && info.eTag.isEmpty()))
+    {
+        QFile::remove(partInfoFileName());
+        return;
+    }
+    QSaveFile infoFile(partInfoFileName());
+    if (infoFile.open(QIODevice::WriteOnly))
+    {
+        QDataStream stream(&infoFile);
+        stream << info;
+        infoFile.commit();
+    }
+}
+
+
 void DataManagement::Downloadable_SingleFile::downloadFilePartialDataReceiver()
 {
     // Paranoid safety checks
-    if (m_networkReplyDownloadFile.isNull() || m_saveFile.isNull())
+    if (m_networkReplyDownloadFile.isNull() || m_partFile.isNull())
     {
         stopDownload();
         return;
@@ -730,9 +1089,191 @@ void DataManagement::Downloadable_SingleFile::downloadFilePartialDataReceiver()
     {
         return;
     }
+    if (!m_responseChecked)
+    {
+        downloadFileMetaDataReceiver();
+    }
+
+    // Write all available data to the temporary file. The body of responses
+    // that do not carry file data is dropped.
+    auto data = m_networkReplyDownloadFile->readAll();
+    if (!m_responseAccepted)
+    {
+        return;
+    }
+    m_partFileHash.addData(data);
+    m_partFile->write(data);
+}
+
+
+void DataManagement::Downloadable_SingleFile::deltaUpdateFinished(bool success)
+{
+    // Paranoid safety checks
+    if (m_deltaUpdate.isNull())
+    {
+        return;
+    }
+
+    // Write the changed tiles to the local file
+    QString errorMessage;
+    if (success)
+    {
+        emit aboutToChangeFile(m_fileName);
+        QLockFile lockFile(m_fileName + ".lock");
+        lockFile.lock();
+        {
+            FileFormats::MBTILES mbtiles(m_fileName);
+            errorMessage = mbtiles.isValid() ? mbtiles.writeTiles(m_deltaUpdate->tiles(), {{u"release"_s, m_deltaUpdate->release()}}) : mbtiles.error();
+        }
+        lockFile.unlock();
+        emit fileContentChanged();
+    }
+    m_deltaUpdate->deleteLater();
+    m_deltaUpdate = nullptr;
+
+    // If anything went wrong, download the whole file instead
+    if (!success || !errorMessage.isEmpty())
+    {
+        if (!errorMessage.isEmpty())
+        {
+            qWarning() << "Delta update of" << m_fileName << "failed:" << errorMessage;
+        }
+        startDownload();
+        return;
+    }
+
+    // Download is now finished to 100%
+    if (m_downloadProgress != 100)
+    {
+        m_downloadProgress = 100;
+        emit downloadProgressChanged(m_downloadProgress);
+    }
+    emit updateSizeChanged();
+    emit downloadingChanged();
+}
+
+
+bool DataManagement::Downloadable_SingleFile::startDeltaUpdate()
+{
+    if (downloading() || !m_url.isValid() || !QFile::exists(m_fileName))
+    {
+        return false;
+    }
+    if ((contentType() != BaseMapVector) && (contentType() != BaseMapRaster) && (contentType() != TerrainMap))
+    {
+        return false;
+    }
+
+    // Only files that know their release can be updated tile by tile
+    QString baseRelease;
+    {
+        QLockFile lockFile(m_fileName + ".lock");
+        lockFile.lock();
+        FileFormats::MBTILES const mbtiles(m_fileName);
+        baseRelease = mbtiles.metaData().value(u"release"_s);
+    }
+    if (baseRelease.isEmpty())
+    {
+        return false;
+    }
+
+    m_deltaUpdate = new DeltaUpdate(m_url, baseRelease, this);
+    connect(m_deltaUpdate, &DeltaUpdate::progress, this, [this](int percentage) {
+        if (m_downloadProgress != percentage)
+        {
+            m_downloadProgress = percentage;
+            emit downloadProgressChanged(m_downloadProgress);
+        }
+    });
+    connect(m_deltaUpdate, &DeltaUpdate::finished, this, &Downloadable_SingleFile::deltaUpdateFinished);
+    m_downloadProgress = 0;
+    emit downloadProgressChanged(m_downloadProgress);
+    emit updateSizeChanged();
+    emit downloadingChanged();
+    return true;
+}
+
+
+void DataManagement::Downloadable_SingleFile::installDownloadedFile()
+{
+    // Paranoid safety checks
+    if (m_verifier.isNull())
+    {
+        return;
+    }
+    auto errorMessage = m_verifier->result();
+    m_verifier->deleteLater();
+    m_verifier = nullptr;
+
+    // Save old value to see if anything changed
+    auto oldUpdateSize = updateSize();
+
+    // Broken files are deleted and never reach the local file
+    if (!errorMessage.isEmpty())
+    {
+        discardPartialDownload();
+        emit error(objectName(), tr("the downloaded data is corrupted (%1)").arg(errorMessage));
+        if (oldUpdateSize != updateSize())
+        {
+            emit updateSizeChanged();
+        }
+        emit downloadingChanged();
+        return;
+    }
 
-    // Write all available data to the temporary file
-    m_saveFile->write(m_networkReplyDownloadFile->readAll());
+    // Move the temporary file to the local file. The rename replaces the local
+    // file atomically, as QSaveFile::commit() does.
+    emit aboutToChangeFile(m_fileName);
+    QLockFile lockFile(m_fileName + ".lock");
+    lockFile.lock();
+    std::error_code errorCode;
+    std::filesystem::rename(std::filesystem::path(partFileName().toStdU16String()),
+                            std::filesystem::path(m_fileName.toStdU16String()),
+                            errorCode);
+    lockFile.unlock();
+    if (!errorCode)
+    {
+        // If the rename failed, the complete and verified data is kept, so
+        // that the next attempt need not download it again.
+        discardPartialDownload();
+    }
+    m_hasFile = QFile::exists(m_fileName);
+
+    // Keep the validators of the new local file for conditional downloads
+    QFile::remove(validatorsFileName());
+    if (m_conditionalDownload && !errorCode && (m_responseLastModified.isValid() || !m_responseETag.isEmpty()))
+    {
+        PartialDownloadInfo validators;
+        validators.url = m_url;
+        validators.lastModified = m_responseLastModified;
+        validators.eTag = m_responseETag;
+        QSaveFile validatorsFile(validatorsFileName());
+        if (validatorsFile.open(QIODevice::WriteOnly))
+        {
+            QDataStream stream(&validatorsFile);
+            stream << validators;
+            validatorsFile.commit();
+        }
+    }
+    emit fileContentChanged();
+    if (errorCode)
+    {
+        emit error(objectName(), QString::fromStdString(errorCode.message()));
+    }
+
+    // Emit signals as appropriate
+    if (oldUpdateSize != updateSize())
+    {
+        emit updateSizeChanged();
+    }
+    emit downloadingChanged();
+}
+
+
+void DataManagement::Downloadable_SingleFile::discardPartialDownload()
+{
+    QFile::remove(partFileName());
+    QFile::remove(partInfoFileName());
 }
 
 
@@ -20,14 +20,17 @@
 
 #pragma once
 
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QFile>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QNetworkReply>
 #include <QPointer>
 #include <QQmlEngine>
 #include <QSaveFile>
 
+#include "DeltaUpdate.h"
 #include "Downloadable_Abstract.h"
 
 namespace DataManagement
@@ -125,6 +128,15 @@ public:
      */
     Q_PROPERTY(QDateTime remoteFileDate READ remoteFileDate WRITE setRemoteFileDate NOTIFY remoteFileDateChanged)
 
+    /*! \brief SHA-256 digest of the remote file
+     *
+     * If this property holds a non-empty QByteArray, downloaded data is
+     * accepted only if its SHA-256 digest matches. The digest is computed
+     * while the data arrives, so that no extra pass over the file is needed.
+     * The property is empty by default.
+     */
+    Q_PROPERTY(QByteArray remoteFileHash READ remoteFileHash WRITE setRemoteFileHash NOTIFY remoteFileHashChanged)
+
     /*! \brief Size of the remote file
      *
      * This property holds the size of the remote file.  If the size date of the
@@ -152,7 +164,7 @@ public:
      *
      * @returns Property downloading
      */
-    [[nodiscard]] auto downloading() -> bool override { return !m_networkReplyDownloadFile.isNull(); }
+    [[nodiscard]] auto downloading() -> bool override { return !m_networkReplyDownloadFile.isNull() || !m_deltaUpdate.isNull() || !m_verifier.isNull(); }
 
     /*! \brief Getter function for the property with the same name
      *
@@ -190,6 +202,12 @@ public:
      */
     [[nodiscard]] auto remoteFileDate() const -> QDateTime { return m_remoteFileDate; }
 
+    /*! \brief Getter function for the property with the same name
+     *
+     * @returns Property remoteFileHash
+     */
+    [[nodiscard]] auto remoteFileHash() const -> QByteArray { return m_remoteFileHash; }
+
     /*! \brief Getter function for the property with the same name
      *
      * @returns Property remoteFileSize
@@ -220,12 +238,33 @@ public:
      */
     void setRemoteFileDate(const QDateTime &date);
 
+    /*! \brief Setter function for the property with the same name
+     *
+     * @param hash Property remoteFileHash
+     */
+    void setRemoteFileHash(const QByteArray& hash);
+
     /*! \brief Setter function for the property with the same name
      *
      * @param size Property remoteFileSize
      */
     void setRemoteFileSize(qint64 size);
 
+    /*! \brief Use conditional requests for downloads
+     *
+     * If set to true, the validators "ETag" and "Last-Modified" of every
+     * download are kept at fileName()+".info". Later downloads send them in
+     * "If-None-Match" and "If-Modified-Since" headers. If the server answers
+     * that the remote file has not changed, no data is transferred, the local
+     * file is left untouched and the signal fileNotModified() is emitted
+     * instead of fileContentChanged(). This is meant for small files that are
+     * downloaded often, such as the list of maps. Conditional requests are off
+     * by default.
+     *
+     * @param conditional True if conditional requests shall be used
+     */
+    void setConditionalDownload(bool conditional) { m_conditionalDownload = conditional; }
+
 
 
     //
@@ -247,10 +286,18 @@ public:
      * take place.
      *
      * -# Data is retrieved from the remote server and stored in a temporary
-     *    file. The signal downloadProgress() will be emitted regularly.
+     *    file at fileName()+".part". The signal downloadProgress() will be
+     *    emitted regularly.
      *
      * -# In case of an error, the signal error() is emitted and the download
-     *    stops.
+     *    stops. The temporary file is kept.
+     *
+     * If a temporary file from an earlier, unfinished download exists, only
+     * the missing bytes are requested, using HTTP "Range" and "If-Range"
+     * headers. The validators "ETag" and "Last-Modified" of the earlier
+     * response are kept at fileName()+".part.info". If the remote file has
+     * changed, the server sends the full file and the download starts from
+     * scratch.
      *
      * -# Optionally, the download can be stopped using the method
      *    stopFileDownload().
@@ -258,6 +305,16 @@ public:
      * Once all data has been downloaded successfully to the temporary file, the
      * process continues as follows.
      *
+     * -# If the property remoteFileHash is set, the digest of the data is
+     *    compared. On mismatch, the temporary file is deleted and the signal
+     *    error() is emitted. For resumed downloads, the digest is computed in
+     *    the next step, on a worker thread.
+     *
+     * -# On a worker thread, the temporary file is checked for structural
+     *    integrity: GeoJSON files must parse, MBTILES files must pass the
+     *    SQLite "quick_check". Files that fail the check are deleted and the
+     *    signal error() is emitted. The local file is not touched.
+     *
      * -# The signal aboutToChangeLocalFile() is emitted. As the name suggests,
      *    this indicates that the local file is about to change and that it
      *    should not be used anymore.
@@ -289,13 +346,22 @@ public:
 
     /*! \brief Stops download process
      *
-     * This method stops the currenly running download process gracefully and
-     * deletes any partially downloaded data. No signal will be emitted.  If no
-     * download is in progress, nothing will happen.
+     * This method stops the currenly running download process gracefully. The
+     * partially downloaded data is kept, so that the next call to
+     * startDownload() resumes the download. Running delta updates are
+     * cancelled. No signal will be emitted.  If no download is in progress,
+     * nothing will happen.
      */
     Q_INVOKABLE void stopDownload() override;
 
-    /*! \brief Implementation of pure virtual method from Downloadable_Abstract */
+    /*! \brief Implementation of pure virtual method from Downloadable_Abstract
+     *
+     * For maps in MBTILES format whose local copy carries a "release" entry
+     * in its metadata, this method first tries a tile-level delta update, as
+     * described in the documentation of DeltaUpdate. Only the changed tiles
+     * are downloaded and written to the local file in one transaction. If the
+     * delta update fails, the whole file is downloaded with startDownload().
+     */
     Q_INVOKABLE void update() override;
 
 
@@ -323,6 +389,16 @@ signals:
      */
     void downloadProgressChanged(int percentage);
 
+    /*! \brief Remote file unchanged
+     *
+     * This signal is emitted if a conditional download finishes because the
+     * server reports that the remote file has not changed since the last
+     * download.
+     *
+     * @see setConditionalDownload()
+     */
+    void fileNotModified();
+
     /*! \brief Notifier signal for the properties remoteFileDate and remoteFileSize
      *
      * This signal is emitted once one of the property remoteFileDate changes,
@@ -332,6 +408,9 @@ signals:
      */
     void remoteFileDateChanged();
 
+    /*! \brief Notifier signal */
+    void remoteFileHashChanged();
+
 private:
     Q_DISABLE_COPY_MOVE(Downloadable_SingleFile)
 
@@ -342,22 +421,60 @@ private:
     void downloadFileErrorReceiver(QNetworkReply::NetworkError code);
 
     // Called once download of the remote file is finished, this method
-    // overwrites the local file. It deletes the QTemporaryFile _tmpFile, and
-    // deletes _networkReplyDownload by calling deleteLater. Connected to
-    // &QNetworkReply::finished of _networkReplyDownload.
+    // checks that the partial file is complete and moves it to the local file.
+    // It deletes m_partFile, and deletes m_networkReplyDownloadFile by calling
+    // deleteLater. Connected to &QNetworkReply::finished of
+    // m_networkReplyDownloadFile.
     void downloadFileFinished();
 
+    // Called once the response headers of the remote file have arrived, this
+    // method checks whether the server honours the range request. If the
+    // server sends the full file instead, the partial file is truncated; other
+    // responses leave it untouched. It then stores the validators of the remote
+    // file in the info file, so that the download can be resumed later.
+    // Connected to &QNetworkReply::metaDataChanged of
+    // m_networkReplyDownloadFile.
+    void downloadFileMetaDataReceiver();
+
     // Called during the download of the remote file, this method emits the
     // signal downloadProgress().  Connected to &QNetworkReply::downloadProgress
     // of _networkReplyDownload.
     void downloadFileProgressReceiver(qint64 bytesReceived, qint64 bytesTotal);
 
     // Called during the download of the remote file, this method reads all the
-    // data that has been downloaded so far and stores it in the QTemporaryFile
-    // _tmpFile.  Connected to &QNetworkReply::readyRead of
-    // _networkReplyDownload.
+    // data that has been downloaded so far and appends it to m_partFile.
+    // Connected to &QNetworkReply::readyRead of m_networkReplyDownloadFile.
     void downloadFilePartialDataReceiver();
 
+    // Called once the delta update has finished. On success, this method
+    // writes the changed tiles to the local file, using a QLockFile at
+    // fileName()+".lock". Otherwise, or if writing fails, the whole file is
+    // downloaded. Connected to &DeltaUpdate::finished of m_deltaUpdate.
+    void deltaUpdateFinished(bool success);
+
+    // Starts a delta update, if the local file supports it. Returns true if a
+    // delta update has been started.
+    bool startDeltaUpdate();
+
+    // Called once the structural check of the downloaded data has finished,
+    // this method moves the partial file to the local file, or deletes it if
+    // the check failed. Connected to &QFutureWatcher::finished of m_verifier.
+    void installDownloadedFile();
+
+    // Deletes partial data and the info file
+    void discardPartialDownload();
+
+    // Name of the file holding the validators of the local file, used for
+    // conditional downloads
+    [[nodiscard]] QString validatorsFileName() const { return m_fileName + QStringLiteral(".info"); }
+
+    // Name of the file holding partial data of an unfinished download
+    [[nodiscard]] QString partFileName() const { return m_fileName + QStringLiteral(".part"); }
+
+    // Name of the file holding the URL, validators and size of the remote file
+    // whose partial data is in partFileName()
+    [[nodiscard]] QString partInfoFileName() const { return m_fileName + QStringLiteral(".part.info"); }
+
     // Called once download of the remote file header data is finished, this
     // method updates the properties remoteFileDate and remoteFileSize, and
     // _networkReplyDownloadHeader by calling deleteLater. Connected to
@@ -375,9 +492,49 @@ private:
     // no download is in progress.
     QPointer<QNetworkReply> m_networkReplyDownloadHeader;
 
-    // Temporary file for storing partiall data when downloading the remote
-    // file. Set to nullptr when no download is in progress.
-    QPointer<QSaveFile> m_saveFile;
+    // Running delta update. Set to nullptr when no delta update is in
+    // progress.
+    QPointer<DataManagement::DeltaUpdate> m_deltaUpdate;
+
+    // File for storing partial data when downloading the remote file. Set to
+    // nullptr when no download is in progress. The file is kept when a
+    // download fails or is stopped, so that the download can be resumed.
+    QPointer<QFile> m_partFile;
+
+    // Number of bytes that were already present in m_partFile when the
+    // current download started
+    qint64 m_resumeOffset {0};
+
+    // Size of the remote file as announced in the response headers, or -1 if
+    // unknown
+    qint64 m_expectedSize {-1};
+
+    // Set once downloadFileMetaDataReceiver() has looked at the response
+    bool m_responseChecked {false};
+
+    // Set if the response carries file data, that is, if it is the full file
+    // or the requested range. Otherwise, the body is not written to m_partFile.
+    bool m_responseAccepted {false};
+
+    // Validators of the response to the current download. They are written to
+    // validatorsFileName() once the downloaded file is installed.
+    QDateTime m_responseLastModified;
+    QByteArray m_responseETag;
+
+    // Set by setConditionalDownload()
+    bool m_conditionalDownload {false};
+
+    // SHA-256 digest of the data received in the current download, computed
+    // while the data arrives. For resumed downloads, the data that was already
+    // present in m_partFile is not included.
+    QCryptographicHash m_partFileHash {QCryptographicHash::Sha256};
+
+    // Structural check of the downloaded data, running on a worker thread. Set
+    // to nullptr when no check is running.
+    QPointer<QFutureWatcher<QString>> m_verifier;
+
+    // SHA-256 digest of the remote file, or empty if unknown
+    QByteArray m_remoteFileHash;
 
     // URL of the remote file, as set in the constructor
     QUrl m_url;
@@ -19,114 +19,180 @@
  ***************************************************************************/
 
 #include <QFile>
-#include <QTextStream>
 
 #include "fileFormats/CSV.h"
 
 #include "fileFormats/DataFileAbstract.h"
 
-//
-// Private helper functions
-//
 
-QStringList FileFormats::CSV::parseCSV(const QString& string)
-{
-    // Thanks to https://stackoverflow.com/questions/27318631/parsing-through-a-csv-file-in-qt
+namespace {
 
-    enum State : quint8
-    {
-        Normal,
-        Quote
-    } state = Normal;
-    QStringList fields;
-    fields.reserve(10);
-    QString value;
-
-    for (int i = 0; i < string.size(); i++)
+// Appends a field to fields. The field is given as raw bytes between commas.
+// If it contains escaped double-quotes, the unescaped field is stored in
+// storage, and fields refers to that copy.
+void appendField(QByteArrayView raw, bool hasEscapedQuotes, QList<QByteArrayView>& fields, QList<QByteArray>& storage)
+{
+    QByteArrayView field = raw;
+    if (hasEscapedQuotes)
     {
-        const QChar current = string.at(i);
-
-        // Normal state
-        if (state == Normal)
+        QByteArray unescaped;
+        unescaped.reserve(raw.size());
+        bool inQuote = false;
+        for (qsizetype i = 0; i < raw.size(); i++)
         {
-            // Comma
-            if (current == ',')
+            const char current = raw.at(i);
+            if (inQuote && (current == '"'))
             {
-                // Save field
-                fields.append(value.trimmed());
-                value.clear();
+                // A double double-quote?
+                if ((i + 1 < raw.size()) && (raw.at(i + 1) == '"'))
+                {
+                    i++;
+                }
+                else
+                {
+                    inQuote = false;
+                }
             }
-
-            // Double-quote
             else if (current == '"')
             {
-                state = Quote;
-                value += current;
+                inQuote = true;
             }
+            unescaped += current;
+        }
+        storage.append(unescaped);
+        field = storage.constLast();
+    }
 
-            // Other character
-            else
-            {
-                value += current;
-            }
+    // Quotes are left in until here; so when fields are trimmed, only
+    // whitespace outside of quotes is removed.  The outermost quotes are
+    // removed here.
+    field = field.trimmed();
+    if (field.startsWith('"'))
+    {
+        field = field.sliced(1);
+        if (field.endsWith('"'))
+        {
+            field.chop(1);
         }
+    }
+    fields.append(field);
+}
 
-        // In-quote state
-        else if (state == Quote)
+// Splits one line into fields
+void splitLine(QByteArrayView line, QList<QByteArrayView>& fields, QList<QByteArray>& storage)
+{
+    fields.clear();
+    storage.clear();
+
+    qsizetype fieldStart = 0;
+    bool inQuote = false;
+    bool hasEscapedQuotes = false;
+    for (qsizetype i = 0; i < line.size(); i++)
+    {
+        const char current = line.at(i);
+        if (inQuote)
         {
-            // Another double-quote
             if (current == '"')
             {
-                if (i < string.size())
+                if ((i + 1 < line.size()) && (line.at(i + 1) == '"'))
                 {
-                    // A double double-quote?
-                    if (i + 1 < string.size() && string.at(i + 1) == '"')
-                    {
-                        value += '"';
-
-                        // Skip a second quote character in a row
-                        i++;
-                    }
-                    else
-                    {
-                        state = Normal;
-                        value += '"';
-                    }
+                    hasEscapedQuotes = true;
+                    i++;
+                }
+                else
+                {
+                    inQuote = false;
                 }
             }
-
-            // Other character
-            else
-            {
-                value += current;
-            }
         }
+        else if (current == ',')
+        {
+            appendField(line.sliced(fieldStart, i - fieldStart), hasEscapedQuotes, fields, storage);
+            fieldStart = i + 1;
+            hasEscapedQuotes = false;
+        }
+        else if (current == '"')
+        {
+            inQuote = true;
+        }
+    }
+
+    // The last field is only added if it is not empty
+    if (fieldStart < line.size())
+    {
+        appendField(line.sliced(fieldStart), hasEscapedQuotes, fields, storage);
     }
+}
+
+} // namespace
+
+
+//
+// Private helper functions
+//
 
-    if (!value.isEmpty())
+void FileFormats::CSV::parseCSV(QByteArrayView data, const LineHandler& lineHandler)
+{
+    // Skip UTF-8 byte order mark
+    if (data.startsWith("\xEF\xBB\xBF"))
     {
-        fields.append(value.trimmed());
+        data = data.sliced(3);
     }
 
-    // Quotes are left in until here; so when fields are trimmed, only whitespace outside of
-    // quotes is removed.  The outermost quotes are removed here.
-    for (auto &field : fields)
+    QList<QByteArrayView> fields;
+    fields.reserve(16);
+    QList<QByteArray> storage;
+
+    qsizetype lineNumber = 0;
+    qsizetype lineStart = 0;
+    bool isHeader = true;
+    while (lineStart < data.size())
     {
-        if (field.length() >= 1 && field.at(0) == '"')
+        auto lineEnd = data.indexOf('\n', lineStart);
+        if (lineEnd < 0)
         {
-            field = field.mid(1);
-            if (field.length() >= 1 && field.right(1) == '"')
-            {
-                field = field.left(field.length() - 1);
-            }
+            lineEnd = data.size();
+        }
+        auto line = data.sliced(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        if (line.endsWith('\r'))
+        {
+            line.chop(1);
+        }
+
+        // Ignore the header line
+        if (isHeader)
+        {
+            isHeader = false;
+            continue;
         }
-    }
 
-    return fields;
+        lineNumber++;
+        splitLine(line, fields, storage);
+        if (!lineHandler(lineNumber, fields))
+        {
+            return;
+        }
+    }
 }
 
 
 FileFormats::CSV::CSV(const QString& fileName)
+    : CSV(fileName, [this](qsizetype /*lineNumber*/, const QList<QByteArrayView>& fields) {
+        QStringList line;
+        line.reserve(fields.size());
+        for (const auto& field : fields)
+        {
+            line << QString::fromUtf8(field);
+        }
+        m_lines << line;
+        return true;
+    })
+{
+}
+
+
+FileFormats::CSV::CSV(const QString& fileName, const LineHandler& lineHandler)
 {
     auto file = FileFormats::DataFileAbstract::openFileURL(fileName);
     auto success = file->open(QIODevice::ReadOnly);
@@ -136,11 +202,15 @@ FileFormats::CSV::CSV(const QString& fileName)
         return;
     }
 
-    QTextStream stream(file.data());
-    QString line;
-    stream.readLineInto(&line);
-    while (stream.readLineInto(&line))
+    // Memory-map the file if possible, read it otherwise
+    auto size = file->size();
+    auto* data = (size > 0) ? file->map(0, size) : nullptr;
+    if (data != nullptr)
     {
-        m_lines << parseCSV(line);
+        parseCSV(QByteArrayView(reinterpret_cast<const char*>(data), size), lineHandler);
+        file->unmap(data);
+        return;
     }
+    auto content = file->readAll();
+    parseCSV(content, lineHandler);
 }
@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include <QByteArrayView>
+#include <functional>
+
 #include "DataFileAbstract.h"
 
 using namespace Qt::Literals::StringLiterals;
@@ -30,7 +33,11 @@ namespace FileFormats
 
     /*! \brief CSV file support class
      *
-     *  The methods of this class read CSV files.
+     *  The methods of this class read CSV files. The first line of the file is
+     *  considered a header and ignored. Lines are split at line breaks, and
+     *  then into fields at commas that are not enclosed in double quotes.
+     *  Whitespace outside of quotes is removed, as are the outermost quotes of
+     *  a field. Double double-quotes inside quotes stand for one double-quote.
      */
 
     class CSV : public DataFileAbstract
@@ -45,6 +52,28 @@ namespace FileFormats
          */
         CSV(const QString& fileName);
 
+        /*! \brief Function that handles one line of a CSV file
+         *
+         *  The first argument is the line number, starting with 1 for the first
+         *  line after the header. The second argument contains the fields of
+         *  the line, as UTF-8 encoded views. The views are only valid during
+         *  the call. The function returns false to stop reading.
+         */
+        using LineHandler = std::function<bool(qsizetype, const QList<QByteArrayView>&)>;
+
+        /*! \brief Constructor
+         *
+         *  This method reads a CSV file line by line, without storing the
+         *  lines. The file is memory-mapped where possible, and fields are
+         *  handed to lineHandler as views into the file, so that large files
+         *  can be read quickly. The lines are not stored by this constructor.
+         *
+         *  @param fileName Name of a CSV file
+         *
+         *  @param lineHandler Function that is called for every line
+         */
+        CSV(const QString& fileName, const LineHandler& lineHandler);
+
 
 
         //
@@ -70,7 +99,7 @@ namespace FileFormats
 
     private:
         // Private helper functions
-        static QStringList parseCSV(const QString& string);
+        static void parseCSV(QByteArrayView data, const LineHandler& lineHandler);
 
         QVector<QStringList> m_lines;
     };
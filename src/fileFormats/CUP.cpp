@@ -31,16 +31,13 @@ using namespace Qt::Literals::StringLiterals;
 // Private helper functions
 //
 
-GeoMaps::Waypoint FileFormats::CUP::readWaypoint(const QStringList& fields)
+GeoMaps::Waypoint FileFormats::CUP::readWaypoint(const QList<QByteArrayView>& fields)
 {
     if (fields.size() < 6)
     {
         return {};
     }
 
-    // Get Name
-    const auto &name = fields[0];
-
     // Get Latitude
     double lat = NAN;
     {
@@ -54,12 +51,12 @@ GeoMaps::Waypoint FileFormats::CUP::readWaypoint(const QStringList& fields)
             return {};
         }
         bool ok = false;
-        lat = latString.left(2).toDouble(&ok);
+        lat = latString.first(2).toDouble(&ok);
         if (!ok)
         {
             return {};
         }
-        lat = lat + latString.mid(2, 6).toDouble(&ok) / 60.0;
+        lat = lat + latString.sliced(2, 6).toDouble(&ok) / 60.0;
         if (!ok)
         {
             return {};
@@ -83,12 +80,12 @@ GeoMaps::Waypoint FileFormats::CUP::readWaypoint(const QStringList& fields)
             return {};
         }
         bool ok = false;
-        lon = longString.left(3).toDouble(&ok);
+        lon = longString.first(3).toDouble(&ok);
         if (!ok)
         {
             return {};
         }
-        lon = lon + longString.mid(3, 6).toDouble(&ok) / 60.0;
+        lon = lon + longString.sliced(3, 6).toDouble(&ok) / 60.0;
         if (!ok)
         {
             return {};
@@ -101,15 +98,15 @@ GeoMaps::Waypoint FileFormats::CUP::readWaypoint(const QStringList& fields)
 
     double ele = NAN;
     {
-        const auto &eleString = fields[5];
+        auto eleString = fields[5];
         bool ok = false;
-        if (eleString.endsWith(u"m"))
+        if (eleString.endsWith("m"))
         {
             ele = eleString.chopped(1).toDouble(&ok);
         }
-        if (eleString.endsWith(u"ft"))
+        if (eleString.endsWith("ft"))
         {
-            ele = eleString.chopped(1).toDouble(&ok) * 0.3048;
+            ele = eleString.chopped(2).toDouble(&ok) * 0.3048;
         }
         if (!ok)
         {
@@ -121,23 +118,23 @@ GeoMaps::Waypoint FileFormats::CUP::readWaypoint(const QStringList& fields)
     QStringList notes;
     if ((fields.size() >= 8) && (!fields[7].isEmpty()))
     {
-        notes += QObject::tr("Direction: %1°", "GeoMaps::CUP").arg(fields[7]);
+        notes += QObject::tr("Direction: %1°", "GeoMaps::CUP").arg(QString::fromUtf8(fields[7]));
     }
     if ((fields.size() >= 9) && (!fields[8].isEmpty()))
     {
-        notes += QObject::tr("Length: %1", "GeoMaps::CUP").arg(fields[8]);
+        notes += QObject::tr("Length: %1", "GeoMaps::CUP").arg(QString::fromUtf8(fields[8]));
     }
     if ((fields.size() >= 11) && (!fields[10].isEmpty()))
     {
-        notes += fields[10];
+        notes += QString::fromUtf8(fields[10]);
     }
     if ((fields.size() >= 12) && (!fields[11].isEmpty()))
     {
-        notes += fields[11];
+        notes += QString::fromUtf8(fields[11]);
     }
 
     GeoMaps::Waypoint result(QGeoCoordinate(lat, lon, ele));
-    result.setName(name);
+    result.setName(QString::fromUtf8(fields[0]));
     if (!notes.isEmpty())
     {
         result.setNotes(notes.join(u" • "_s));
@@ -148,28 +145,31 @@ GeoMaps::Waypoint FileFormats::CUP::readWaypoint(const QStringList& fields)
 
 FileFormats::CUP::CUP(const QString& fileName)
 {
-    CSV const csv(fileName);
+    // Waypoints are built directly from the fields of the CSV file, without
+    // storing the lines
+    QString errorString;
+    CSV const csv(fileName, [&](qsizetype lineNumber, const QList<QByteArrayView>& fields) {
+        if (fields.contains(QByteArrayView("-----Related Tasks-----")))
+        {
+            return false;
+        }
+        auto waypoint = readWaypoint(fields);
+        if (!waypoint.isValid())
+        {
+            errorString = QObject::tr("Error reading line %1 in the CUP file %2.", "FileFormats::CUP").arg(lineNumber).arg(fileName);
+            return false;
+        }
+        m_waypoints << waypoint;
+        return true;
+    });
 
     if (!csv.isValid())
     {
         setError(csv.error());
         return;
     }
-
-    int lineNumber = 0;
-    foreach (auto& line, csv.lines())
+    if (!errorString.isEmpty())
     {
-        lineNumber++;
-        if (line.contains(u"-----Related Tasks-----"))
-        {
-            break;
-        }
-        auto waypoint = readWaypoint(line);
-        if (!waypoint.isValid())
-        {
-            setError(QObject::tr("Error reading line %1 in the CUP file %2.", "FileFormats::CUP").arg(lineNumber).arg(fileName));
-            return;
-        }
-        m_waypoints << waypoint;
+        setError(errorString);
     }
 }
@@ -71,8 +71,7 @@ namespace FileFormats
 
     private:
         // Private helper functions
-        static QStringList parseCSV(const QString& string);
-        static GeoMaps::Waypoint readWaypoint(const QStringList& fields);
+        static GeoMaps::Waypoint readWaypoint(const QList<QByteArrayView>& fields);
 
 
         QVector<GeoMaps::Waypoint> m_waypoints;
@@ -18,10 +18,19 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
 #include <QRandomGenerator>
+#include <QSaveFile>
 #include <QSqlDatabase>
 #include <QSqlQuery>
+#include <QStandardPaths>
 #include <QVariant>
+#include <optional>
 
 #include "fileFormats/DataFileAbstract.h"
 #include "fileFormats/MBTILES.h"
@@ -29,6 +38,102 @@
 using namespace Qt::Literals::StringLiterals;
 
 
+namespace {
+
+// Metadata of an MBTILES file, together with size and modification time of the
+// file when the metadata was read
+struct MetaDataCacheEntry
+{
+    qint64 size {-1};
+    QDateTime lastModified;
+    QMap<QString, QString> metaData;
+};
+
+QDataStream& operator<<(QDataStream& stream, const MetaDataCacheEntry& entry)
+{
+    return stream << entry.size << entry.lastModified << entry.metaData;
+}
+
+QDataStream& operator>>(QDataStream& stream, MetaDataCacheEntry& entry)
+{
+    return stream >> entry.size >> entry.lastModified >> entry.metaData;
+}
+
+// Cache of metadata, by file name. The cache is shared by all instances of
+// MBTILES, which might live in different threads, and is kept between runs of
+// the app. It is read when first used.
+QMutex metaDataCacheMutex;
+QHash<QString, MetaDataCacheEntry> metaDataCache;
+bool metaDataCacheLoaded {false};
+
+QString metaDataCacheFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + u"/mbtilesMetaData.dat"_s;
+}
+
+// Reads the cache from disk, if that has not been done yet. Entries for files
+// that no longer exist are dropped. Must be called with metaDataCacheMutex
+// locked.
+void loadMetaDataCache()
+{
+    if (metaDataCacheLoaded)
+    {
+        return;
+    }
+    metaDataCacheLoaded = true;
+
+    QFile file(metaDataCacheFileName());
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return;
+    }
+    QDataStream stream(&file);
+    QHash<QString, MetaDataCacheEntry> cache;
+    stream >> cache;
+    if (stream.status() != QDataStream::Ok)
+    {
+        return;
+    }
+    cache.removeIf([](decltype(cache)::iterator entry) { return !QFile::exists(entry.key()); });
+    metaDataCache = cache;
+}
+
+// Returns the cached metadata of a file, or std::nullopt if the file is not in
+// the cache or has changed since the metadata was read
+std::optional<QMap<QString, QString>> cachedMetaData(const QString& fileName)
+{
+    QFileInfo const info(fileName);
+    QMutexLocker const locker(&metaDataCacheMutex);
+    loadMetaDataCache();
+    auto entry = metaDataCache.constFind(fileName);
+    if ((entry == metaDataCache.constEnd()) || (entry->size != info.size()) || (entry->lastModified != info.lastModified()))
+    {
+        return {};
+    }
+    return entry->metaData;
+}
+
+// Adds the metadata of a file to the cache and writes the cache to disk
+void cacheMetaData(const QString& fileName, const QMap<QString, QString>& metaData)
+{
+    QFileInfo const info(fileName);
+    QMutexLocker const locker(&metaDataCacheMutex);
+    loadMetaDataCache();
+    metaDataCache.insert(fileName, {info.size(), info.lastModified(), metaData});
+
+    QDir().mkpath(QFileInfo(metaDataCacheFileName()).absolutePath());
+    QSaveFile file(metaDataCacheFileName());
+    if (file.open(QIODevice::WriteOnly))
+    {
+        QDataStream stream(&file);
+        stream << metaDataCache;
+        file.commit();
+    }
+}
+
+} // namespace
+
+
 FileFormats::MBTILES::MBTILES()
 {
     m_file = QSharedPointer<QFile>(new QFile());
@@ -50,6 +155,14 @@ FileFormats::MBTILES::MBTILES(const QString& fileName)
         return;
     }
 
+    // Metadata of files that have been opened before is taken from the cache
+    auto cached = cachedMetaData(m_file->fileName());
+    if (cached.has_value())
+    {
+        m_metadata = cached.value();
+        return;
+    }
+
     QSqlQuery query(m_dataBase);
     if (!query.exec(QStringLiteral("select name, value from metadata;")))
     {
@@ -64,16 +177,14 @@ FileFormats::MBTILES::MBTILES(const QString& fileName)
     }
 
     // If the metadata does not contain a minzoom entry, then generate one by looking at the
-    // lowest zoom_level that exists in the "tiles" table.
+    // lowest zoom_level that exists in the "tiles" table. The query is phrased
+    // so that SQLite reads a single entry of the tile index, also if "tiles"
+    // is a view into deduplicated tables.
     if (!m_metadata.contains(u"minzoom"_s))
     {
-        if (query.exec(QStringLiteral("select min(zoom_level) from tiles;")))
+        if (query.exec(QStringLiteral("select zoom_level from tiles order by zoom_level asc limit 1;")) && query.first())
         {
-            while(query.next())
-            {
-                QString const minzoom = query.value(0).toString();
-                m_metadata.insert(u"minzoom"_s, minzoom);
-            }
+            m_metadata.insert(u"minzoom"_s, query.value(0).toString());
         }
     }
 
@@ -81,15 +192,13 @@ FileFormats::MBTILES::MBTILES(const QString& fileName)
     // highest zoom_level that exists in the "tiles" table.
     if (!m_metadata.contains(u"maxzoom"_s))
     {
-        if (query.exec(QStringLiteral("select max(zoom_level) from tiles;")))
+        if (query.exec(QStringLiteral("select zoom_level from tiles order by zoom_level desc limit 1;")) && query.first())
         {
-            while(query.next())
-            {
-                QString const maxzoom = query.value(0).toString();
-                m_metadata.insert(u"maxzoom"_s, maxzoom);
-            }
+            m_metadata.insert(u"maxzoom"_s, query.value(0).toString());
         }
     }
+
+    cacheMetaData(m_file->fileName(), m_metadata);
 }
 
 FileFormats::MBTILES::~MBTILES()
@@ -99,6 +208,11 @@ FileFormats::MBTILES::~MBTILES()
 }
 
 auto FileFormats::MBTILES::attribution() -> QString
+{
+    return m_metadata.value(u"attribution"_s);
+}
+
+auto FileFormats::MBTILES::coverage(int maxZoom) -> QBitArray
 {
     auto m_dataBase = QSqlDatabase::database(m_databaseConnectionName);
     if (!m_dataBase.open())
@@ -106,38 +220,46 @@ auto FileFormats::MBTILES::attribution() -> QString
         return {};
     }
     QSqlQuery query(m_dataBase);
-    if (query.exec(QStringLiteral("select name, value from metadata where name='attribution';")))
+    query.setForwardOnly(true);
+    query.prepare(u"select zoom_level, tile_column, tile_row from tiles where zoom_level<=?;"_s);
+    query.addBindValue(maxZoom);
+    if (!query.exec())
     {
-        if (query.first())
+        return {};
+    }
+
+    QBitArray result(coverageIndex(maxZoom+1, 0, 0));
+    bool empty = true;
+    while(query.next())
+    {
+        auto zoom = query.value(0).toInt();
+        auto x = query.value(1).toInt();
+        auto yflipped = query.value(2).toInt();
+        auto maxTile = (1<<zoom)-1;
+        if ((zoom < 0) || (x < 0) || (x > maxTile) || (yflipped < 0) || (yflipped > maxTile))
         {
-            return query.value(1).toString();
+            continue;
         }
+        result.setBit(coverageIndex(zoom, x, maxTile-yflipped));
+        empty = false;
     }
-    return {};
+    if (empty)
+    {
+        return {};
+    }
+    return result;
 }
 
 auto FileFormats::MBTILES::format() -> FileFormats::MBTILES::Format
 {
-    auto m_dataBase = QSqlDatabase::database(m_databaseConnectionName);
-    if (!m_dataBase.open())
+    auto format = m_metadata.value(u"format"_s);
+    if (format == u"pbf"_s)
     {
-        return {};
+        return Vector;
     }
-    QSqlQuery query(m_dataBase);
-    if (query.exec(QStringLiteral("select name, value from metadata where name='format';")))
+    if ((format == u"jpg"_s) || (format == u"png"_s) || (format == u"webp"_s))
     {
-        if (query.first())
-        {
-            auto format = query.value(1).toString();
-            if (format == u"pbf"_s)
-            {
-                return Vector;
-            }
-            if ((format == u"jpg"_s) || (format == u"png"_s) || (format == u"webp"_s))
-            {
-                return Raster;
-            }
-        }
+        return Raster;
     }
     return Unknown;
 }
@@ -186,3 +308,86 @@ auto FileFormats::MBTILES::tile(int zoom, int x, int y) -> QByteArray
 
     return {};
 }
+
+
+auto FileFormats::MBTILES::writeTiles(const QList<TileData>& tiles, const QMap<QString, QString>& metaData) -> QString
+{
+    auto m_dataBase = QSqlDatabase::database(m_databaseConnectionName);
+    if (!m_dataBase.open())
+    {
+        return QObject::tr("Unable to open database connection to MBTILES file.", "FileFormats::MBTILES");
+    }
+
+    // Deduplicated MBTILES files implement "tiles" as a view into other
+    // tables. Those cannot be written to.
+    QSqlQuery query(m_dataBase);
+    if (!query.exec(u"select type from sqlite_master where name='tiles';"_s) || !query.first() || (query.value(0).toString() != u"table"_s))
+    {
+        return QObject::tr("MBTILES file cannot be modified.", "FileFormats::MBTILES");
+    }
+
+    if (!m_dataBase.transaction())
+    {
+        return QObject::tr("Unable to write to MBTILES file.", "FileFormats::MBTILES");
+    }
+
+    QSqlQuery deleteQuery(m_dataBase);
+    QSqlQuery insertQuery(m_dataBase);
+    if (!deleteQuery.prepare(u"delete from tiles where zoom_level=? and tile_column=? and tile_row=?;"_s)
+        || !insertQuery.prepare(u"insert into tiles (zoom_level, tile_column, tile_row, tile_data) values (?, ?, ?, ?);"_s))
+    {
+        m_dataBase.rollback();
+        return QObject::tr("Unable to write to MBTILES file.", "FileFormats::MBTILES");
+    }
+
+    // Tiles are deleted before they are inserted, because the MBTILES
+    // specification does not require a unique index on the tiles table
+    for(const auto& tile : tiles)
+    {
+        // MBTILES counts rows from the bottom, following the TMS scheme
+        auto yflipped = (1<<tile.zoom)-1-tile.y;
+        deleteQuery.addBindValue(tile.zoom);
+        deleteQuery.addBindValue(tile.x);
+        deleteQuery.addBindValue(yflipped);
+        auto success = deleteQuery.exec();
+        if (success && !tile.data.isEmpty())
+        {
+            insertQuery.addBindValue(tile.zoom);
+            insertQuery.addBindValue(tile.x);
+            insertQuery.addBindValue(yflipped);
+            insertQuery.addBindValue(tile.data);
+            success = insertQuery.exec();
+        }
+        if (!success)
+        {
+            m_dataBase.rollback();
+            return QObject::tr("Unable to write tile to MBTILES file.", "FileFormats::MBTILES");
+        }
+    }
+
+    QSqlQuery metaDataQuery(m_dataBase);
+    QSqlQuery metaDataDeleteQuery(m_dataBase);
+    metaDataDeleteQuery.prepare(u"delete from metadata where name=?;"_s);
+    metaDataQuery.prepare(u"insert into metadata (name, value) values (?, ?);"_s);
+    for(auto it = metaData.cbegin(); it != metaData.cend(); ++it)
+    {
+        metaDataDeleteQuery.addBindValue(it.key());
+        metaDataQuery.addBindValue(it.key());
+        metaDataQuery.addBindValue(it.value());
+        if (!metaDataDeleteQuery.exec() || !metaDataQuery.exec())
+        {
+            m_dataBase.rollback();
+            return QObject::tr("Unable to write metadata to MBTILES file.", "FileFormats::MBTILES");
+        }
+    }
+
+    if (!m_dataBase.commit())
+    {
+        m_dataBase.rollback();
+        return QObject::tr("Unable to write to MBTILES file.", "FileFormats::MBTILES");
+    }
+
+    m_metadata.insert(metaData);
+    cacheMetaData(m_file->fileName(), m_metadata);
+    return {};
+}
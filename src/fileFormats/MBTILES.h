@@ -20,7 +20,9 @@
 
 #pragma once
 
+#include <QBitArray>
 #include <QFile>
+#include <QList>
 #include <QMap>
 #include <QObject>
 #include <QSharedPointer>
@@ -55,6 +57,22 @@ namespace FileFormats
       Raster,
     };
 
+    /*! \brief Tile data, as used by writeTiles() */
+    struct TileData
+    {
+      /*! \brief Zoom level of the tile */
+      int zoom {0};
+
+      /*! \brief x-Coordinate of the tile */
+      int x {0};
+
+      /*! \brief y-Coordinate of the tile, counted from the top as in tile URLs */
+      int y {0};
+
+      /*! \brief Tile data. If empty, the tile will be removed. */
+      QByteArray data;
+    };
+
     /*! \brief Standard constructor
      *
      * Constructs an invalid object. The method tile() will return
@@ -67,6 +85,11 @@ namespace FileFormats
      * Constructs an object from an MBTILES file. The file is supposed to exist
      * and remain intact throughout the existence of this class instance.
      *
+     * The metadata is read when the object is constructed. It is cached, by
+     * file name, size and modification time, in a file in
+     * QStandardPaths::CacheLocation, so that files which have been opened before
+     * are opened without database queries.
+     *
      * @param fileName Name of the MBTILES file
      */
     MBTILES(const QString& fileName);
@@ -81,6 +104,40 @@ namespace FileFormats
      */
     [[nodiscard]] QString attribution();
 
+    /*! \brief Tiles present at low zoom levels
+     *
+     *  This method reads the coordinates of all tiles at zoom levels up to
+     *  maxZoom. Since only the index of the tiles table is used, this is fast
+     *  even for large files.
+     *
+     *  @param maxZoom Highest zoom level that is considered
+     *
+     *  @returns A bit array with one bit for every tile at zoom levels 0 to
+     *  maxZoom, set if the tile exists in the file. The bit of a tile is found
+     *  with coverageIndex(). The bit array is empty on error, or if the file
+     *  contains no tiles up to maxZoom.
+     */
+    [[nodiscard]] QBitArray coverage(int maxZoom);
+
+    /*! \brief Position of a tile in the bit array returned by coverage()
+     *
+     *  Tiles are numbered zoom level by zoom level, and within each level row
+     *  by row, with rows counted from the top as in tile URLs.
+     *
+     *  @param zoom Zoom level of the tile
+     *
+     *  @param x x-Coordinate of the tile
+     *
+     *  @param y y-Coordinate of the tile
+     *
+     *  @returns Index of the tile's bit
+     */
+    [[nodiscard]] static qsizetype coverageIndex(int zoom, int x, int y)
+    {
+      // Number of tiles at zoom levels below zoom is (4^zoom-1)/3
+      return (((qsizetype(1) << (2*zoom)) - 1)/3) + (qsizetype(y) << zoom) + x;
+    }
+
     /*! \brief Determine type of data contained in an MBTILES file
      *
      *  @returns Type of data, or Unknown on error.
@@ -107,6 +164,25 @@ namespace FileFormats
      */
     [[nodiscard]] QByteArray tile(int zoom, int x, int y);
 
+    /*! \brief Modify tiles and metadata of an MBTILES file
+     *
+     *  This method writes tiles and metadata entries to the MBTILES file, in a
+     *  single transaction. Either all changes are applied, or none. Files where
+     *  "tiles" is a view into deduplicated tables cannot be modified this
+     *  way.
+     *
+     *  Users of the file must be told to stop using the file before this
+     *  method is called.
+     *
+     *  @param tiles Tiles that are added, replaced or removed
+     *
+     *  @param metaData Metadata entries that are added or replaced
+     *
+     *  @returns An empty string on success, or a human-readable, translated
+     *  error message otherwise.
+     */
+    [[nodiscard]] QString writeTiles(const QList<TileData>& tiles, const QMap<QString, QString>& metaData);
+
     /*! \brief Retrieve metadata of the MBTILES file
      *
      *  MBTILES files contain metadata, in the form of a list of key/value
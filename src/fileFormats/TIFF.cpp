@@ -19,6 +19,9 @@
  ***************************************************************************/
 
 #include <QFile>
+#include <QtEndian>
+#include <bit>
+#include <limits>
 
 #include "TIFF.h"
 #include "fileFormats/DataFileAbstract.h"
@@ -48,26 +51,194 @@ enum DataType : quint8 {
 
 namespace {
 
-// Checks the status of dataStream. If status is OK, this method does nothing.
-// Otherwiese, it throws a QString with a human-readable, translated error
-// message.
-void checkForError(QDataStream &dataStream)
+// Number of bytes read from the device in one go. For typical files, the
+// header, the IFD and all values that do not fit into the IFD entries are
+// found in the first chunk.
+constexpr qint64 chunkSize = 64*1024;
+
+// If the values of all fields lie within a range of this size, the range is
+// read in one go. Otherwise, the values are read one field at a time.
+constexpr quint64 maxSpan = 1024*1024;
+
+// Upper limit for the size of the value data of a single field. Anything
+// larger is considered corrupt.
+constexpr quint64 maxFieldSize = 64*1024*1024;
+
+// Entry of an image file directory
+struct IFDEntry
+{
+    quint16 tag {0};
+    quint16 type {DT_Undefined};
+    quint64 count {0};
+    quint64 dataOffset {0}; // Position of the value data in the file
+    quint64 dataSize {0};   // Size of the value data in bytes
+};
+
+// Size of a single value of the given type, or zero for unknown types
+quint64 typeSize(quint16 type)
+{
+    switch(type)
+    {
+    case DT_Byte:
+    case DT_SByte:
+    case DT_Ascii:
+    case DT_Undefined:
+        return 1;
+
+    case DT_Short:
+    case DT_SShort:
+        return 2;
+
+    case DT_Long:
+    case DT_SLong:
+    case DT_Ifd:
+    case DT_Float:
+        return 4;
+
+    case DT_Rational:
+    case DT_SRational:
+    case DT_Long8:
+    case DT_SLong8:
+    case DT_Ifd8:
+    case DT_Double:
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+// Checks if decode() reads values of the given type. The value data of other
+// types is never read.
+bool isDecoded(quint16 type)
+{
+    switch(type)
+    {
+    case DT_Ascii:
+    case DT_Byte:
+    case DT_Short:
+    case DT_Long:
+    case DT_Long8:
+    case DT_Double:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Window of the device content, with byte order handling. All getters take
+// absolute file positions, which must lie within the range passed to the
+// last call of require().
+class Reader
+{
+public:
+    explicit Reader(QIODevice& device) : m_device(device) {}
+
+    // Makes sure that the bytes [offset, offset+size) are in memory, reading at
+    // least chunkSize bytes from the device if they are not. On failure, throws
+    // a QString with a human-readable, translated error message.
+    void require(quint64 offset, quint64 size)
+    {
+        if ((size > maxFieldSize) || (offset > std::numeric_limits<quint64>::max()-size))
+        {
+            throw QObject::tr("Found corrupt data while reading the data stream.", "FileFormats::TIFF");
+        }
+        if ((offset >= m_offset) && (offset+size <= m_offset+m_data.size()))
+        {
+            return;
+        }
+        if (!m_device.seek(static_cast<qint64>(offset)))
+        {
+            throw QObject::tr("Read past end of data stream.", "FileFormats::TIFF");
+        }
+        m_data = m_device.read(qMax(static_cast<qint64>(size), chunkSize));
+        m_offset = offset;
+        if (static_cast<quint64>(m_data.size()) < size)
+        {
+            throw QObject::tr("Read past end of data stream.", "FileFormats::TIFF");
+        }
+    }
+
+    void setLittleEndian(bool littleEndian) { m_littleEndian = littleEndian; }
+
+    [[nodiscard]] QByteArrayView bytes(quint64 offset, quint64 size) const
+    {
+        return QByteArrayView(m_data).sliced(static_cast<qsizetype>(offset-m_offset), static_cast<qsizetype>(size));
+    }
+
+    [[nodiscard]] quint8 u8(quint64 offset) const { return static_cast<quint8>(m_data.at(static_cast<qsizetype>(offset-m_offset))); }
+    [[nodiscard]] quint16 u16(quint64 offset) const { return value<quint16>(offset); }
+    [[nodiscard]] quint32 u32(quint64 offset) const { return value<quint32>(offset); }
+    [[nodiscard]] quint64 u64(quint64 offset) const { return value<quint64>(offset); }
+    [[nodiscard]] double f64(quint64 offset) const { return std::bit_cast<double>(value<quint64>(offset)); }
+
+private:
+    template<typename T>
+    [[nodiscard]] T value(quint64 offset) const
+    {
+        const auto* src = m_data.constData() + (offset-m_offset);
+        return m_littleEndian ? qFromLittleEndian<T>(src) : qFromBigEndian<T>(src);
+    }
+
+    QIODevice& m_device;
+    QByteArray m_data;
+    quint64 m_offset {0};
+    bool m_littleEndian {true};
+};
+
+// Decodes the value data of an entry. The data must be in memory. Values of
+// types other than ASCII, BYTE, SHORT, LONG, LONG8 and DOUBLE are ignored.
+QVariantList decode(const Reader& reader, const IFDEntry& entry)
 {
-    switch(dataStream.status())
+    QVariantList values;
+    switch (entry.type)
     {
-    case QDataStream::ReadCorruptData:
-        throw QObject::tr("Found corrupt data while reading the data stream.", "FileFormats::TIFF");
-    case QDataStream::ReadPastEnd:
-        throw QObject::tr("Read past end of data stream.", "FileFormats::TIFF");
- #if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
-    case QDataStream::SizeLimitExceeded:
-        throw QObject::tr("Data is larger than supported by the current platform.", "FileFormats::TIFF");
-#endif
-    case QDataStream::WriteFailed:
-        throw QObject::tr("Error writing to data stream.", "FileFormats::TIFF");
-    case QDataStream::Ok:
+    case DT_Ascii:
+        foreach(auto subStrings, reader.bytes(entry.dataOffset, entry.dataSize).toByteArray().split(0))
+        {
+            values.append(QString::fromLatin1(subStrings));
+        }
+        break;
+    case DT_Byte:
+        values.reserve(static_cast<qsizetype>(entry.count));
+        for (quint64 i = 0; i < entry.count; ++i)
+        {
+            values.append(reader.u8(entry.dataOffset+i));
+        }
+        break;
+    case DT_Short:
+        values.reserve(static_cast<qsizetype>(entry.count));
+        for (quint64 i = 0; i < entry.count; ++i)
+        {
+            values.append(reader.u16(entry.dataOffset+2*i));
+        }
+        break;
+    case DT_Long:
+        values.reserve(static_cast<qsizetype>(entry.count));
+        for (quint64 i = 0; i < entry.count; ++i)
+        {
+            values.append(reader.u32(entry.dataOffset+4*i));
+        }
+        break;
+    case DT_Long8:
+        values.reserve(static_cast<qsizetype>(entry.count));
+        for (quint64 i = 0; i < entry.count; ++i)
+        {
+            values.append(reader.u64(entry.dataOffset+8*i));
+        }
+        break;
+    case DT_Double:
+        values.reserve(static_cast<qsizetype>(entry.count));
+        for (quint64 i = 0; i < entry.count; ++i)
+        {
+            values.append(reader.f64(entry.dataOffset+8*i));
+        }
+        break;
+    default:
         break;
     }
+    return values;
 }
 
 } // namespace
@@ -97,199 +268,184 @@ FileFormats::TIFF::TIFF(QIODevice& device)
 
 
 
+//
+// Getter Methods
+//
+
+QList<quint64> FileFormats::TIFF::integerValues(quint16 tag) const
+{
+    QList<quint64> result;
+    const auto values = m_TIFFFields.value(tag);
+    result.reserve(values.size());
+    for(const auto& value : values)
+    {
+        bool ok = false;
+        auto integer = value.toULongLong(&ok);
+        if (!ok)
+        {
+            return {};
+        }
+        result.append(integer);
+    }
+    return result;
+}
+
+QSize FileFormats::TIFF::tileSize() const
+{
+    auto width = integerValues(322);
+    auto height = integerValues(323);
+    if (width.isEmpty() || height.isEmpty())
+    {
+        return {};
+    }
+    return {static_cast<int>(width.constFirst()), static_cast<int>(height.constFirst())};
+}
+
+
+
 //
 // Private Methods
 //
 
 void FileFormats::TIFF::readTIFFData(QIODevice& device)
 {
-    QDataStream dataStream(&device);
+    Reader reader(device);
 
     try
     {
-        // Move to beginning of the data stream
-        if (!device.seek(0))
-        {
-            throw device.errorString();
-        }
+        // Read the beginning of the file. In most cases, this read covers the
+        // header, the IFD and the values that do not fit into the IFD.
+        reader.require(0, 8);
 
         // Check magic bytes
-        auto magicBytes = device.read(2);
+        auto magicBytes = reader.bytes(0, 2);
         if (magicBytes == "II")
         {
-            dataStream.setByteOrder(QDataStream::LittleEndian);
+            reader.setLittleEndian(true);
         }
         else if (magicBytes == "MM")
         {
-            dataStream.setByteOrder(QDataStream::BigEndian);
+            reader.setLittleEndian(false);
         }
         else
         {
             throw QObject::tr("Found invalid TIFF file data.", "FileFormats::TIFF");
         }
 
-        // version
-        quint16 version = 0;
-        dataStream >> version;
-        if (version == 43)
+        // Version and offset of the first IFD. BigTIFF files use 64 bit
+        // offsets and counts throughout.
+        bool bigTIFF = false;
+        quint64 ifdOffset = 0;
+        auto version = reader.u16(2);
+        if (version == 42)
         {
-            throw QObject::tr("BigTIFF files are not supported.", "FileFormats::TIFF");
+            ifdOffset = reader.u32(4);
         }
-        if (version != 42)
+        else if (version == 43)
         {
-            throw QObject::tr("Found an unsupported TIFF version.", "FileFormats::TIFF");
+            bigTIFF = true;
+            reader.require(0, 16);
+            if ((reader.u16(4) != 8) || (reader.u16(6) != 0))
+            {
+                throw QObject::tr("Found invalid TIFF file data.", "FileFormats::TIFF");
+            }
+            ifdOffset = reader.u64(8);
         }
-
-        // ifd0Offset
-        quint32 result = 0;
-        dataStream >> result;
-        checkForError(dataStream);
-        if (!device.seek(result))
+        else
         {
-            throw device.errorString();
+            throw QObject::tr("Found an unsupported TIFF version.", "FileFormats::TIFF");
         }
 
-        quint16 tagCount = 0;
-        dataStream >> tagCount;
-        checkForError(dataStream);
+        // Read the IFD
+        const quint64 countSize = bigTIFF ? 8 : 2;
+        const quint64 entrySize = bigTIFF ? 20 : 12;
+        const quint64 inlineSize = bigTIFF ? 8 : 4;
+        reader.require(ifdOffset, countSize);
+        quint64 tagCount = bigTIFF ? reader.u64(ifdOffset) : reader.u16(ifdOffset);
         if (tagCount > 100)
         {
             addWarning( QObject::tr("Found more than 100 tags in the TIFF file. Reading only the first 100.", "FileFormats::TIFF") );
             tagCount = 100;
         }
+        reader.require(ifdOffset, countSize+tagCount*entrySize);
 
-        for (quint16 i=0; i<tagCount; ++i)
+        QList<IFDEntry> entries;
+        entries.reserve(static_cast<qsizetype>(tagCount));
+        for (quint64 i=0; i<tagCount; ++i)
         {
-            readTIFFField(device, dataStream);
-        }
-
-        readRasterSize();
-    }
-    catch (QString& message)
-    {
-        setError(message);
-    }
-}
-
-
-void FileFormats::TIFF::readTIFFField(QIODevice& device, QDataStream& dataStream)
-{
-    // Read tag, type, and count
-    quint16 tag = 0;
-    quint16 type = DT_Undefined;
-    quint32 count = 0;
-    dataStream >> tag;
-    dataStream >> type;
-    dataStream >> count;
-    checkForError(dataStream);
-
-    // Compute the data size of this type
-    int typeSize = 0;
-    switch(type)
-    {
-    case DT_Byte:
-    case DT_SByte:
-    case DT_Ascii:
-    case DT_Undefined:
-        typeSize = 1;
-        break;
-
-    case DT_Short:
-    case DT_SShort:
-        typeSize = 2;
-        break;
-
-    case DT_Long:
-    case DT_SLong:
-    case DT_Ifd:
-    case DT_Float:
-        typeSize = 4;
-        break;
-
-    case DT_Rational:
-    case DT_SRational:
-    case DT_Long8:
-    case DT_SLong8:
-    case DT_Ifd8:
-    case DT_Double:
-        typeSize = 8;
-        break;
-
-    default:
-        typeSize = 0;
-        break;
-    }
-
-    // Save file position and move to the position where the data actually
-    // resides.
-    auto filePos = device.pos();
-    auto byteSize = typeSize*count;
-    if (byteSize > 4)
-    {
-        quint32 newPos = 0;
-        dataStream >> newPos;
-        checkForError(dataStream);
-        if (!device.seek(newPos))
-        {
-            throw device.errorString();
+            auto entryOffset = ifdOffset + countSize + i*entrySize;
+            IFDEntry entry;
+            entry.tag = reader.u16(entryOffset);
+            entry.type = reader.u16(entryOffset+2);
+            entry.count = bigTIFF ? reader.u64(entryOffset+4) : reader.u32(entryOffset+4);
+            if (!isDecoded(entry.type))
+            {
+                entries.append(entry);
+                continue;
+            }
+            auto valueOffset = entryOffset + (bigTIFF ? 12 : 8);
+            auto size = typeSize(entry.type);
+            if ((size > 0) && (entry.count > maxFieldSize/size))
+            {
+                throw QObject::tr("Found corrupt data while reading the data stream.", "FileFormats::TIFF");
+            }
+            entry.dataSize = size*entry.count;
+            entry.dataOffset = valueOffset;
+            if (entry.dataSize > inlineSize)
+            {
+                entry.dataOffset = bigTIFF ? reader.u64(valueOffset) : reader.u32(valueOffset);
+            }
+            entries.append(entry);
         }
-    }
 
-    // Read data entries from the device
-    QVariantList values;
-    switch (type)
-    {
-    case DT_Ascii:
-    {
-        auto tmpString = device.read(count);
-        if (tmpString.size() != count)
-        {
-            throw QObject::tr("Cannot read data.", "FileFormats::TIFF");
-        }
-        foreach(auto subStrings, tmpString.split(0))
+        // Read the values. If they lie close together, which is the usual
+        // case, a single read suffices. Values that are stored inside the IFD
+        // entries are included, so that they remain available. Entries of
+        // types that are not decoded are skipped, so that large or broken
+        // blobs (ICC profiles, XMP, GDAL metadata) do not affect reading.
+        quint64 spanBegin = std::numeric_limits<quint64>::max();
+        quint64 spanEnd = 0;
+        for(const auto& entry : std::as_const(entries))
         {
-            values.append(QString::fromLatin1(subStrings));
+            if (!isDecoded(entry.type))
+            {
+                continue;
+            }
+            spanBegin = qMin(spanBegin, entry.dataOffset);
+            spanEnd = qMax(spanEnd, entry.dataOffset+entry.dataSize);
         }
-    }
-    break;
-    case DT_Short:
-        values.reserve(count);
-        for (quint32 i = 0; i < count; ++i)
+        bool const singleSpan = (spanBegin <= spanEnd) && (spanEnd-spanBegin <= maxSpan);
+        if (singleSpan)
         {
-            quint16 tmpInt = 0;
-            dataStream >> tmpInt;
-            checkForError(dataStream);
-            values.append(tmpInt);
+            reader.require(spanBegin, spanEnd-spanBegin);
         }
-        break;
-    case DT_Double:
-        values.reserve(count);
-        for (quint32 i = 0; i < count; ++i)
+        for(const auto& entry : std::as_const(entries))
         {
-            double tmpFloat = NAN;
-            dataStream >> tmpFloat;
-            checkForError(dataStream);
-            values.append(tmpFloat);
+            if (!isDecoded(entry.type))
+            {
+                m_TIFFFields[entry.tag] = {};
+                continue;
+            }
+            if (!singleSpan)
+            {
+                reader.require(entry.dataOffset, entry.dataSize);
+            }
+            m_TIFFFields[entry.tag] = decode(reader, entry);
         }
-        break;
-    default:
-        break;
-    }
 
-    // Position the device at the byte following the current entry
-    if (!device.seek(filePos+4))
+        readRasterSize();
+    }
+    catch (QString& message)
     {
-        throw device.errorString();
+        setError(message);
     }
-
-    m_TIFFFields[tag] = values;
 }
 
 
 void FileFormats::TIFF::readRasterSize()
 {
     // Handle Tag 256, compute width
-    quint16 width = 0;
+    quint32 width = 0;
     {
         if (m_TIFFFields.contains(256))
         {
@@ -312,7 +468,7 @@ void FileFormats::TIFF::readRasterSize()
     }
 
     // Handle Tag 257, compute height
-    quint16 height = 0;
+    quint32 height = 0;
     {
         if (m_TIFFFields.contains(257))
         {
@@ -334,5 +490,5 @@ void FileFormats::TIFF::readRasterSize()
         }
     }
 
-    m_rasterSize = QSize(width, height);
+    m_rasterSize = QSize(static_cast<int>(width), static_cast<int>(height));
 }
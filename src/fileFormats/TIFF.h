@@ -36,6 +36,13 @@ namespace FileFormats
  *  This class reads GeoTIFF files. It extracts image dimension as well
  *  as the TIFF fields. It does not read the raster data.
  *
+ *  Classic TIFF and BigTIFF files in either byte order are supported. Only the
+ *  first image file directory is read. The data is read in large blocks, so
+ *  that for typical files one or two reads from the device suffice.
+ *
+ *  The positions of the raster data strips or tiles within the file are
+ *  available through the getter methods, so that raster data can be read
+ *  selectively, without decoding the whole image.
  */
 
 class TIFF : public DataFileAbstract
@@ -78,6 +85,49 @@ public:
      */
     [[nodiscard]] QSize rasterSize() { return m_rasterSize; }
 
+    /*! \brief Number of rows per strip
+     *
+     * @returns Content of tag 278, or an empty list if the tag is not set
+     */
+    [[nodiscard]] QList<quint64> rowsPerStrip() const { return integerValues(278); }
+
+    /*! \brief Sizes of the raster data strips
+     *
+     * @returns Content of tag 279, or an empty list if the image is not
+     * organized in strips
+     */
+    [[nodiscard]] QList<quint64> stripByteCounts() const { return integerValues(279); }
+
+    /*! \brief File positions of the raster data strips
+     *
+     * @returns Content of tag 273, or an empty list if the image is not
+     * organized in strips
+     */
+    [[nodiscard]] QList<quint64> stripOffsets() const { return integerValues(273); }
+
+    /*! \brief Sizes of the raster data tiles
+     *
+     * @returns Content of tag 325, or an empty list if the image is not
+     * organized in tiles
+     */
+    [[nodiscard]] QList<quint64> tileByteCounts() const { return integerValues(325); }
+
+    /*! \brief File positions of the raster data tiles
+     *
+     * Tiles are ordered left-to-right and top-to-bottom.
+     *
+     * @returns Content of tag 324, or an empty list if the image is not
+     * organized in tiles
+     */
+    [[nodiscard]] QList<quint64> tileOffsets() const { return integerValues(324); }
+
+    /*! \brief Size of the raster data tiles
+     *
+     * @returns Content of tags 322 and 323, or an invalid size if the image is
+     * not organized in tiles
+     */
+    [[nodiscard]] QSize tileSize() const;
+
 
     //
     // Static methods
@@ -91,30 +141,22 @@ public:
 
 private:
     /* This methods reads the TIFF data from the device. On success, it fills
-     * the memeber m_TIFFFields with appropriate data. On failure, it throws a
-     * QString with a human-readable, translated error message.
+     * the memeber m_TIFFFields with appropriate data. On failure, it sets an
+     * error with a human-readable, translated error message.
+     *
+     * Fields are read if their values are of type ASCII, BYTE, SHORT, LONG,
+     * LONG8 or DOUBLE. For fields of other types, the list of values will be
+     * empty.
      *
      * @param device QIODevice from which the TIFF header will be read. This
      * device must be seekable.
      */
     void readTIFFData(QIODevice& device);
 
-    /* This methods reads a single TIFF field from the device. On success, it
-     * adds an entry to the member m_TIFFFields and positions the device on the
-     * byte following the structure. On failure, it throws a QString with a
-     * human-readable, translated error message.
-     *
-     * This method only reads values of type ASCII, SHORT and DOUBLE. Values of
-     * other types will be ignored.
-     *
-     * @param device QIODevice from which the TIFF header will be read. This
-     * device must be open, seekable, and positioned to the beginning of the
-     * TIFF field structure.
-     *
-     * @param dataStream QDataStream that is connected to the device and has the
-     * correct endianness set.
+    /* Returns the values of the given tag as unsigned integers, or an empty
+     * list if the tag is not set or has non-integer values.
      */
-    void readTIFFField(QIODevice& device, QDataStream& dataStream);
+    [[nodiscard]] QList<quint64> integerValues(quint16 tag) const;
 
     /* This method interprets m_TIFFFields, extracts the size of the raster
      * image and writes the result into m_rasterSize.
@@ -18,15 +18,21 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QDebug>
 #include <QDir>
 #include <QFile>
 #include <QGeoCoordinate>
 #include <QImage>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSet>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <atomic>
 
 #include "fileFormats/TripKit.h"
 #include "geomaps/VAC.h"
+#include "geomaps/VACTiler.h"
 
 using namespace Qt::Literals::StringLiterals;
 
@@ -58,12 +64,83 @@ GeoMaps::VAC FileFormats::TripKit::extract(const QString& directoryPath, qsizety
     {
         return {};
     }
-    auto entry = m_entries.at(index);
+    return extract(m_zip, m_entries.at(index), directoryPath);
+}
+
+
+QList<GeoMaps::VAC> FileFormats::TripKit::extractAll(const QString& directoryPath, const std::function<void(qsizetype)>& progress)
+{
+    // Charts with the same name would be written to the same file. Keep only
+    // the last one, which would win if the charts were extracted in order.
+    QList<chartEntry> entries;
+    {
+        QSet<QString> namesSeen;
+        for (auto i = m_entries.size()-1; i >= 0; i--)
+        {
+            if (namesSeen.contains(m_entries.at(i).name))
+            {
+                continue;
+            }
+            namesSeen += m_entries.at(i).name;
+            entries.prepend(m_entries.at(i));
+        }
+    }
+
+    if (entries.isEmpty())
+    {
+        return {};
+    }
+
+    // Distribute the charts among the workers. libzip handles are not
+    // thread-safe, so every worker reopens the ZIP file.
+    auto numWorkers = qBound(1, QThreadPool::globalInstance()->maxThreadCount(), static_cast<int>(entries.size()));
+    QList<QList<chartEntry>> batches(numWorkers);
+    for (qsizetype i = 0; i < entries.size(); i++)
+    {
+        batches[i % numWorkers].append(entries.at(i));
+    }
+
+    // Charts that were skipped count as done
+    std::atomic<qsizetype> numExtracted {m_entries.size()-entries.size()};
+    auto extractBatch = [&](const QList<chartEntry>& batch) {
+        QList<GeoMaps::VAC> result;
+        auto zip = m_zip.reopen();
+        if (!zip->isValid())
+        {
+            return result;
+        }
+        for (const auto& entry : batch)
+        {
+            auto vac = extract(*zip, entry, directoryPath);
+            if (vac.isValid())
+            {
+                result.append(vac);
+            }
+            auto done = ++numExtracted;
+            if (progress)
+            {
+                progress(done);
+            }
+        }
+        return result;
+    };
+
+    QList<GeoMaps::VAC> result;
+    const auto batchResults = QtConcurrent::blockingMapped<QList<QList<GeoMaps::VAC>>>(batches, extractBatch);
+    for (const auto& batchResult : batchResults)
+    {
+        result += batchResult;
+    }
+    return result;
+}
+
 
-    auto imageData = m_zip.extract(entry.path);
+GeoMaps::VAC FileFormats::TripKit::extract(FileFormats::ZipFile& zip, const chartEntry& entry, const QString& directoryPath)
+{
+    auto imageData = zip.extract(entry.path);
     if (imageData.isEmpty())
     {
-        imageData = m_zip.extract("charts/"+entry.name+"-geo."+entry.ending);
+        imageData = zip.extract("charts/"+entry.name+"-geo."+entry.ending);
     }
     if (imageData.isEmpty())
     {
@@ -74,7 +151,14 @@ GeoMaps::VAC FileFormats::TripKit::extract(const QString& directoryPath, qsizety
         return {};
     }
 
+    // Only a few charts are decoded at the same time, because every decoded
+    // chart takes hundreds of MB of memory
+    GeoMaps::VACTiler::Job const job;
+
+    // WebP files are copied without decoding, so that they remain usable if
+    // decoding fails. Other formats are converted.
     auto newFileName = u"%1/%2.webp"_s.arg(directoryPath, entry.name);
+    auto image = QImage::fromData(imageData);
     if (entry.ending == u"webp"_s)
     {
         QFile out(newFileName);
@@ -90,16 +174,12 @@ GeoMaps::VAC FileFormats::TripKit::extract(const QString& directoryPath, qsizety
     }
     else
     {
-        auto image = QImage::fromData(imageData);
-        if (image.isNull())
-        {
-            return {};
-        }
-        if (!image.save(newFileName))
+        if (image.isNull() || !image.save(newFileName))
         {
             return {};
         }
     }
+    imageData.clear();
 
     GeoMaps::VAC vac;
     vac.name = entry.name;
@@ -108,6 +188,15 @@ GeoMaps::VAC FileFormats::TripKit::extract(const QString& directoryPath, qsizety
     vac.topRight = entry.topRight;
     vac.bottomLeft = entry.bottomLeft;
     vac.bottomRight = entry.bottomRight;
+
+    // Cut the chart into a tile pyramid. The pyramid is optional: without it,
+    // the map shows the raster image file.
+    auto error = GeoMaps::VACTiler::writeMBTILES(vac, image, GeoMaps::VAC::tilesFileNameFor(newFileName));
+    if (!error.isEmpty())
+    {
+        qWarning() << "Unable to write tile pyramid for" << entry.name << error;
+    }
+    vac.hasTiles = error.isEmpty();
     return vac;
 }
 
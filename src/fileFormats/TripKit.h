@@ -22,6 +22,7 @@
 
 #include <QGeoCoordinate>
 #include <QJsonArray>
+#include <functional>
 
 #include "fileFormats/ZipFile.h"
 #include "geomaps/VAC.h"
@@ -88,7 +89,8 @@ public:
      *  an appropriate file name of the form
      *  "baseName-geo_7.739665_48.076416_7.9063883_47.96452.webp". If the image
      *  is not in webp format already, it will be converted to webp using a
-     *  lossy encoder. This method is slow.
+     *  lossy encoder. Next to the image file, a tile pyramid is written with
+     *  GeoMaps::VACTiler. This method is slow.
      *
      *  @param directoryPath Name of a directory where the VAC will be stored.
      *  The directory and its parents are created if necessary
@@ -99,6 +101,24 @@ public:
      */
     [[nodiscard]] GeoMaps::VAC extract(const QString& directoryPath, qsizetype index);
 
+    /*! \brief Extract all visual approach charts
+     *
+     *  This method extracts all charts, as extract() does, using the global
+     *  thread pool. Every worker opens its own handle to the ZIP file. If
+     *  several charts share the same name, only the last one is extracted.
+     *  The method blocks until all charts are extracted.
+     *
+     *  @param directoryPath Name of a directory where the VACs will be stored.
+     *  The directory and its parents are created if necessary
+     *
+     *  @param progress Optional function that is called whenever a chart has
+     *  been extracted, with the number of charts extracted so far. The
+     *  function is called from worker threads and must be thread-safe.
+     *
+     *  @returns List of valid VACs that have been extracted
+     */
+    [[nodiscard]] QList<GeoMaps::VAC> extractAll(const QString& directoryPath, const std::function<void(qsizetype)>& progress = {});
+
 
     //
     // Static methods
@@ -129,6 +149,9 @@ private:
         QGeoCoordinate bottomLeft;
         QGeoCoordinate bottomRight;
     };
+    // Extracts one chart, see extract()
+    static GeoMaps::VAC extract(FileFormats::ZipFile& zip, const chartEntry& entry, const QString& directoryPath);
+
     QList<TripKit::chartEntry> m_entries;
 
     FileFormats::ZipFile m_zip;
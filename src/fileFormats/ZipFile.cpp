@@ -29,10 +29,7 @@
 FileFormats::ZipFile::ZipFile(const QString& fileName)
 {
     m_file = openFileURL(fileName);
-
-    int error = 0;
-    m_zip = zip_open(m_file->fileName().toUtf8().data(), ZIP_RDONLY, &error);
-    if (m_zip == nullptr)
+    if (!open())
     {
         setError(QObject::tr("Cannot open zip file %1 for reading.", "FileFormats::ZipFile").arg(fileName));
         return;
@@ -77,6 +74,29 @@ FileFormats::ZipFile::~ZipFile()
 }
 
 
+QSharedPointer<FileFormats::ZipFile> FileFormats::ZipFile::reopen() const
+{
+    auto result = QSharedPointer<ZipFile>(new ZipFile());
+    result->m_file = m_file;
+    if (m_file.isNull() || !result->open())
+    {
+        result->setError(QObject::tr("Cannot open zip file %1 for reading.", "FileFormats::ZipFile").arg(m_file.isNull() ? QString() : m_file->fileName()));
+        return result;
+    }
+    result->m_fileNames = m_fileNames;
+    result->m_fileSizes = m_fileSizes;
+    return result;
+}
+
+
+bool FileFormats::ZipFile::open()
+{
+    int error = 0;
+    m_zip = zip_open(m_file->fileName().toUtf8().data(), ZIP_RDONLY, &error);
+    return m_zip != nullptr;
+}
+
+
 QByteArray FileFormats::ZipFile::extract(qsizetype index)
 {
     if (m_zip == nullptr)
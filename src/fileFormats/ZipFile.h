@@ -81,6 +81,24 @@ public:
     [[nodiscard]] QByteArray extract(const QString& fileName);
 
 
+    //
+    // Methods
+    //
+
+    /*! \brief Open the zip file once more
+     *
+     *  Handles of libzip must not be used by several threads at the same time.
+     *  This method returns a new instance that reads the same file, but owns a
+     *  separate handle. The list of files is copied, the file is not analyzed
+     *  again. If the file was downloaded from an Android content URL, the
+     *  temporary copy is shared.
+     *
+     *  @returns New instance. This is never a nullptr, but the instance might
+     *  be invalid.
+     */
+    [[nodiscard]] QSharedPointer<ZipFile> reopen() const;
+
+
     //
     // Static methods
     //
@@ -94,6 +112,12 @@ public:
 private:
     Q_DISABLE_COPY_MOVE(ZipFile)
 
+    // Used by reopen()
+    ZipFile() = default;
+
+    // Opens m_file. Returns true on success.
+    bool open();
+
     void* m_zip {nullptr};
     QSharedPointer<QFile> m_file;
     QStringList m_fileNames;
@@ -74,6 +74,7 @@ void GeoMaps::GeoMapProvider::deferredInitialization()
     onMBTILESChanged();
 
     setCurrentRasterMap(QSettings().value("currentRasterMap", QString()).toString());
+    setCurrentVAC({});
     m_currentRasterMapNotifier = m_currentRasterMap.addNotifier([this]() {
         QSettings().setValue("currentRasterMap", m_currentRasterMap.value());
     });
@@ -472,6 +473,27 @@ void GeoMaps::GeoMapProvider::setCurrentRasterMap(const QString& mapName)
     emit styleFileURLChanged();
 }
 
+void GeoMaps::GeoMapProvider::setCurrentVAC(const GeoMaps::VAC& vac)
+{
+    auto tilesFileName = vac.tilesFileName();
+    if (tilesFileName == m_currentVACTilesFileName)
+    {
+        return;
+    }
+
+    auto tiles = QSharedPointer<FileFormats::MBTILES>(new FileFormats::MBTILES());
+    if (!tilesFileName.isEmpty())
+    {
+        tiles = QSharedPointer<FileFormats::MBTILES>(new FileFormats::MBTILES(tilesFileName));
+    }
+
+    m_tileServer.removeMbtilesFileSet(u"vac"_s);
+    const QVector<QSharedPointer<FileFormats::MBTILES>> single {tiles};
+    m_tileServer.addMbtilesFileSet(u"vac"_s, single);
+    m_currentVACTilesFileName = tilesFileName;
+    emit styleFileURLChanged();
+}
+
 
 //
 // Private Methods and Slots
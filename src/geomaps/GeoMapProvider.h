@@ -33,6 +33,7 @@
 #include "Airspace.h"
 #include "GlobalObject.h"
 #include "TileServer.h"
+#include "VAC.h"
 #include "Waypoint.h"
 #include "fileFormats/MBTILES.h"
 
@@ -331,6 +332,19 @@ public:
      */
     [[nodiscard]] Q_INVOKABLE QList<GeoMaps::Waypoint> nearbyWaypoints(const QGeoCoordinate& position, const QString& type);
 
+    /*! \brief Serve tile pyramid of a visual approach chart
+     *
+     *  If the VAC comes with a tile pyramid (see VAC::tilesFileName), the tiles
+     *  are exposed via the URL
+     *
+     *  GeoMapProvider.serverUrl() + "/vac/"
+     *
+     *  Otherwise, no tiles are served under that URL.
+     *
+     *  @param vac VAC that is currently shown on the moving map
+     */
+    Q_INVOKABLE void setCurrentVAC(const GeoMaps::VAC& vac);
+
 
 signals:
     /*! \brief Notification signal for the property with the same name */
@@ -399,6 +413,8 @@ private:
     QProperty<QString> m_currentRasterMap {u"non-empty place holder"_s};
     QPropertyNotifier m_currentRasterMapNotifier; // Used to save the currentRasterMap
 
+    QString m_currentVACTilesFileName {u"non-empty place holder"_s}; // Tile pyramid that is served under "/vac"
+
     // The data in this group is accessed by several threads. The following
     // classes (whose names ends in an underscore) are therefore protected by
     // this mutex.
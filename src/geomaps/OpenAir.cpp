@@ -19,18 +19,182 @@
 
 #include <QFile>
 #include <QGeoCoordinate>
-#include <QJsonArray>
 #include <QJsonDocument>
-#include <QJsonObject>
-#include <QTextStream>
+#include <QtMath>
 
 #include "OpenAir.h"
 #include "fileFormats/DataFileAbstract.h"
 
+#include <array>
 #include <cmath>
 
 using namespace Qt::Literals::StringLiterals;
 
+
+namespace {
+
+// Points on a circle around a center. The points are computed with the
+// spherical formula used by QGeoCoordinate::atDistanceAndAzimuth, but the
+// trigonometric functions of center and radius are computed only once per
+// circle.
+class ArcTessellator
+{
+public:
+    ArcTessellator(const QGeoCoordinate& center, double radius)
+    {
+        const auto ratio = radius/earthMeanRadius;
+        const auto latRad = qDegreesToRadians(center.latitude());
+        m_lonRad = qDegreesToRadians(center.longitude());
+        m_sinLat = std::sin(latRad);
+        m_cosLat = std::cos(latRad);
+        m_sinRatio = std::sin(ratio);
+        m_cosRatio = std::cos(ratio);
+
+        // Choose the angular step so that chords deviate from the arc by at
+        // most maxDeviation. Small circles keep the traditional 10° steps.
+        m_step = maxStep;
+        if (radius > maxDeviation)
+        {
+            m_step = qBound(minStep, qRadiansToDegrees(2.0*std::acos(1.0 - maxDeviation/radius)), maxStep);
+        }
+    }
+
+    // Angular step between consecutive points, in degrees
+    [[nodiscard]] double step() const { return m_step; }
+
+    // Point on the circle at the given azimuth, in degrees
+    [[nodiscard]] QGeoCoordinate at(double azimuth) const
+    {
+        const auto azimuthRad = qDegreesToRadians(azimuth);
+        const auto sinLat = m_sinLat*m_cosRatio + m_cosLat*m_sinRatio*std::cos(azimuthRad);
+        const auto latRad = std::asin(sinLat);
+        const auto lonRad = m_lonRad + std::atan2(std::sin(azimuthRad)*m_sinRatio*m_cosLat, m_cosRatio - m_sinLat*sinLat);
+
+        auto lon = qRadiansToDegrees(lonRad);
+        if (lon > 180.0)
+        {
+            lon -= 360.0;
+        }
+        if (lon < -180.0)
+        {
+            lon += 360.0;
+        }
+        return {qRadiansToDegrees(latRad), lon};
+    }
+
+private:
+    // Mean earth radius, as used in QGeoCoordinate
+    static constexpr double earthMeanRadius = 6371007.2;
+
+    // Maximal distance between chord and arc, in meters
+    static constexpr double maxDeviation = 25.0;
+
+    // Bounds for the angular step, in degrees
+    static constexpr double minStep = 2.0;
+    static constexpr double maxStep = 10.0;
+
+    double m_lonRad {0.0};
+    double m_sinLat {0.0};
+    double m_cosLat {1.0};
+    double m_sinRatio {0.0};
+    double m_cosRatio {1.0};
+    double m_step {maxStep};
+};
+
+
+// Record types of the OpenAir format, and the prefixes of the lines that
+// contain them
+enum class RecordType : quint8
+{
+    Ignored,
+    AC,
+    AN,
+    AL,
+    AH,
+    V,
+    DP,
+    DC,
+    DA,
+    DB
+};
+
+struct Record
+{
+    QStringView prefix;
+    RecordType type;
+};
+
+constexpr std::array<Record, 10> records {{
+    {u"AC ", RecordType::AC},
+    {u"AN ", RecordType::AN},
+    {u"AL ", RecordType::AL},
+    {u"AH ", RecordType::AH},
+    {u"V ", RecordType::V},
+    {u"DP ", RecordType::DP},
+    {u"DC ", RecordType::DC},
+    {u"DA ", RecordType::DA},
+    {u"DB ", RecordType::DB},
+    {u"AT ", RecordType::Ignored},
+}};
+
+// Finds the record that matches the beginning of the line, or nullptr if
+// there is none
+const Record* findRecord(QStringView line)
+{
+    for (const auto& record : records)
+    {
+        if ((line.front() == record.prefix.front()) && line.startsWith(record.prefix))
+        {
+            return &record;
+        }
+    }
+    return nullptr;
+}
+
+
+// Appends a string to a JSON document, with quotes and escapes
+void appendJSONString(QByteArray& out, QStringView string)
+{
+    QString escaped;
+    escaped.reserve(string.size()+2);
+    escaped += u'"';
+    for (const auto character : string)
+    {
+        switch (character.unicode())
+        {
+        case u'"':
+            escaped += u"\\\""_s;
+            break;
+        case u'\\':
+            escaped += u"\\\\"_s;
+            break;
+        case u'\n':
+            escaped += u"\\n"_s;
+            break;
+        case u'\r':
+            escaped += u"\\r"_s;
+            break;
+        case u'\t':
+            escaped += u"\\t"_s;
+            break;
+        default:
+            if (character.unicode() < 0x20)
+            {
+                escaped += u"\\u%1"_s.arg(character.unicode(), 4, 16, u'0');
+            }
+            else
+            {
+                escaped += character;
+            }
+        }
+    }
+    escaped += u'"';
+    out += escaped.toUtf8();
+}
+
+} // namespace
+
+
 class AirSpace {
 public:
     QString ac;
@@ -41,13 +205,13 @@ public:
     QGeoCoordinate variableX;
     QVector<QGeoCoordinate> polygon;
 
-    void addPoint(const QString& qs)
+    void addPoint(QStringView qs)
     {
         QGeoCoordinate const point = toCoord(qs);
         polygon.prepend(point);
     }
 
-    void addCircle(const QString& qs)
+    void addCircle(QStringView qs)
     {
         bool ok = false;
         double const radius = qs.toDouble(&ok) * 1852;
@@ -57,9 +221,11 @@ public:
         }
         if (variableX.isValid())
         {
-            for (int i=0; i <= 360; i += 10)
+            ArcTessellator const tessellator(variableX, radius);
+            auto numSegments = qCeil(360.0/tessellator.step());
+            for (int i=0; i <= numSegments; i++)
             {
-                polygon.prepend(variableX.atDistanceAndAzimuth(radius, i));
+                polygon.prepend(tessellator.at(i*360.0/numSegments));
             }
         }
         else
@@ -68,10 +234,14 @@ public:
         }
     }
 
-    void addArc(const QString& qs)
+    void addArc(QStringView qs)
     {
         bool ok = false;
-        QStringList items = qs.split(u',', Qt::SkipEmptyParts);
+        auto items = qs.split(u',', Qt::SkipEmptyParts);
+        if (items.size() < 3)
+        {
+            throw QObject::tr("Invalid arc specification", "OpenAir");
+        }
         double const radius = items[0].toDouble(&ok) * 1852;
         if (!ok)
         {
@@ -121,11 +291,15 @@ public:
         }
     }
 
-    void addArcPoints(const QString& qs)
+    void addArcPoints(QStringView qs)
     {
-        QStringList items = qs.split(u',', Qt::SkipEmptyParts);
+        auto items = qs.split(u',', Qt::SkipEmptyParts);
+        if (items.size() < 2)
+        {
+            throw QObject::tr("Invalid arc specification", "OpenAir");
+        }
         QGeoCoordinate const startPoint = toCoord(items[0]);
-        if (items[1].startsWith(u" "_s))
+        if (items[1].startsWith(u' '))
         {
             items[1] = items[1].sliced(1);
         }
@@ -171,10 +345,11 @@ public:
             throw QObject::tr("Invalid arc specification", "OpenAir");
         }
 
+        ArcTessellator const tessellator(variableX, radius);
         do
         {
-            polygon.prepend(variableX.atDistanceAndAzimuth(radius, start));
-            start += 10;
+            polygon.prepend(tessellator.at(start));
+            start += tessellator.step();
         } while (start < end);
     }
 
@@ -185,10 +360,11 @@ public:
             throw QObject::tr("Invalid arc specification", "OpenAir");
         }
 
+        ArcTessellator const tessellator(variableX, radius);
         do
         {
-            polygon.prepend(variableX.atDistanceAndAzimuth(radius, start));
-            start -= 10;
+            polygon.prepend(tessellator.at(start));
+            start -= tessellator.step();
         } while (start > end);
     }
 
@@ -287,13 +463,13 @@ public:
         }
     }
 
-    void setVar(const QString& qs)
+    void setVar(QStringView qs)
     {
-        if (qs.startsWith(u"X="_s))
+        if (qs.startsWith(u"X="))
         {
             variableX = toCoord(qs.sliced(2));
         }
-        else if (qs.startsWith(u"D="_s))
+        else if (qs.startsWith(u"D="))
         {
             variableD = qs.at(2);
             if ((variableD != '-') && (variableD != '+'))
@@ -305,11 +481,11 @@ public:
     }
 
 private:
-    static double getNumber(const QString& degree)
+    static double getNumber(QStringView degree)
     {
         bool ok = false;
         double ret = NAN;
-        auto i = degree.indexOf(u":"_s);
+        auto i = degree.indexOf(u':');
         if (i < 0)
         {
             ret = degree.toDouble(&ok);
@@ -349,21 +525,29 @@ private:
         }
     }
 
-    static QGeoCoordinate toCoord(const QString& qs)
+    static QGeoCoordinate toCoord(QStringView qs)
     {
         double latitude = NAN;
         double longitude = NAN;
-        QStringList items = qs.split(u' ', Qt::SkipEmptyParts);
+        auto items = qs.split(u' ', Qt::SkipEmptyParts);
+        if (items.isEmpty())
+        {
+            throw QObject::tr("Invalid coordinate found: %1", "OpenAir").arg(qs);
+        }
         if (items[0].endsWith('N') || items[0].endsWith('S'))
         {
             items.insert(1, items[0].sliced(items[0].length() - 1));
             items[0].chop(1);
         }
+        if (items.size() < 3)
+        {
+            throw QObject::tr("Invalid coordinate found: %1", "OpenAir").arg(qs);
+        }
         latitude = getNumber(items[0]);
-        if (items[1].compare(u"S"_s) == 0)
+        if (items[1] == u"S")
         {
             latitude *= -1;
-        } else if (items[1].compare(u"N"_s) != 0)
+        } else if (items[1] != u"N")
         {
             throw QObject::tr("Invalid coordinate found: %1", "OpenAir").arg(qs);
         }
@@ -372,11 +556,15 @@ private:
             items.insert(3, items[2].sliced(items[2].length() - 1));
             items[2].chop(1);
         }
+        if (items.size() < 4)
+        {
+            throw QObject::tr("Invalid coordinate found: %1", "OpenAir").arg(qs);
+        }
         longitude = getNumber(items[2]);
-        if (items[3].compare(u"W"_s) == 0)
+        if (items[3] == u"W")
         {
             longitude *= -1;
-        } else if (items[3].compare(u"E"_s) != 0)
+        } else if (items[3] != u"E")
         {
             throw QObject::tr("Invalid coordinate found: %1", "OpenAir").arg(qs);
         }
@@ -409,129 +597,134 @@ public:
         return airSpaceVector.last().variableX;
     }
 
-    QJsonDocument getJson(const QString& fileName)
+    [[nodiscard]] bool isEmpty() const
     {
-        QJsonObject recObj;
-        QJsonObject featureObj;
-        QJsonObject propObj;
-        QJsonObject geomObj;
-        QJsonArray featureArray;
-        QJsonArray polygonArray;
-        QJsonArray coordArray;
-        QJsonArray coord;
-        QGeoCoordinate const point;
-
-        recObj.insert(u"type"_s, QJsonValue::fromVariant("FeatureCollection"));
-        recObj.insert(u"info"_s, QJsonValue::fromVariant(fileName));
+        return airSpaceVector.isEmpty();
+    }
+
+    // Writes GeoJSON directly, without building a QJsonDocument first.
+    // Properties are written in the alphabetical order used by QJsonObject.
+    [[nodiscard]] QByteArray getGeoJSON(const QString& fileName) const
+    {
+        if (airSpaceVector.isEmpty())
+        {
+            return {};
+        }
 
+        QByteArray result;
+        result += R"({"features":[)";
+        bool firstFeature = true;
         for (const auto &i : airSpaceVector) {
-            featureObj.insert(u"type"_s, QJsonValue::fromVariant("Feature"));
-            propObj = QJsonObject();
-            propObj.insert(u"NAM"_s, QJsonValue::fromVariant(i.an));
-            propObj.insert(u"ID"_s, QJsonValue::fromVariant(i.an));
-            propObj.insert(u"CAT"_s, QJsonValue::fromVariant(i.ac));
-            propObj.insert(u"TYP"_s, QJsonValue::fromVariant("AS"));
-            if (!i.al.isEmpty()) {
-                propObj.insert(u"BOT"_s, QJsonValue::fromVariant(i.al));
-            }
-            if (!i.ah.isEmpty()) {
-                propObj.insert(u"TOP"_s, QJsonValue::fromVariant(i.ah));
+            if (!firstFeature)
+            {
+                result += ',';
             }
-            featureObj.insert(u"properties"_s, propObj);
+            firstFeature = false;
 
-            while (coordArray.count() != 0)
+            result += '{';
+            if (i.polygon.size() > 1)
             {
-                coordArray.pop_back();
-            }
-            for (const auto &j : i.polygon) {
-                while (coord.count() != 0) {
-                    coord.pop_back();
+                result += R"("geometry":{"coordinates":[[)";
+                bool firstPoint = true;
+                for (const auto &j : i.polygon) {
+                    if (!firstPoint)
+                    {
+                        result += ',';
+                    }
+                    firstPoint = false;
+                    result += '[';
+                    result += QByteArray::number(j.longitude(), 'g', QLocale::FloatingPointShortest);
+                    result += ',';
+                    result += QByteArray::number(j.latitude(), 'g', QLocale::FloatingPointShortest);
+                    result += ']';
                 }
-                coord.append(j.longitude());
-                coord.append(j.latitude());
-                coordArray.append(coord);
+                result += R"(]],"type":"Polygon"},)";
             }
-            while (polygonArray.count() != 0)
-            {
-                polygonArray.pop_back();
+            result += R"("properties":{)";
+            if (!i.al.isEmpty()) {
+                result += R"("BOT":)";
+                appendJSONString(result, i.al);
+                result += ',';
             }
-            polygonArray.append(coordArray);
-            if (i.polygon.size() > 1) {
-                geomObj.insert(u"type"_s, QJsonValue::fromVariant("Polygon"));
-                geomObj.insert(u"coordinates"_s, polygonArray);
-                featureObj.insert(u"geometry"_s, geomObj);
+            result += R"("CAT":)";
+            appendJSONString(result, i.ac);
+            result += R"(,"ID":)";
+            appendJSONString(result, i.an);
+            result += R"(,"NAM":)";
+            appendJSONString(result, i.an);
+            if (!i.ah.isEmpty()) {
+                result += R"(,"TOP":)";
+                appendJSONString(result, i.ah);
             }
-
-            featureArray.append(featureObj);
-        }
-
-        if (featureArray.isEmpty())
-        {
-            return {};
+            result += R"(,"TYP":"AS"},"type":"Feature"})";
         }
-
-        recObj.insert(u"features"_s, featureArray);
-        QJsonDocument json(recObj);
-        return json;
+        result += R"(],"info":)";
+        appendJSONString(result, fileName);
+        result += R"(,"type":"FeatureCollection"})";
+        return result;
     }
 };
 
 
-bool GeoMaps::openAir::isValid(const QString& fileName, QString* info)
-{
-    QStringList errorList;
-    QStringList warnings;
-    auto json = parse(fileName, errorList, warnings);
+namespace {
 
-    if (info != nullptr)
-    {
-        *info = {};
-        if (!warnings.isEmpty())
-        {
-            *info += u"<p>"_s + QObject::tr("Warnings", "OpenAir") + u"</p>"_s;
-            *info += u"<ul style='margin-left:-25px;'>"_s;
-            foreach(auto warning, warnings)
-            {
-                *info += u"<li>"_s + warning + u"</li>"_s;
-            }
-            *info += u"</ul>"_s;
-        }
-    }
-
-    return (!json.isEmpty()) && errorList.isEmpty();
-}
-
-
-QJsonDocument GeoMaps::openAir::parse(const QString& fileName, QStringList& errorList, QStringList& warningList)
+// Reads a file in openAIR format
+AirSpaceVector readAirSpaces(const QString& fileName, QStringList& errorList, QStringList& warningList, const std::function<void(double)>& progress = {})
 {
-    QString line;
     AirSpace airSpace;
     AirSpaceVector airSpaceVector;
 
-
     auto inputFile = FileFormats::DataFileAbstract::openFileURL(fileName);
     if (!inputFile->open(QIODeviceBase::ReadOnly))
     {
         errorList << QObject::tr("Cannot open file %1", "OpenAir").arg(fileName);
         return {};
     }
-
-    QTextStream inputStream(inputFile.data());
-    inputStream.setEncoding(QStringConverter::Latin1);
+    auto const content = QString::fromLatin1(inputFile->readAll());
+    inputFile->close();
 
     bool hadError = false;
     int lineNo = 0;
-    while (inputStream.readLineInto(&line))
+    qsizetype lineStart = 0;
+    while (lineStart < content.size())
     {
+        auto lineEnd = content.indexOf(u'\n', lineStart);
+        if (lineEnd < 0)
+        {
+            lineEnd = content.size();
+        }
+        auto line = QStringView(content).sliced(lineStart, lineEnd-lineStart);
+        lineStart = lineEnd+1;
+        if (line.endsWith(u'\r'))
+        {
+            line.chop(1);
+        }
+
         lineNo++;
+        if (progress && (lineNo % 4096 == 0))
+        {
+            progress(static_cast<double>(lineStart)/static_cast<double>(content.size()));
+        }
+
+        if (line.isEmpty() || line.startsWith(u'*'))
+        {
+            continue;
+        }
 
         try {
-            if (line.startsWith(u"*"_s) || line.length() == 0)
+            const auto* record = findRecord(line);
+            if (record == nullptr)
             {
+                warningList.append(QObject::tr("Unrecognized record type in line %1: %2; Line ignored.", "OpenAir").arg(QString::number(lineNo), line));
                 continue;
             }
-            if (line.startsWith(u"AC "_s))
+
+            auto payload = line.sliced(record->prefix.size());
+            switch (record->type)
             {
+            case RecordType::Ignored:
+                break;
+            case RecordType::AC:
                 //if airSpace is already filled, the existing airSpace must be added to the list and a new airSpace must be initialized
                 if (airSpace.isSet())
                 {
@@ -543,58 +736,37 @@ QJsonDocument GeoMaps::openAir::parse(const QString& fileName, QStringList& erro
                     airSpace = AirSpace();
                     hadError = false;
                 }
-                airSpace.ac = line.sliced(3).trimmed();
-                continue;
-            }
-            if (line.startsWith(u"AN "_s))
-            {
-                airSpace.an = line.sliced(3);
+                airSpace.ac = payload.trimmed().toString();
+                break;
+            case RecordType::AN:
+                airSpace.an = payload.toString();
                 if (airSpaceVector.isSameName(airSpace.an))
                 {
                     airSpace.variableX = airSpaceVector.getLastX();
                 }
-                continue;
-            }
-            if (line.startsWith(u"AL "_s))
-            {
-                airSpace.setHeight(line.sliced(3), false);
-                continue;
-            }
-            if (line.startsWith(u"AH "_s))
-            {
-                airSpace.setHeight(line.sliced(3), true);
-                continue;
-            }
-            if (line.startsWith(u"V "_s))
-            {
-                airSpace.setVar(line.sliced(2));
-                continue;
-            }
-            if (line.startsWith(u"DP "_s))
-            {
-                airSpace.addPoint(line.sliced(3));
-                continue;
-            }
-            if (line.startsWith(u"DC "_s))
-            {
-                airSpace.addCircle(line.sliced(3));
-                continue;
-            }
-            if (line.startsWith(u"DA "_s))
-            {
-                airSpace.addArc(line.sliced(3));
-                continue;
-            }
-            if (line.startsWith(u"DB "_s))
-            {
-                airSpace.addArcPoints(line.sliced(3));
-                continue;
+                break;
+            case RecordType::AL:
+                airSpace.setHeight(payload.toString(), false);
+                break;
+            case RecordType::AH:
+                airSpace.setHeight(payload.toString(), true);
+                break;
+            case RecordType::V:
+                airSpace.setVar(payload);
+                break;
+            case RecordType::DP:
+                airSpace.addPoint(payload);
+                break;
+            case RecordType::DC:
+                airSpace.addCircle(payload);
+                break;
+            case RecordType::DA:
+                airSpace.addArc(payload);
+                break;
+            case RecordType::DB:
+                airSpace.addArcPoints(payload);
+                break;
             }
-            if (line.startsWith(u"AT "_s))
-            {
-                continue;
-            }
-            warningList.append(QObject::tr("Unrecognized record type in line %1: %2; Line ignored.", "OpenAir").arg(QString::number(lineNo), line));
         }
         catch (QString& ex)
         {
@@ -608,5 +780,44 @@ QJsonDocument GeoMaps::openAir::parse(const QString& fileName, QStringList& erro
         airSpaceVector.addAirSpace(airSpace);
     }
 
-    return airSpaceVector.getJson(fileName);
+    return airSpaceVector;
+}
+
+} // namespace
+
+
+bool GeoMaps::openAir::isValid(const QString& fileName, QString* info)
+{
+    QStringList errorList;
+    QStringList warnings;
+    auto airSpaces = readAirSpaces(fileName, errorList, warnings);
+
+    if (info != nullptr)
+    {
+        *info = {};
+        if (!warnings.isEmpty())
+        {
+            *info += u"<p>"_s + QObject::tr("Warnings", "OpenAir") + u"</p>"_s;
+            *info += u"<ul style='margin-left:-25px;'>"_s;
+            foreach(auto warning, warnings)
+            {
+                *info += u"<li>"_s + warning + u"</li>"_s;
+            }
+            *info += u"</ul>"_s;
+        }
+    }
+
+    return (!airSpaces.isEmpty()) && errorList.isEmpty();
+}
+
+
+QJsonDocument GeoMaps::openAir::parse(const QString& fileName, QStringList& errorList, QStringList& warningList)
+{
+    return QJsonDocument::fromJson(toGeoJSON(fileName, errorList, warningList));
+}
+
+
+QByteArray GeoMaps::openAir::toGeoJSON(const QString& fileName, QStringList& errorList, QStringList& warningList, const std::function<void(double)>& progress)
+{
+    return readAirSpaces(fileName, errorList, warningList, progress).getGeoJSON(fileName);
 }
@@ -18,6 +18,7 @@
  ***************************************************************************/
 
 #include <QJsonDocument>
+#include <functional>
 
 namespace GeoMaps
 {
@@ -54,6 +55,26 @@ public:
      *  If error messages were appended, returns an empty QJsonDocument
      */
     static QJsonDocument parse(const QString& fileName, QStringList& errorList, QStringList& warningList);
+
+    /*! \brief Reads a file in openAIR format and returns GeoJSON data
+     *
+     *  This method works like parse(), but writes the GeoJSON data directly,
+     *  without building a QJsonDocument. It does not touch any global objects
+     *  and can be called from any thread.
+     *
+     *  @param fileName Name of the openAIR file
+     *
+     *  @param errorList Reference to a QStringList where error messages will be appended.
+     *
+     *  @param warningList Reference to a QStringList where warnings will be appended.
+     *
+     *  @param progress Optional function that is called from time to time
+     *  with a number between 0.0 and 1.0, indicating reading progress
+     *
+     *  @return GeoJSON data, or an empty QByteArray if the file contains no
+     *  airspaces
+     */
+    static QByteArray toGeoJSON(const QString& fileName, QStringList& errorList, QStringList& warningList, const std::function<void(double)>& progress = {});
 };
 
 
@@ -22,12 +22,97 @@
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QPointer>
+#include <QtMath>
+#include <cmath>
 
 #include "TileHandler.h"
 
 using namespace Qt::Literals::StringLiterals;
 
 
+namespace {
+
+// Checks that the coverage bitmap of a file contains, for every zoom level
+// from minzoom to maxZoom, exactly the tiles that meet the bounds given in the
+// metadata. Returns false if minzoom or bounds are missing.
+bool matchesBounds(const QBitArray& coverage, const QMap<QString, QString>& metaData, int maxZoom)
+{
+    if (coverage.size() != FileFormats::MBTILES::coverageIndex(maxZoom+1, 0, 0))
+    {
+        return false;
+    }
+
+    bool ok = false;
+    auto minZoom = metaData.value(u"minzoom"_s).toInt(&ok);
+    if (!ok || (minZoom < 0) || (minZoom > maxZoom))
+    {
+        return false;
+    }
+    auto fileMaxZoom = metaData.value(u"maxzoom"_s).toInt(&ok);
+    if (!ok || (fileMaxZoom < maxZoom))
+    {
+        return false;
+    }
+
+    auto bounds = metaData.value(u"bounds"_s).split(',');
+    if (bounds.size() != 4)
+    {
+        return false;
+    }
+    QList<double> values;
+    for(const auto& bound : std::as_const(bounds))
+    {
+        values << bound.trimmed().toDouble(&ok);
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    // Shrink the bounds a little, so that bounds on tile edges do not reach
+    // into the neighbouring tiles
+    constexpr double epsilon = 1e-7;
+    auto left = qBound(-180.0, values[0], 180.0) + epsilon;
+    auto bottom = qBound(-85.0511, values[1], 85.0511) + epsilon;
+    auto right = qBound(-180.0, values[2], 180.0) - epsilon;
+    auto top = qBound(-85.0511, values[3], 85.0511) - epsilon;
+    if ((left > right) || (bottom > top))
+    {
+        return false;
+    }
+
+    // Web Mercator tile coordinates, in units where the world covers the unit
+    // square
+    auto tileX = [](double lon) { return (lon+180.0)/360.0; };
+    auto tileY = [](double lat) {
+        auto rad = qDegreesToRadians(lat);
+        return (1.0-std::log(std::tan(rad)+1.0/std::cos(rad))/M_PI)/2.0;
+    };
+
+    for(auto zoom = 0; zoom <= maxZoom; zoom++)
+    {
+        auto maxTile = (1 << zoom) - 1;
+        auto xMin = qBound(0, qFloor(tileX(left)*(1 << zoom)), maxTile);
+        auto xMax = qBound(0, qFloor(tileX(right)*(1 << zoom)), maxTile);
+        auto yMin = qBound(0, qFloor(tileY(top)*(1 << zoom)), maxTile);
+        auto yMax = qBound(0, qFloor(tileY(bottom)*(1 << zoom)), maxTile);
+        for(auto y = 0; y <= maxTile; y++)
+        {
+            for(auto x = 0; x <= maxTile; x++)
+            {
+                auto expected = (zoom >= minZoom) && (x >= xMin) && (x <= xMax) && (y >= yMin) && (y <= yMax);
+                if (coverage.testBit(FileFormats::MBTILES::coverageIndex(zoom, x, y)) != expected)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+
 GeoMaps::TileHandler::TileHandler(const QVector<QSharedPointer<FileFormats::MBTILES>>& mbtileFiles, const QString& baseURL) :
     m_mbtiles(mbtileFiles)
 {
@@ -50,8 +135,15 @@ GeoMaps::TileHandler::TileHandler(const QVector<QSharedPointer<FileFormats::MBTI
     {
         if (mbtPtr.isNull())
         {
+            m_coverage << QBitArray();
             continue;
         }
+        auto coverage = mbtPtr->coverage(coverageZoom);
+        if (!matchesBounds(coverage, mbtPtr->metaData(), coverageZoom))
+        {
+            coverage.clear();
+        }
+        m_coverage << coverage;
 
         _name = mbtPtr->metaData().value(QStringLiteral("name"));
         _encoding = mbtPtr->metaData().value(QStringLiteral("encoding"));
@@ -138,10 +230,18 @@ bool GeoMaps::TileHandler::process(QHttpServerResponder* responder, const QStrin
     auto x = pathElements[1].toInt();
     auto y = pathElements[2].section('.', 0, 0).toInt();
 
-    // Retrieve tile data from the database
-    foreach(auto mbtilesPtr, m_mbtiles)
+    auto maxTile = (1 << qBound(0, z, 30)) - 1;
+    if ((z < 0) || (z > 30) || (x < 0) || (x > maxTile) || (y < 0) || (y > maxTile))
+    {
+        return false;
+    }
+
+    // Retrieve tile data from the database, asking only those files that
+    // contain the tile
+    for(qsizetype index = 0; index < m_mbtiles.size(); index++)
     {
-        if (mbtilesPtr.isNull())
+        const auto& mbtilesPtr = m_mbtiles[index];
+        if (mbtilesPtr.isNull() || !covers(index, z, x, y))
         {
             continue;
         }
@@ -170,3 +270,22 @@ bool GeoMaps::TileHandler::process(QHttpServerResponder* responder, const QStrin
 
     return false;
 }
+
+
+bool GeoMaps::TileHandler::covers(qsizetype index, int zoom, int x, int y) const
+{
+    const auto& coverage = m_coverage.at(index);
+    if (coverage.isEmpty())
+    {
+        return true;
+    }
+
+    // For tiles above coverageZoom, look at the ancestor
+    if (zoom > coverageZoom)
+    {
+        x >>= zoom-coverageZoom;
+        y >>= zoom-coverageZoom;
+        zoom = coverageZoom;
+    }
+    return coverage.testBit(FileFormats::MBTILES::coverageIndex(zoom, x, y));
+}
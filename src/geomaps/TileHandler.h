@@ -36,12 +36,30 @@ namespace GeoMaps {
  *  QHttpServerResponder to reply with appropriate tile data, and with TileJSON
  *  (following the TileJSON Specification 2.2.0 found in
  *  https://github.com/mapbox/tilejson-spec/tree/master/2.2.0).
+ *
+ *  When the handler is constructed, it reads a coverage bitmap of every file,
+ *  with the tiles up to zoom level coverageZoom. Tile requests are sent only to
+ *  the files that contain the tile, or its ancestor at zoom level coverageZoom.
+ *  Requests for tiles that no file covers are answered without database
+ *  queries. A bitmap is used only if it can be trusted: the file must declare
+ *  its extent in the metadata entry "bounds", and every zoom level from
+ *  "minzoom" to coverageZoom must contain exactly the tiles that meet the
+ *  bounds. Then every tile within the bounds has its ancestor at zoom level
+ *  coverageZoom. Tilers that drop empty or filtered tiles at low zoom levels
+ *  fail this check. Such files are queried for every request.
  */
 
 class TileHandler
 {
 
 public:
+    /*! \brief Highest zoom level in the coverage bitmaps
+     *
+     *  A coverage bitmap has one bit for every tile up to this zoom level,
+     *  about 11kB per file.
+     */
+    static constexpr int coverageZoom = 8;
+
     /*! \brief Create a new tile handler
     *
     *  This constructor sets up a new tile handler.
@@ -78,9 +96,17 @@ public:
 private:
     Q_DISABLE_COPY_MOVE(TileHandler)
 
+    // Checks if the coverage bitmap of the MBTiles with the given index
+    // contains a tile or its ancestor at zoom level coverageZoom
+    [[nodiscard]] bool covers(qsizetype index, int zoom, int x, int y) const;
+
     // List of MBTiles
     QVector<QSharedPointer<FileFormats::MBTILES>> m_mbtiles;
 
+    // Coverage bitmaps of the MBTiles, in the same order as m_mbtiles. An
+    // empty bitmap means that coverage is unknown.
+    QVector<QBitArray> m_coverage;
+
     // Format of tiles. This is a short string such as "jpg", "pbf", "png" or
     // "webp".
     QString m_format;
@@ -119,6 +119,10 @@ public slots:
      *  from one of the files (a random one, in fact). If a tile is contained in
      *  more than one of the files, the data is expected to be identical in each
      *  of the files.
+     *
+     *  This method reads the low zoom levels of every file, in order to build
+     *  the coverage bitmaps used by TileHandler. Tile requests then go only to
+     *  the files that contain the tile.
      */
     void addMbtilesFileSet(const QString& baseName, const QVector<QSharedPointer<FileFormats::MBTILES>>& MBTilesFiles);
 
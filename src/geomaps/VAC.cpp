@@ -56,6 +56,8 @@ GeoMaps::VAC::VAC(const QString& fName)
     {
         getCoordsFromFileName();
     }
+
+    hasTiles = QFile::exists(tilesFileNameFor(fileName));
 }
 
 
@@ -102,6 +104,27 @@ bool GeoMaps::VAC::isValid() const
            && !name.isEmpty();
 }
 
+QString GeoMaps::VAC::tilesFileName() const
+{
+    if (!hasTiles)
+    {
+        return {};
+    }
+    return tilesFileNameFor(fileName);
+}
+
+
+
+//
+// Methods
+//
+
+QString GeoMaps::VAC::tilesFileNameFor(const QString& rasterFileName)
+{
+    QFileInfo const fileInfo(rasterFileName);
+    return fileInfo.dir().filePath(fileInfo.completeBaseName()+u".mbtiles"_s);
+}
+
 
 
 //
@@ -119,6 +119,16 @@ public:
     /*! \brief Name of the VAC. */
     Q_PROPERTY(QString name MEMBER name)
 
+    /*! \brief Name of tile pyramid file
+     *
+     * This property holds the name of an MBTILES file that contains the raster
+     * image as a pyramid of tiles, as written by VACTiler, or an empty string if
+     * no such file exists. The file is kept next to the raster image file, and
+     * has the same base name. The property is computed from the member
+     * hasTiles and does not access the file system.
+     */
+    Q_PROPERTY(QString tilesFileName READ tilesFileName)
+
     /*! \brief Geographic coordinate of raster image corner
      *
      * This coordinate might be invalid.
@@ -163,12 +173,27 @@ public:
      */
     [[nodiscard]] bool isValid() const;
 
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property tilesFileName
+     */
+    [[nodiscard]] QString tilesFileName() const;
+
 
 
     //
     // Methods
     //
 
+    /*! \brief Name of tile pyramid file that belongs to a raster image file
+     *
+     *  @param rasterFileName Name of a raster image file
+     *
+     *  @returns File name of the form "/path/baseName.mbtiles", regardless of
+     *  whether the file exists or not
+     */
+    [[nodiscard]] static QString tilesFileNameFor(const QString& rasterFileName);
+
     /*! \brief Comparison
      *
      * @param other VAC to compare *this with
@@ -206,6 +231,15 @@ public:
     /*! \brief Member variable for property of the same name */
     QString fileName;
 
+    /*! \brief Existence of a tile pyramid
+     *
+     *  True if the file tilesFileNameFor(fileName) exists. The constructor that
+     *  takes a file name checks this. Otherwise, the value must be set by
+     *  whoever writes, renames or deletes the tile pyramid. The value is not
+     *  serialized.
+     */
+    bool hasTiles {false};
+
     /*! \brief Member variable for property of the same name */
     QString name;
 
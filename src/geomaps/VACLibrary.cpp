@@ -18,15 +18,23 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
-#include <QCoreApplication>
+#include <QDebug>
 #include <QDirIterator>
+#include <QFutureWatcher>
 #include <QImage>
+#include <QSaveFile>
 #include <QTemporaryDir>
 #include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <cmath>
+#include <limits>
 
 #include "VACLibrary.h"
+#include "VACTiler.h"
 #include "fileFormats/TripKit.h"
 
+using namespace std::chrono_literals;
+
 
 
 //
@@ -36,16 +44,17 @@
 GeoMaps::VACLibrary::VACLibrary(QObject *parent)
     : QObject(parent)
 {
-    // Wire up: Save library whenever the content changes
-    connect(this, &GeoMaps::VACLibrary::dataChanged, this, &GeoMaps::VACLibrary::save, Qt::QueuedConnection);
-
-    // Restore previously saves VAC library
-    if (m_dataFile.open(QIODeviceBase::ReadOnly))
-    {
-        QDataStream dataStream(&m_dataFile);
-        dataStream >> m_vacs;
-    }
-    m_dataFile.close();
+    // Wire up: Save library shortly after the content changes. Cached
+    // orderings become invalid.
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(1s);
+    connect(&m_saveTimer, &QTimer::timeout, this, &GeoMaps::VACLibrary::save);
+    connect(this, &GeoMaps::VACLibrary::dataChanged, this, [this]() {
+        m_vacsByDistance.clear();
+        m_saveTimer.start();
+    });
+
+    load();
 
     // Call the janitor as soon as we have some time
     QTimer::singleShot(0, this, &GeoMaps::VACLibrary::janitor);
@@ -64,8 +73,8 @@ GeoMaps::VACLibrary::~VACLibrary()
 
 QVector<GeoMaps::VAC> GeoMaps::VACLibrary::vacs()
 {
-    std::sort(m_vacs.begin(), m_vacs.end(), [](const GeoMaps::VAC& first, const GeoMaps::VAC& second) { return first.name < second.name; });
-    return m_vacs;
+    // QMap is sorted by key, which is the name
+    return m_vacs.values();
 }
 
 
@@ -80,71 +89,105 @@ void GeoMaps::VACLibrary::clear()
     {
         return;
     }
-    foreach(auto vac, m_vacs)
+    for(const auto& vac : std::as_const(m_vacs))
     {
         QFile::remove(vac.fileName);
+        QFile::remove(GeoMaps::VAC::tilesFileNameFor(vac.fileName));
     }
     m_vacs.clear();
+    m_unsavedNames.clear();
+    m_needsSnapshot = true;
     emit dataChanged();
 }
 
 GeoMaps::VAC GeoMaps::VACLibrary::get(const QString& name)
 {
-    foreach(auto vac, m_vacs)
-    {
-        if (vac.name == name)
+    return m_vacs.value(name);
+}
+
+QString GeoMaps::VACLibrary::importTripKit(const QString& fileName)
+{
+    emit importTripKitStatus(0.0);
+    auto result = extractTripKit(fileName, m_vacDirectory);
+    emit importTripKitStatus(1.0);
+    return addTripKitVACs(fileName, result);
+}
+
+void GeoMaps::VACLibrary::startImportTripKit(const QString& fileName)
+{
+    emit importTripKitStatus(0.0);
+
+    auto* watcher = new QFutureWatcher<TripKitResult>(this);
+    connect(watcher, &QFutureWatcher<TripKitResult>::progressValueChanged, this, [this, watcher](int progressValue) {
+        auto maximum = watcher->progressMaximum();
+        if (maximum > 0)
         {
-            return vac;
+            emit importTripKitStatus(qMin(0.99, (double)progressValue/(double)maximum));
         }
-    }
-    return {};
+    });
+    connect(watcher, &QFutureWatcher<TripKitResult>::finished, this, [this, watcher, fileName]() {
+        watcher->deleteLater();
+        emit importTripKitStatus(1.0);
+        emit importTripKitFinished(addTripKitVACs(fileName, watcher->future().result()));
+    });
+
+    watcher->setFuture(QtConcurrent::run([fileName, directory = m_vacDirectory](QPromise<TripKitResult>& promise) {
+        promise.addResult(extractTripKit(fileName, directory, &promise));
+    }));
 }
 
-QString GeoMaps::VACLibrary::importTripKit(const QString& fileName)
+GeoMaps::VACLibrary::TripKitResult GeoMaps::VACLibrary::extractTripKit(const QString& fileName, const QString& directory, QPromise<TripKitResult>* promise)
 {
+    TripKitResult result;
+
     // Open Trip Kit
     FileFormats::TripKit tripKit(fileName);
     if (!tripKit.isValid())
     {
-        return tr("Unable to open TripKit file <strong>%1</strong>. Error: %2.").arg(fileName, tripKit.error());
+        result.error = tripKit.error();
+        return result;
     }
+    result.numCharts = tripKit.numCharts();
 
     // Create directory
     QDir const dir;
-    dir.mkpath(m_vacDirectory);
+    dir.mkpath(directory);
 
-    // Unpack the VACs into m_vacDirectory
-    auto size = tripKit.numCharts();
-    int successfulImports = 0;
-    for(auto idx=0; idx<size; idx++)
+    // Unpack the VACs into the directory, in the global thread pool
+    if (promise != nullptr)
     {
-        emit importTripKitStatus((double)idx/(double)size);
-        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-
-        auto vac = tripKit.extract(m_vacDirectory, idx);
-        if (!vac.isValid())
-        {
-            continue;
-        }
-        auto oldVac = get(vac.name);
-        if (oldVac.isValid())
+        promise->setProgressRange(0, static_cast<int>(result.numCharts));
+    }
+    result.vacs = tripKit.extractAll(directory, [promise](qsizetype numExtracted) {
+        if (promise != nullptr)
         {
-            m_vacs.removeAll(oldVac);
+            promise->setProgressValue(static_cast<int>(numExtracted));
         }
+    });
+    return result;
+}
 
-        m_vacs.append(vac);
-        successfulImports++;
+QString GeoMaps::VACLibrary::addTripKitVACs(const QString& fileName, const TripKitResult& result)
+{
+    if (!result.error.isEmpty())
+    {
+        return tr("Unable to open TripKit file <strong>%1</strong>. Error: %2.").arg(fileName, result.error);
+    }
+
+    for(const auto& vac : result.vacs)
+    {
+        insert(vac);
     }
-    emit importTripKitStatus(1.0);
     emit dataChanged();
 
+    auto successfulImports = result.vacs.size();
     if (successfulImports == 0)
     {
         return tr("Error reading TripKip: No charts imported.");
     }
-    if (successfulImports < size)
+    if (successfulImports < result.numCharts)
     {
-        return tr("Error reading TripKip: Only %1 out of %2 charts were successfully imported.").arg(successfulImports).arg(size);
+        return tr("Error reading TripKip: Only %1 out of %2 charts were successfully imported.").arg(successfulImports).arg(result.numCharts);
     }
 
     return {};
@@ -207,9 +250,20 @@ QString GeoMaps::VACLibrary::importVAC(const QString& fileName, const QString& n
         }
     }
 
-    // Set new file name and add to library
+    // Set new file name
     vac.fileName = newFileName;
-    m_vacs.append(vac);
+
+    // Cut the chart into a tile pyramid. The pyramid is optional: without it,
+    // the map shows the raster image file.
+    auto error = GeoMaps::VACTiler::writeMBTILES(vac, image, GeoMaps::VAC::tilesFileNameFor(newFileName));
+    if (!error.isEmpty())
+    {
+        qWarning() << "Unable to write tile pyramid for" << vac.name << error;
+    }
+    vac.hasTiles = error.isEmpty();
+
+    // Add to library
+    insert(vac);
 
     emit dataChanged();
 
@@ -218,25 +272,14 @@ QString GeoMaps::VACLibrary::importVAC(const QString& fileName, const QString& n
 
 void GeoMaps::VACLibrary::remove(const QString& baseName)
 {
-    QVector<GeoMaps::VAC> vacsToDelete;
-    foreach(auto vac, m_vacs)
-    {
-        if (vac.name == baseName)
-        {
-            vacsToDelete.append(vac);
-        }
-    }
-
-    if (vacsToDelete.isEmpty())
+    if (!m_vacs.contains(baseName))
     {
         return;
     }
 
-    foreach (auto vac, vacsToDelete)
-    {
-        QFile::remove(vac.fileName);
-        m_vacs.removeAll(vac);
-    }
+    auto vac = take(baseName);
+    QFile::remove(vac.fileName);
+    QFile::remove(GeoMaps::VAC::tilesFileNameFor(vac.fileName));
     emit dataChanged();
 }
 
@@ -255,12 +298,23 @@ QString GeoMaps::VACLibrary::rename(const QString& oldName, const QString& newNa
     {
         return tr("VAC file renaming failed.");
     }
+    auto tilesFileName = vac.tilesFileName();
+    if (!tilesFileName.isEmpty())
+    {
+        auto newTilesFileName = GeoMaps::VAC::tilesFileNameFor(newFileName);
+        QFile::remove(newTilesFileName);
+        if (!QFile::rename(tilesFileName, newTilesFileName))
+        {
+            QFile::remove(tilesFileName);
+            vac.hasTiles = false;
+        }
+    }
 
     // Remove old VAC from list, update data and add agaib
-    m_vacs.removeAll(vac);
+    take(oldName);
     vac.fileName = newFileName;
     vac.name = newName;
-    m_vacs.append(vac);
+    insert(vac);
 
     emit dataChanged();
     return {};
@@ -268,8 +322,30 @@ QString GeoMaps::VACLibrary::rename(const QString& oldName, const QString& newNa
 
 QVector<GeoMaps::VAC> GeoMaps::VACLibrary::vacsByDistance(const QGeoCoordinate& position)
 {
-    std::sort(m_vacs.begin(), m_vacs.end(), [position](const GeoMaps::VAC& first, const GeoMaps::VAC& second) {return position.distanceTo(first.center()) < position.distanceTo(second.center()); });
-    return m_vacs;
+    // Re-use the last ordering if the position lies in the same cell
+    auto cell = positionCell(position);
+    if (!m_vacsByDistance.isEmpty() && (cell == m_vacsByDistanceCell))
+    {
+        return m_vacsByDistance;
+    }
+
+    // Compute every distance once, then sort
+    QList<std::pair<double, GeoMaps::VAC>> vacsWithDistance;
+    vacsWithDistance.reserve(m_vacs.size());
+    for(const auto& vac : std::as_const(m_vacs))
+    {
+        vacsWithDistance.append({position.distanceTo(vac.center()), vac});
+    }
+    std::stable_sort(vacsWithDistance.begin(), vacsWithDistance.end(), [](const auto& first, const auto& second) { return first.first < second.first; });
+
+    m_vacsByDistance.clear();
+    m_vacsByDistance.reserve(vacsWithDistance.size());
+    for(const auto& [distance, vac] : std::as_const(vacsWithDistance))
+    {
+        m_vacsByDistance.append(vac);
+    }
+    m_vacsByDistanceCell = cell;
+    return m_vacsByDistance;
 }
 
 
@@ -278,68 +354,261 @@ QVector<GeoMaps::VAC> GeoMaps::VACLibrary::vacsByDistance(const QGeoCoordinate&
 // Private Methods
 //
 
-void GeoMaps::VACLibrary::janitor()
+void GeoMaps::VACLibrary::insert(const GeoMaps::VAC& vac)
+{
+    m_vacs.insert(vac.name, vac);
+    m_unsavedNames.insert(vac.name);
+}
+
+GeoMaps::VAC GeoMaps::VACLibrary::take(const QString& name)
+{
+    m_unsavedNames.insert(name);
+    return m_vacs.take(name);
+}
+
+qint64 GeoMaps::VACLibrary::positionCell(const QGeoCoordinate& position)
 {
-    // Go through the list of all VAC. Find all VACs without image file, and a list of all image file managed
-    // by VACs in the list
-    QVector<GeoMaps::VAC> vacsWithoutImageFile;
-    QVector<QFileInfo> imageFilesWithVAC;
-    foreach(auto vac, m_vacs)
+    if (!position.isValid())
     {
-        if (QFile::exists(vac.fileName))
+        return std::numeric_limits<qint64>::min();
+    }
+    auto latCell = static_cast<qint64>(std::floor(position.latitude()/positionCellSizeInDegrees));
+    auto lonCell = static_cast<qint64>(std::floor(position.longitude()/positionCellSizeInDegrees));
+    return (latCell << 32) + lonCell;
+}
+
+GeoMaps::VACLibrary::JanitorResult GeoMaps::VACLibrary::inspect(const QString& directory, const QHash<QString, QString>& managedFiles)
+{
+    JanitorResult result;
+
+    // Find all VACs without image file
+    for(auto it = managedFiles.cbegin(); it != managedFiles.cend(); ++it)
+    {
+        if (!QFile::exists(it.key()))
         {
-            imageFilesWithVAC.append(QFileInfo(vac.fileName));
+            result.vacsWithoutImageFile.append(it.value());
+        }
+    }
+
+    // Find all files without VAC. Tile pyramids belong to the raster image
+    // file of the same base name, if there is any.
+    QSet<QString> managedTiles;
+    for(auto it = managedFiles.cbegin(); it != managedFiles.cend(); ++it)
+    {
+        managedTiles.insert(GeoMaps::VAC::tilesFileNameFor(it.key()));
+    }
+    QSet<QString> tilesWithImageFile;
+    QStringList unmanagedFiles;
+    QDirIterator fileIterator(directory, QDir::Files);
+    while (fileIterator.hasNext())
+    {
+        fileIterator.next();
+        auto filePath = fileIterator.filePath();
+        if (!filePath.endsWith(u".mbtiles"_s))
+        {
+            tilesWithImageFile.insert(GeoMaps::VAC::tilesFileNameFor(filePath));
+        }
+        if (managedFiles.contains(filePath) || managedTiles.contains(filePath))
+        {
+            continue;
+        }
+        unmanagedFiles.append(filePath);
+    }
+
+    // Classify the unmanaged files. Constructing a VAC reads at most the TIFF
+    // header, so the raster data is never decoded here.
+    for(const auto& filePath : std::as_const(unmanagedFiles))
+    {
+        if (filePath.endsWith(u".mbtiles"_s))
+        {
+            if (!tilesWithImageFile.contains(filePath))
+            {
+                result.filesToDelete.append(filePath);
+            }
+            continue;
+        }
+        GeoMaps::VAC const vac(filePath);
+        if (vac.isValid())
+        {
+            result.vacsToAdopt.append(vac);
         }
         else
         {
-            vacsWithoutImageFile.append(vac);
+            result.filesToDelete.append(filePath);
         }
     }
+    return result;
+}
 
-    // Delete all VACs without image file
-    bool hasChange = false;
-    foreach(auto vac, vacsWithoutImageFile)
+void GeoMaps::VACLibrary::janitor()
+{
+    // Raster image files managed by the library, with the names of the VACs
+    // that own them
+    QHash<QString, QString> managedFiles;
+    for(const auto& vac : std::as_const(m_vacs))
     {
-        hasChange = true;
-        m_vacs.removeAll(vac);
+        managedFiles.insert(vac.fileName, vac.name);
     }
 
-    // Find list of all image files without VAC
-    QVector<QFileInfo> imageFilesWithoutVAC;
-    QDirIterator fileIterator(m_vacDirectory, QDir::Files);
-    while (fileIterator.hasNext())
+    // Look at the file system in the global thread pool
+    auto* watcher = new QFutureWatcher<JanitorResult>(this);
+    connect(watcher, &QFutureWatcher<JanitorResult>::finished, this, [this, watcher]() {
+        watcher->deleteLater();
+        auto result = watcher->future().result();
+
+        // The library might have changed in the meantime. Act only on VACs and
+        // files whose status is still the same.
+        QSet<QString> managedFileNames;
+        for(const auto& vac : std::as_const(m_vacs))
+        {
+            managedFileNames.insert(vac.fileName);
+            managedFileNames.insert(GeoMaps::VAC::tilesFileNameFor(vac.fileName));
+        }
+
+        bool hasChange = false;
+        for(const auto& name : std::as_const(result.vacsWithoutImageFile))
+        {
+            if (m_vacs.contains(name) && !QFile::exists(m_vacs.value(name).fileName))
+            {
+                take(name);
+                hasChange = true;
+            }
+        }
+        for(const auto& vac : std::as_const(result.vacsToAdopt))
+        {
+            if (managedFileNames.contains(vac.fileName))
+            {
+                continue;
+            }
+            if (m_vacs.contains(vac.name))
+            {
+                QFile::remove(vac.fileName);
+                QFile::remove(GeoMaps::VAC::tilesFileNameFor(vac.fileName));
+                continue;
+            }
+            insert(vac);
+            hasChange = true;
+        }
+        for(const auto& fileName : std::as_const(result.filesToDelete))
+        {
+            if (!managedFileNames.contains(fileName))
+            {
+                QFile::remove(fileName);
+            }
+        }
+
+        if (hasChange)
+        {
+            emit dataChanged();
+        }
+    });
+    watcher->setFuture(QtConcurrent::run(&GeoMaps::VACLibrary::inspect, m_vacDirectory, managedFiles));
+}
+
+void GeoMaps::VACLibrary::load()
+{
+    // Read snapshot
+    if (m_dataFile.open(QIODeviceBase::ReadOnly))
     {
-        fileIterator.next();
-        QFileInfo const fInfo(fileIterator.filePath());
-        if (!imageFilesWithVAC.contains(fInfo))
+        QVector<GeoMaps::VAC> vacs;
+        QDataStream dataStream(&m_dataFile);
+        dataStream >> vacs;
+        for(const auto& vac : std::as_const(vacs))
         {
-            imageFilesWithoutVAC.append(fInfo);
+            m_vacs.insert(vac.name, vac);
         }
     }
+    m_dataFile.close();
 
-    // Go through the list of image files without VAC. Try to import them.
-    // Failing that, delete those files.
-    foreach(auto fInfo, imageFilesWithVAC)
+    // Replay journal. A record that was only partially written is ignored.
+    // Since later records would be appended after it and never be read, the
+    // next save writes a new snapshot instead.
+    QFile journal(m_journalFileName);
+    if (journal.open(QIODeviceBase::ReadOnly))
     {
-        if (importVAC(fInfo.fileName()).isEmpty())
+        QDataStream dataStream(&journal);
+        while (!dataStream.atEnd())
         {
-            hasChange = true;
+            quint8 operation = 0;
+            QString name;
+            GeoMaps::VAC vac;
+            dataStream >> operation >> name;
+            if (operation == journalInsert)
+            {
+                dataStream >> vac;
+            }
+            if (dataStream.status() != QDataStream::Ok)
+            {
+                m_needsSnapshot = true;
+                break;
+            }
+            if (operation == journalInsert)
+            {
+                m_vacs.insert(name, vac);
+            }
+            else
+            {
+                m_vacs.remove(name);
+            }
+            m_journalLength++;
         }
-        QFile::remove(fInfo.fileName());
     }
 
-    if (hasChange)
+    // Tile pyramids are not part of the saved data. Check once which exist.
+    for(auto& vac : m_vacs)
     {
-        emit dataChanged();
+        vac.hasTiles = QFile::exists(GeoMaps::VAC::tilesFileNameFor(vac.fileName));
     }
 }
 
 void GeoMaps::VACLibrary::save()
 {
-    if (m_dataFile.open(QIODeviceBase::WriteOnly))
+    m_saveTimer.stop();
+    if (m_unsavedNames.isEmpty() && !m_needsSnapshot)
     {
-        QDataStream dataStream(&m_dataFile);
-        dataStream << m_vacs;
+        return;
+    }
+
+    // Append changes to the journal, unless the journal has grown so long that
+    // it is cheaper to write a new snapshot
+    if (!m_needsSnapshot && (m_journalLength+m_unsavedNames.size() <= qMax(maxJournalLength, m_vacs.size())))
+    {
+        QFile journal(m_journalFileName);
+        if (journal.open(QIODeviceBase::Append))
+        {
+            QDataStream dataStream(&journal);
+            for(const auto& name : std::as_const(m_unsavedNames))
+            {
+                if (m_vacs.contains(name))
+                {
+                    dataStream << journalInsert << name << m_vacs.value(name);
+                }
+                else
+                {
+                    dataStream << journalRemove << name;
+                }
+                m_journalLength++;
+            }
+            if (dataStream.status() == QDataStream::Ok)
+            {
+                m_unsavedNames.clear();
+                return;
+            }
+        }
+    }
+
+    // Write snapshot and remove journal
+    QSaveFile saveFile(m_dataFile.fileName());
+    if (saveFile.open(QIODeviceBase::WriteOnly))
+    {
+        QDataStream dataStream(&saveFile);
+        dataStream << m_vacs.values();
+        if (saveFile.commit())
+        {
+            QFile::remove(m_journalFileName);
+            m_journalLength = 0;
+            m_unsavedNames.clear();
+            m_needsSnapshot = false;
+        }
     }
-    m_dataFile.close();
 }
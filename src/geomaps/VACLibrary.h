@@ -21,7 +21,12 @@
 #pragma once
 
 #include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QPromise>
+#include <QSet>
 #include <QStandardPaths>
+#include <QTimer>
 
 #include "geomaps/VAC.h"
 
@@ -32,8 +37,7 @@ namespace GeoMaps
 /*! \brief Library of visual approach charts
  *
  * This class collects visual approach charts that the user has installed. The
- * list is automatically loaded on startup, and saved every time that a change
- * is made.
+ * list is automatically loaded on startup, and saved shortly after every change.
  */
 
 class VACLibrary : public QObject
@@ -112,6 +116,17 @@ public:
      */
     [[nodiscard]] Q_INVOKABLE QString importTripKit(const QString& fileName);
 
+    /*! \brief Import trip kit, in the background
+     *
+     *  This method works like importTripKit(), but extracts and converts the
+     *  charts in the global thread pool. Progress is reported by the signal
+     *  importTripKitStatus(). Once the charts have been added to the library,
+     *  the signal importTripKitFinished() is emitted.
+     *
+     *  @param fileName Name of the trip kit file
+     */
+    Q_INVOKABLE void startImportTripKit(const QString& fileName);
+
     /*! \brief Import VAC
      *
      *  This method copies the file 'fileName' to the library directory. It does
@@ -147,7 +162,9 @@ public:
     /*! \brief List of all VACs installed
      *
      * This method returns the list of all installed VACs, sorted by distance to
-     * position (closest waypoints first).
+     * position (closest waypoints first). The ordering is cached and re-used
+     * as long as the library does not change and the position stays within a
+     * cell of about one kilometer.
      *
      * @param position Geographic position used for sorting
      *
@@ -168,20 +185,97 @@ signals:
      */
     void importTripKitStatus(double percent);
 
+    /*! \brief Import started with startImportTripKit() has finished
+     *
+     *  @param errorString A localized error message, or an empty string on
+     *  success
+     */
+    void importTripKitFinished(const QString& errorString);
+
 private:
     Q_DISABLE_COPY_MOVE(VACLibrary)
 
     // This method cleans the VAC directory. It deletes all VAC from m_vacs that
     // have no raster image files. It looks for unmanaged raster image files and
-    // either imports them or deletes them.
+    // either adopts them or deletes them. The file system is inspected in the
+    // global thread pool; the library is updated once that is done.
     void janitor();
 
-    // This method saves m_vacs to m_dataFile.
+    // Findings of the janitor
+    struct JanitorResult
+    {
+        QStringList vacsWithoutImageFile; // Names of VACs
+        QList<GeoMaps::VAC> vacsToAdopt;  // Valid VACs found in unmanaged files
+        QStringList filesToDelete;        // Unmanaged files that are no VACs
+    };
+
+    // Inspects the VAC directory. The argument managedFiles maps the raster
+    // image files of all VACs to their names. This method does not touch the
+    // VACLibrary and can be called from any thread.
+    static JanitorResult inspect(const QString& directory, const QHash<QString, QString>& managedFiles);
+
+    // Reads m_vacs from the snapshot m_dataFile and replays the journal.
+    void load();
+
+    // Saves all changes recorded in m_unsavedNames. Changes are appended to
+    // the journal. If the journal grows too long, or after clear(), a new
+    // snapshot is written and the journal is deleted.
     void save();
 
-    QVector<GeoMaps::VAC> m_vacs;
+    // Adds or replaces a VAC in m_vacs and records the change for save()
+    void insert(const GeoMaps::VAC& vac);
+
+    // Removes a VAC from m_vacs and records the change for save(). Returns
+    // the VAC, or an invalid VAC if the name does not exist.
+    GeoMaps::VAC take(const QString& name);
+
+    // Key of the position cell used to cache vacsByDistance()
+    [[nodiscard]] static qint64 positionCell(const QGeoCoordinate& position);
+
+    // Edge length of the cells used to cache vacsByDistance(), roughly one
+    // kilometer
+    static constexpr double positionCellSizeInDegrees = 0.01;
+
+    // Journal records
+    static constexpr quint8 journalRemove = 0;
+    static constexpr quint8 journalInsert = 1;
+
+    // Lower bound for the number of journal records before a new snapshot is
+    // written. The journal may also grow as long as the library.
+    static constexpr qsizetype maxJournalLength = 64;
+
+    // Result of extracting a trip kit
+    struct TripKitResult
+    {
+        QList<GeoMaps::VAC> vacs;
+        qsizetype numCharts {0};
+        QString error;
+    };
+
+    // Opens the trip kit and extracts all charts to directory, in the global
+    // thread pool. Progress is reported to the promise, if given. This method
+    // does not touch the VACLibrary and can be called from any thread.
+    static TripKitResult extractTripKit(const QString& fileName, const QString& directory, QPromise<TripKitResult>* promise = nullptr);
+
+    // Adds the VACs from a trip kit to the library. Returns a localized error
+    // message, or an empty string on success.
+    QString addTripKitVACs(const QString& fileName, const TripKitResult& result);
+
+    // VACs, by name
+    QMap<QString, GeoMaps::VAC> m_vacs;
     QString m_vacDirectory {QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/VAC"};
+
+    // Persistence
     QFile m_dataFile {QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/VAC.data"};
+    QString m_journalFileName {QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/VAC.journal"};
+    qsizetype m_journalLength {0};     // Number of records in the journal
+    QSet<QString> m_unsavedNames;      // Names of VACs that changed since the last save
+    bool m_needsSnapshot {false};      // Set by clear() and by load() on a torn journal
+    QTimer m_saveTimer;
+
+    // Cache for vacsByDistance(), cleared whenever the library changes
+    QVector<GeoMaps::VAC> m_vacsByDistance;
+    qint64 m_vacsByDistanceCell {0};
 
 };
 
@@ -0,0 +1,231 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QBuffer>
+#include <QFile>
+#include <QLineF>
+#include <QPainter>
+#include <QPolygonF>
+#include <QRandomGenerator>
+#include <QSemaphore>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTransform>
+#include <QtMath>
+#include <cmath>
+
+#include "geomaps/VACTiler.h"
+
+using namespace Qt::Literals::StringLiterals;
+
+
+namespace {
+
+// Edge length of a tile, in pixels
+constexpr int tileSize = 256;
+
+// Free slots for GeoMaps::VACTiler::Job
+QSemaphore jobSlots {GeoMaps::VACTiler::maxConcurrentJobs};
+
+// Web Mercator projection of a coordinate, in units where the whole world
+// covers the unit square
+QPointF mercator(const QGeoCoordinate& coordinate)
+{
+    auto lat = qDegreesToRadians(qBound(-85.0511, coordinate.latitude(), 85.0511));
+    return {(coordinate.longitude()+180.0)/360.0,
+            (1.0-std::log(std::tan(lat)+1.0/std::cos(lat))/M_PI)/2.0};
+}
+
+// Writes one tile pyramid into an open data base. Returns an error message or
+// an empty string on success.
+QString writeTiles(QSqlDatabase& dataBase, const GeoMaps::VAC& vac, const QImage& image)
+{
+    // Corners of the chart, in normalized Web Mercator coordinates
+    const QPolygonF corners {mercator(vac.topLeft), mercator(vac.topRight), mercator(vac.bottomRight), mercator(vac.bottomLeft)};
+    auto width = QLineF(corners[0], corners[1]).length();
+    auto height = QLineF(corners[0], corners[3]).length();
+    if ((width <= 0.0) || (height <= 0.0))
+    {
+        return QObject::tr("Invalid georeferencing data.", "GeoMaps::VACTiler");
+    }
+
+    // Zoom level where one tile pixel roughly matches one image pixel, and zoom
+    // level where the whole chart fits into one tile
+    auto nativeZoom = std::log2(qMax(image.width()/width, image.height()/height)/tileSize);
+    auto maxLevel = qBound(GeoMaps::VACTiler::minZoom, qRound(nativeZoom), GeoMaps::VACTiler::maxZoom);
+    auto minLevel = qBound(GeoMaps::VACTiler::minZoom, qFloor(std::log2(1.0/qMax(width, height))), maxLevel);
+
+    QSqlQuery query(dataBase);
+    if (!query.exec(u"CREATE TABLE metadata (name text, value text);"_s)
+        || !query.exec(u"CREATE TABLE tiles (zoom_level integer, tile_column integer, tile_row integer, tile_data blob);"_s)
+        || !query.exec(u"CREATE UNIQUE INDEX tile_index on tiles (zoom_level, tile_column, tile_row);"_s))
+    {
+        return QObject::tr("Unable to create tables in MBTILES file.", "GeoMaps::VACTiler");
+    }
+
+    const QList<std::pair<QString, QString>> metaData {
+        {u"name"_s, vac.name},
+        {u"type"_s, u"overlay"_s},
+        {u"version"_s, u"1"_s},
+        {u"format"_s, u"webp"_s},
+        {u"minzoom"_s, QString::number(minLevel)},
+        {u"maxzoom"_s, QString::number(maxLevel)}
+    };
+    query.prepare(u"INSERT INTO metadata (name, value) VALUES (?, ?);"_s);
+    for(const auto& [key, value] : metaData)
+    {
+        query.addBindValue(key);
+        query.addBindValue(value);
+        if (!query.exec())
+        {
+            return QObject::tr("Unable to write metadata to MBTILES file.", "GeoMaps::VACTiler");
+        }
+    }
+
+    // Go through the levels, from high to low resolution. Each level is
+    // rendered from a copy of the image that is scaled down from the copy used
+    // for the previous level, so that every level is filtered properly and no
+    // level needs to touch more pixels than necessary.
+    query.prepare(u"INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?);"_s);
+    auto levelImage = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    for(auto zoom = maxLevel; zoom >= minLevel; zoom--)
+    {
+        auto scale = qMin(1.0, std::exp2(zoom-nativeZoom));
+        QSize const targetSize(qMax(1, qRound(image.width()*scale)), qMax(1, qRound(image.height()*scale)));
+        if (targetSize.width() < levelImage.width())
+        {
+            levelImage = levelImage.scaled(targetSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+
+        const double worldSize = tileSize*std::exp2(zoom);
+        QPolygonF quad;
+        for(const auto& corner : corners)
+        {
+            quad << corner*worldSize;
+        }
+        QTransform transform;
+        const QPolygonF imageRect {QPointF(0, 0), QPointF(levelImage.width(), 0), QPointF(levelImage.width(), levelImage.height()), QPointF(0, levelImage.height())};
+        if (!QTransform::quadToQuad(imageRect, quad, transform))
+        {
+            return QObject::tr("Invalid georeferencing data.", "GeoMaps::VACTiler");
+        }
+
+        auto maxTile = (1 << zoom) - 1;
+        auto bounds = quad.boundingRect();
+        auto xMin = qBound(0, qFloor(bounds.left()/tileSize), maxTile);
+        auto xMax = qBound(0, qFloor(bounds.right()/tileSize), maxTile);
+        auto yMin = qBound(0, qFloor(bounds.top()/tileSize), maxTile);
+        auto yMax = qBound(0, qFloor(bounds.bottom()/tileSize), maxTile);
+        for(auto x = xMin; x <= xMax; x++)
+        {
+            for(auto y = yMin; y <= yMax; y++)
+            {
+                // Skip tiles that do not meet the chart. This happens for
+                // charts that are not aligned with the meridians.
+                const QRectF tileRect(x*tileSize, y*tileSize, tileSize, tileSize);
+                if (!quad.intersects(QPolygonF(tileRect)))
+                {
+                    continue;
+                }
+
+                QImage tile(tileSize, tileSize, QImage::Format_ARGB32_Premultiplied);
+                tile.fill(Qt::transparent);
+                QPainter painter(&tile);
+                painter.setRenderHint(QPainter::SmoothPixmapTransform);
+                painter.setTransform(transform*QTransform::fromTranslate(-tileRect.left(), -tileRect.top()));
+                painter.drawImage(0, 0, levelImage);
+                painter.end();
+
+                QByteArray tileData;
+                QBuffer buffer(&tileData);
+                buffer.open(QIODevice::WriteOnly);
+                if (!tile.save(&buffer, "WEBP"))
+                {
+                    return QObject::tr("Unable to encode tile.", "GeoMaps::VACTiler");
+                }
+
+                // MBTILES counts rows from the bottom, following the TMS scheme
+                query.addBindValue(zoom);
+                query.addBindValue(x);
+                query.addBindValue(maxTile-y);
+                query.addBindValue(tileData);
+                if (!query.exec())
+                {
+                    return QObject::tr("Unable to write tile to MBTILES file.", "GeoMaps::VACTiler");
+                }
+            }
+        }
+    }
+    return {};
+}
+
+} // namespace
+
+
+GeoMaps::VACTiler::Job::Job()
+{
+    jobSlots.acquire();
+}
+
+
+GeoMaps::VACTiler::Job::~Job()
+{
+    jobSlots.release();
+}
+
+
+QString GeoMaps::VACTiler::writeMBTILES(const GeoMaps::VAC& vac, const QImage& image, const QString& fileName)
+{
+    if (image.isNull())
+    {
+        return QObject::tr("No raster image data.", "GeoMaps::VACTiler");
+    }
+    QFile::remove(fileName);
+
+    QString result;
+    auto connectionName = u"GeoMaps::VACTiler %1,%2"_s.arg(fileName).arg(QRandomGenerator::global()->generate());
+    {
+        auto dataBase = QSqlDatabase::addDatabase(u"QSQLITE"_s, connectionName);
+        dataBase.setDatabaseName(fileName);
+        if (dataBase.open())
+        {
+            // Write everything in one transaction; SQLite is very slow when
+            // every insert is committed separately.
+            dataBase.transaction();
+            result = writeTiles(dataBase, vac, image);
+            if (result.isEmpty() && !dataBase.commit())
+            {
+                result = QObject::tr("Unable to write MBTILES file.", "GeoMaps::VACTiler");
+            }
+            dataBase.close();
+        }
+        else
+        {
+            result = QObject::tr("Unable to open database connection to MBTILES file.", "GeoMaps::VACTiler");
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    if (!result.isEmpty())
+    {
+        QFile::remove(fileName);
+    }
+    return result;
+}
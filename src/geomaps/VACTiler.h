@@ -0,0 +1,105 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QImage>
+
+#include "geomaps/VAC.h"
+
+
+namespace GeoMaps {
+
+/*! \brief Tile pyramids for visual approach charts
+ *
+ *  This class cuts the raster image of a VAC into a multi-resolution pyramid of
+ *  256x256 WebP tiles in the Web Mercator tiling scheme and stores the tiles in
+ *  an MBTILES file. The map can then show the chart through the TileServer,
+ *  and only the tiles that are visible at the current zoom level need to be
+ *  decoded.
+ *
+ *  The highest zoom level is chosen so that the resolution of the tiles
+ *  roughly matches the resolution of the original image. Each lower level is
+ *  rendered from a copy of the image scaled down by a factor of two.
+ */
+
+class VACTiler
+{
+public:
+    /*! \brief Lowest zoom level that will be generated
+     *
+     *  This matches the minimum zoom level of the moving map.
+     */
+    static constexpr int minZoom = 7;
+
+    /*! \brief Highest zoom level that will be generated
+     *
+     *  This matches the maximum zoom level of the moving map.
+     */
+    static constexpr int maxZoom = 17;
+
+    /*! \brief Number of charts that are decoded and tiled at the same time
+     *
+     *  @see Job
+     */
+    static constexpr int maxConcurrentJobs = 2;
+
+    /*! \brief Slot for decoding and tiling one chart
+     *
+     *  Decoding a chart and cutting it into tiles needs several full-resolution
+     *  RGBA copies of the image. Worker threads construct a Job before decoding
+     *  and keep it until the tiles are written. The constructor blocks while
+     *  maxConcurrentJobs other Jobs exist, so that memory use does not grow with
+     *  the number of threads.
+     */
+    class Job
+    {
+    public:
+        /*! \brief Wait for a free slot */
+        Job();
+
+        /*! \brief Release the slot */
+        ~Job();
+
+    private:
+        Q_DISABLE_COPY_MOVE(Job)
+    };
+
+    /*! \brief Write tile pyramid
+     *
+     *  This method is reentrant and can be called from any thread. Callers on
+     *  worker threads should hold a Job while decoding the image and calling
+     *  this method. Existing
+     *  files of the given name are overwritten. On error, no file is left
+     *  behind.
+     *
+     *  @param vac VAC whose corner coordinates are used for georeferencing
+     *
+     *  @param image Raster image of the VAC
+     *
+     *  @param fileName Name of the MBTILES file that will be written
+     *
+     *  @returns An empty string on success, or a human-readable, translated
+     *  error message otherwise.
+     */
+    [[nodiscard]] static QString writeMBTILES(const GeoMaps::VAC& vac, const QImage& image, const QString& fileName);
+};
+
+} // namespace GeoMaps
@@ -19,9 +19,13 @@
  ***************************************************************************/
 
 #include <QFile>
+#include <QFutureWatcher>
+#include <QPromise>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QXmlStreamWriter>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtMath>
 
 #include "Librarian.h"
 #include "fileFormats/CUP.h"
@@ -31,6 +35,173 @@
 #include "geomaps/GeoJSON.h"
 #include "geomaps/WaypointLibrary.h"
 
+
+namespace {
+
+// Grid over waypoint coordinates, used to find near-duplicates in the sense
+// of GeoMaps::Waypoint::isNear without comparing every pair of waypoints
+class ProximityIndex
+{
+public:
+    void insert(const GeoMaps::Waypoint& waypoint)
+    {
+        if (!waypoint.coordinate().isValid())
+        {
+            return;
+        }
+        m_cells[key(latCell(waypoint), lonCell(waypoint))].append(waypoint);
+    }
+
+    [[nodiscard]] bool hasNear(const GeoMaps::Waypoint& waypoint) const
+    {
+        if (!waypoint.coordinate().isValid())
+        {
+            return false;
+        }
+
+        // Cells are cellSize degrees wide in both directions. Towards the
+        // poles, more cells in east-west direction need to be checked.
+        auto cosLat = qCos(qDegreesToRadians(qMin(90.0, qAbs(waypoint.coordinate().latitude())+cellSize)));
+        auto lonSpan = static_cast<int>(qMin(numLonCells/2.0, qCeil(1.0/qMax(cosLat, 1.0e-3))));
+
+        auto lat = latCell(waypoint);
+        auto lon = lonCell(waypoint);
+        for(auto i = lat-1; i <= lat+1; i++)
+        {
+            for(auto j = lon-lonSpan; j <= lon+lonSpan; j++)
+            {
+                auto cell = m_cells.constFind(key(i, j));
+                if (cell == m_cells.constEnd())
+                {
+                    continue;
+                }
+                for(const auto& other : cell.value())
+                {
+                    if (other.isNear(waypoint))
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    // Cell size in degrees. One degree of latitude is 111km, so cells are
+    // larger than the 2km used by GeoMaps::Waypoint::isNear.
+    static constexpr double cellSize = 0.02;
+    static constexpr int numLonCells = 18000;
+
+    static int latCell(const GeoMaps::Waypoint& waypoint)
+    {
+        return qFloor(waypoint.coordinate().latitude()/cellSize);
+    }
+
+    static int lonCell(const GeoMaps::Waypoint& waypoint)
+    {
+        return qFloor(waypoint.coordinate().longitude()/cellSize);
+    }
+
+    static qint64 key(int lat, int lon)
+    {
+        lon = ((lon % numLonCells) + numLonCells) % numLonCells;
+        return (static_cast<qint64>(lat) << 32) | static_cast<quint32>(lon);
+    }
+
+    QHash<qint64, QList<GeoMaps::Waypoint>> m_cells;
+};
+
+// Reads waypoints from a file in one of the supported formats. Returns an
+// empty list on error.
+QList<GeoMaps::Waypoint> readWaypoints(const QString& fileName)
+{
+    auto result = FileFormats::CUP(fileName).waypoints();
+    if (result.isEmpty())
+    {
+        result = GeoMaps::GeoJSON::read(fileName);
+    }
+    if (result.isEmpty())
+    {
+        result = GeoMaps::GPX::read(fileName);
+    }
+    if (result.isEmpty())
+    {
+        auto pln = FileFormats::PLN(fileName);
+        result.reserve(pln.waypoints().size());
+        for(const auto& coordinate : pln.waypoints())
+        {
+            result += coordinate;
+        }
+    }
+    if (result.isEmpty())
+    {
+        auto fpl = FileFormats::FPL(fileName);
+        result.reserve(fpl.waypoints().size());
+        for(const auto& coordinate : fpl.waypoints())
+        {
+            result += coordinate;
+        }
+    }
+    return result;
+}
+
+// Result of an import running in the global thread pool
+struct ImportResult
+{
+    QList<GeoMaps::Waypoint> waypoints;
+    bool success {false};
+};
+
+// Removes invalid waypoints from newWaypoints. If skip is true, also removes
+// waypoints that are near to an existing waypoint, or near to a waypoint
+// earlier in the list. Progress is reported to the promise, if given.
+QList<GeoMaps::Waypoint> filtered(const QList<GeoMaps::Waypoint>& existingWaypoints, const QList<GeoMaps::Waypoint>& newWaypoints, bool skip, QPromise<ImportResult>* promise = nullptr)
+{
+    QList<GeoMaps::Waypoint> result;
+    result.reserve(newWaypoints.size());
+
+    ProximityIndex index;
+    if (skip)
+    {
+        for(const auto& waypoint : existingWaypoints)
+        {
+            index.insert(waypoint);
+        }
+    }
+
+    if (promise != nullptr)
+    {
+        promise->setProgressRange(0, static_cast<int>(newWaypoints.size()));
+    }
+    for(qsizetype i = 0; i < newWaypoints.size(); i++)
+    {
+        if ((promise != nullptr) && (i % 256 == 0))
+        {
+            promise->setProgressValue(static_cast<int>(i));
+        }
+
+        const auto& waypoint = newWaypoints.at(i);
+        if (!waypoint.isValid())
+        {
+            continue;
+        }
+        if (skip)
+        {
+            if (index.hasNear(waypoint))
+            {
+                continue;
+            }
+            index.insert(waypoint);
+        }
+        result.append(waypoint);
+    }
+    return result;
+}
+
+} // namespace
+
+
 GeoMaps::WaypointLibrary::WaypointLibrary(QObject *parent)
     : GlobalObject(parent)
 {
@@ -83,6 +254,20 @@ void GeoMaps::WaypointLibrary::add(const GeoMaps::Waypoint &waypoint)
     emit waypointsChanged();
 }
 
+void GeoMaps::WaypointLibrary::add(const QList<GeoMaps::Waypoint>& waypoints, bool skip)
+{
+    auto newWaypoints = filtered(m_waypoints, waypoints, skip);
+    if (newWaypoints.isEmpty())
+    {
+        return;
+    }
+
+    m_waypoints += newWaypoints;
+    std::sort(m_waypoints.begin(), m_waypoints.end(), [](const Waypoint &a, const Waypoint &b)
+    { return a.name() < b.name(); });
+    emit waypointsChanged();
+}
+
 void GeoMaps::WaypointLibrary::clear()
 {
     if (m_waypoints.isEmpty())
@@ -169,67 +354,56 @@ auto GeoMaps::WaypointLibrary::loadFromGeoJSON(QString fileName) -> QString
 
 auto GeoMaps::WaypointLibrary::import(const QString& fileName, bool skip) -> QString
 {
-    auto result = FileFormats::CUP(fileName).waypoints();
+    auto result = readWaypoints(fileName);
     if (result.isEmpty())
     {
-        result = GeoMaps::GeoJSON::read(fileName);
-    }
-    if (result.isEmpty())
-    {
-        result = GeoMaps::GPX::read(fileName);
+        return tr("Error reading waypoints from file '%1'.").arg(fileName);
     }
-    if (result.isEmpty())
-    {
-        auto pln = FileFormats::PLN(fileName);
-        result.reserve(pln.waypoints().size());
-        for(const auto& coordinate : pln.waypoints())
+
+    add(result, skip);
+    return {};
+}
+
+void GeoMaps::WaypointLibrary::startImport(const QString& fileName, bool skip)
+{
+    emit importStatus(0.0);
+
+    auto* watcher = new QFutureWatcher<ImportResult>(this);
+    connect(watcher, &QFutureWatcher<ImportResult>::progressValueChanged, this, [this, watcher](int progressValue) {
+        auto maximum = watcher->progressMaximum();
+        if (maximum > 0)
         {
-            result += coordinate;
+            emit importStatus(qMin(0.99, static_cast<double>(progressValue)/maximum));
         }
-    }
-    if (result.isEmpty())
-    {
-        auto fpl = FileFormats::FPL(fileName);
-        result.reserve(fpl.waypoints().size());
-        for(const auto& coordinate : fpl.waypoints())
+    });
+    connect(watcher, &QFutureWatcher<ImportResult>::finished, this, [this, watcher, fileName, skip]() {
+        watcher->deleteLater();
+        emit importStatus(1.0);
+
+        auto result = watcher->future().result();
+        if (!result.success)
         {
-            result += coordinate;
+            emit importFinished(tr("Error reading waypoints from file '%1'.").arg(fileName));
+            return;
         }
-    }
-    if (result.isEmpty())
-    {
-        return tr("Error reading waypoints from file '%1'.").arg(fileName);
-    }
 
-    if (skip)
-    {
-        foreach(const auto& newWaypoint, result)
+        // The library might have changed while the import was running. Adding
+        // the waypoints checks for nearby entries once more, which is cheap.
+        add(result.waypoints, skip);
+        emit importFinished({});
+    });
+
+    auto existingWaypoints = m_waypoints;
+    watcher->setFuture(QtConcurrent::run([fileName, skip, existingWaypoints](QPromise<ImportResult>& promise) {
+        ImportResult result;
+        auto newWaypoints = readWaypoints(fileName);
+        if (!newWaypoints.isEmpty())
         {
-            bool skip = false;
-            foreach(const auto& existingWaypoint, m_waypoints)
-            {
-                if (newWaypoint.isNear(existingWaypoint))
-                {
-                    skip = true;
-                    break;
-                }
-            }
-            if (!skip)
-            {
-                m_waypoints.append(newWaypoint);
-            }
+            result.waypoints = filtered(existingWaypoints, newWaypoints, skip, &promise);
+            result.success = true;
         }
-    }
-    else
-    {
-        m_waypoints += result;
-    }
-
-    std::sort(m_waypoints.begin(), m_waypoints.end(), [](const Waypoint &a, const Waypoint &b)
-    { return a.name() < b.name(); });
-
-    emit waypointsChanged();
-    return {};
+        promise.addResult(result);
+    }));
 }
 
 bool GeoMaps::WaypointLibrary::remove(const GeoMaps::Waypoint &waypoint)
@@ -113,6 +113,22 @@ namespace GeoMaps
          */
         Q_INVOKABLE void add(const GeoMaps::Waypoint &waypoint);
 
+        /*! \brief Adds a list of waypoints to the library
+         *
+         *  This method adds all waypoints in one transaction. The library is
+         *  sorted once, and waypointsChanged() is emitted once, so that the
+         *  library is saved only once.  Near-duplicates are found with a
+         *  spatial grid, so that large lists can be added quickly.
+         *
+         *  @param waypoints Waypoints to be added. Invalid waypoints are
+         *  ignored.
+         *
+         *  @param skip If true, skip over waypoints that are near to waypoints
+         *  in the library, in the sense of GeoMaps::Waypoint::isNear, or near to
+         *  waypoints earlier in the list
+         */
+        void add(const QList<GeoMaps::Waypoint>& waypoints, bool skip);
+
         /*! \brief Clears the waypoint library */
         Q_INVOKABLE void clear();
 
@@ -161,6 +177,19 @@ namespace GeoMaps
          */
         [[nodiscard]] Q_INVOKABLE QString import(const QString& fileName, bool skip);
 
+        /*! \brief Import waypoints into the library, in the background
+         *
+         *  This method works like import(), but reads the file and checks for
+         *  existing waypoints in the global thread pool. Progress is reported
+         *  by the signal importStatus(). Once the waypoints have been added to
+         *  the library, the signal importFinished() is emitted.
+         *
+         *  @param fileName Name of file to import. Must be in CUP, GPX or GeoJSON format.
+         *
+         *  @param skip If true, skip over waypoints that already exist in the library
+         */
+        Q_INVOKABLE void startImport(const QString& fileName, bool skip);
+
         /*! \brief Read from file
          *
          * Reads the library from a file in GeoJSON format. On sucess, the
@@ -229,6 +258,20 @@ namespace GeoMaps
         /*! \brief Notification signal for the property with the same name */
         void waypointsChanged();
 
+        /*! \brief Progress of an import started with startImport()
+         *
+         *  @param percent A number between 0.0 and 1.0. The number 1.0 is
+         *  reported once the import has finished.
+         */
+        void importStatus(double percent);
+
+        /*! \brief Import started with startImport() has finished
+         *
+         *  @param errorString Human-readable error message, or an empty string
+         *  on success
+         */
+        void importFinished(const QString& errorString);
+
     private:
         Q_DISABLE_COPY_MOVE(WaypointLibrary)
 
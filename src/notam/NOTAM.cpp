@@ -18,9 +18,13 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QCache>
 #include <QJsonArray>
 #include <QJsonObject>
 
+#include <algorithm>
+#include <array>
+
 #include "GlobalObject.h"
 #include "GlobalSettings.h"
 #include "notam/NOTAM.h"
@@ -37,73 +41,158 @@ namespace {
 // In cancel notams the text starts as "A0029/23 NOTAMC A0027/23"
 Q_GLOBAL_STATIC(QRegularExpression, cancelNotamStart, u"^[A-Z]\\d{4}/\\d{2} NOTAMC [A-Z]\\d{4}/\\d{2}"_s)
 
-// Necessary because Q_GLOBAL_STATIC does not like templates
-using ContractionList = QList<std::pair<QRegularExpression, QString>>;
-Q_GLOBAL_STATIC(ContractionList,
-                contractions,
-                {
-                    {QRegularExpression(u"\\bU/S\\b"_s), u"UNSERVICEABLE"_s}, // MUST COME BEFORE SOUTH
-
-                    {QRegularExpression(u"\\bACFT\\b"_s), u"AIRCRAFT"_s},
-                    {QRegularExpression(u"\\bAD\\b"_s), u"AERODROME"_s},
-                    {QRegularExpression(u"\\bAFIS\\b"_s), u"AERODROME FLIGHT INFORMATION SERVICE"_s},
-                    {QRegularExpression(u"\\bAFT\\b"_s), u"AFTER"_s},
-                    {QRegularExpression(u"\\bAMDT\\b"_s), u"AMENDMENT"_s},
-                    {QRegularExpression(u"\\bAPCH\\b"_s), u"APPROACH"_s},
-                    {QRegularExpression(u"\\bAPRX\\b"_s), u"APPROXIMATELY"_s},
-                    {QRegularExpression(u"\\bARP\\b"_s), u"AERODROME REFERENCE POINT"_s},
-                    {QRegularExpression(u"\\bARR\\b"_s), u"ARRIVAL"_s},
-                    {QRegularExpression(u"\\bASPH\\b"_s), u"ASPHALT"_s},
-                    {QRegularExpression(u"\\bAVBL\\b"_s), u"AVAILABLE"_s},
-                    {QRegularExpression(u"\\bBCST\\b"_s), u"BROADCAST"_s},
-                    {QRegularExpression(u"\\bBFR\\b"_s), u"BEFORE"_s},
-                    {QRegularExpression(u"\\bBLW\\b"_s), u"BELOW"_s},
-                    {QRegularExpression(u"\\bBTN\\b"_s), u"BETWEEN"_s},
-                    {QRegularExpression(u"\\bCLBR\\b"_s), u"CALLIBRATION"_s},
-                    {QRegularExpression(u"\\bCLSD\\b"_s), u"CLOSED"_s},
-                    {QRegularExpression(u"\\bCNL\\b"_s), u"CANCEL"_s},
-                    {QRegularExpression(u"\\bCTN\\b"_s), u"CAUTION"_s},
-                    {QRegularExpression(u"\\bDEP\\b"_s), u"DEPARTURE"_s},
-                    {QRegularExpression(u"\\bDRG\\b"_s), u"DURING"_s},
-                    {QRegularExpression(u"\\bELEV\\b"_s), u"ELEVATION"_s},
-                    {QRegularExpression(u"\\bEQPT\\b"_s), u"EQUIPMENT"_s},
-                    {QRegularExpression(u"\\bEXC\\b"_s), u"EXCEPTED"_s},
-                    {QRegularExpression(u"\\bEXP\\b"_s), u"EXPECT"_s},
-                    {QRegularExpression(u"\\bFATO\\b"_s), u"FINAL APPROACH AND TAKEOFF AREA"_s},
-                    {QRegularExpression(u"\\bFST\\b"_s), u"FIRST"_s},
-                    {QRegularExpression(u"\\bFLT\\b"_s), u"FLIGHT"_s},
-                    {QRegularExpression(u"\\bFLW\\b"_s), u"FOLLOW"_s},
-                    {QRegularExpression(u"\\bGLD\\b"_s), u"GLIDER"_s},
-                    {QRegularExpression(u"\\bHEL\\b"_s), u"HELICOPTER"_s},
-                    {QRegularExpression(u"\\bLGT\\b"_s), u"LIGHT"_s},
-                    {QRegularExpression(u"\\bLGTD\\b"_s), u"LIGHTED"_s},
-                    {QRegularExpression(u"\\bLTD\\b"_s), u"LIMITED"_s},
-                    {QRegularExpression(u"\\bMAINT\\b"_s), u"MAINTENANCE"_s},
-                    {QRegularExpression(u"\\bMIL\\b"_s), u"MILITARY"_s},
-                    {QRegularExpression(u"\\bN\\b"_s), u"NORTH"_s},
-                    {QRegularExpression(u"\\bNE\\b"_s), u"NORTHEAST"_s},
-                    {QRegularExpression(u"\\bNW\\b"_s), u"NORTHWEST"_s},
-                    {QRegularExpression(u"\\bO/R\\b"_s), u"AVAILABLE ON REQUEST"_s},
-                    {QRegularExpression(u"\\bOBST\\b"_s), u"OBSTACLE"_s},
-                    {QRegularExpression(u"\\bPOSS\\b"_s), u"POSSIBLE"_s},
-                    {QRegularExpression(u"\\bPSN\\b"_s), u"POSITION"_s},
-                    {QRegularExpression(u"\\bPRKG\\b"_s), u"PARKING"_s},
-                    {QRegularExpression(u"\\bRTE\\b"_s), u"ROUTE"_s},
-                    {QRegularExpression(u"\\bRVR\\b"_s), u"RUNWAY VISUAL RANGE"_s},
-                    {QRegularExpression(u"\\bRWY\\b"_s), u"RUNWAY"_s},
-                    {QRegularExpression(u"\\bS\\b"_s), u"SOUTH"_s},
-                    {QRegularExpression(u"\\bSE\\b"_s), u"SOUTHEAST"_s},
-                    {QRegularExpression(u"\\bSKED\\b"_s), u"SCHEDULED"_s},
-                    {QRegularExpression(u"\\bSW\\b"_s), u"SOUTHWEST"_s},
-                    {QRegularExpression(u"\\bTFC\\b"_s), u"TRAFFIC"_s},
-                    {QRegularExpression(u"\\bTHR\\b"_s), u"THRESHOLD"_s},
-                    {QRegularExpression(u"\\bTWR\\b"_s), u"TOWER"_s},
-                    {QRegularExpression(u"\\bTWY\\b"_s), u"TAXIWAY"_s},
-                    {QRegularExpression(u"\\bW\\b"_s), u"WEST"_s},
-                    {QRegularExpression(u"\\bWDI\\b"_s), u"WIND DIRECTION INDICATOR"_s},
-                    {QRegularExpression(u"\\bWI\\b"_s), u"WITHIN"_s},
-                    {QRegularExpression(u"\\bWIP\\b"_s), u"WORK IN PROGRESS"_s},
-                })
+// Contractions and their expansions. The list must be sorted by
+// contraction, so that it can be searched by binary search.
+struct Contraction
+{
+    QStringView contraction;
+    QStringView expansion;
+};
+constexpr std::array<Contraction, 60> contractions {{
+    {u"ACFT",  u"AIRCRAFT"},
+    {u"AD",    u"AERODROME"},
+    {u"AFIS",  u"AERODROME FLIGHT INFORMATION SERVICE"},
+    {u"AFT",   u"AFTER"},
+    {u"AMDT",  u"AMENDMENT"},
+    {u"APCH",  u"APPROACH"},
+    {u"APRX",  u"APPROXIMATELY"},
+    {u"ARP",   u"AERODROME REFERENCE POINT"},
+    {u"ARR",   u"ARRIVAL"},
+    {u"ASPH",  u"ASPHALT"},
+    {u"AVBL",  u"AVAILABLE"},
+    {u"BCST",  u"BROADCAST"},
+    {u"BFR",   u"BEFORE"},
+    {u"BLW",   u"BELOW"},
+    {u"BTN",   u"BETWEEN"},
+    {u"CLBR",  u"CALLIBRATION"},
+    {u"CLSD",  u"CLOSED"},
+    {u"CNL",   u"CANCEL"},
+    {u"CTN",   u"CAUTION"},
+    {u"DEP",   u"DEPARTURE"},
+    {u"DRG",   u"DURING"},
+    {u"ELEV",  u"ELEVATION"},
+    {u"EQPT",  u"EQUIPMENT"},
+    {u"EXC",   u"EXCEPTED"},
+    {u"EXP",   u"EXPECT"},
+    {u"FATO",  u"FINAL APPROACH AND TAKEOFF AREA"},
+    {u"FLT",   u"FLIGHT"},
+    {u"FLW",   u"FOLLOW"},
+    {u"FST",   u"FIRST"},
+    {u"GLD",   u"GLIDER"},
+    {u"HEL",   u"HELICOPTER"},
+    {u"LGT",   u"LIGHT"},
+    {u"LGTD",  u"LIGHTED"},
+    {u"LTD",   u"LIMITED"},
+    {u"MAINT", u"MAINTENANCE"},
+    {u"MIL",   u"MILITARY"},
+    {u"N",     u"NORTH"},
+    {u"NE",    u"NORTHEAST"},
+    {u"NW",    u"NORTHWEST"},
+    {u"O/R",   u"AVAILABLE ON REQUEST"},
+    {u"OBST",  u"OBSTACLE"},
+    {u"POSS",  u"POSSIBLE"},
+    {u"PRKG",  u"PARKING"},
+    {u"PSN",   u"POSITION"},
+    {u"RTE",   u"ROUTE"},
+    {u"RVR",   u"RUNWAY VISUAL RANGE"},
+    {u"RWY",   u"RUNWAY"},
+    {u"S",     u"SOUTH"},
+    {u"SE",    u"SOUTHEAST"},
+    {u"SKED",  u"SCHEDULED"},
+    {u"SW",    u"SOUTHWEST"},
+    {u"TFC",   u"TRAFFIC"},
+    {u"THR",   u"THRESHOLD"},
+    {u"TWR",   u"TOWER"},
+    {u"TWY",   u"TAXIWAY"},
+    {u"U/S",   u"UNSERVICEABLE"},
+    {u"W",     u"WEST"},
+    {u"WDI",   u"WIND DIRECTION INDICATOR"},
+    {u"WI",    u"WITHIN"},
+    {u"WIP",   u"WORK IN PROGRESS"},
+}};
+
+// Expanded NOTAM texts, keyed by the original text
+using ExpansionCache = QCache<QString, QString>;
+Q_GLOBAL_STATIC(ExpansionCache, expansionCache, 1000)
+
+// Returns the expansion of a contraction, or a null QStringView if the word is
+// not a contraction
+QStringView expansion(QStringView word)
+{
+    auto iterator = std::lower_bound(contractions.cbegin(), contractions.cend(), word,
+                                     [](const Contraction& entry, QStringView value) { return entry.contraction < value; });
+    if ((iterator != contractions.cend()) && (iterator->contraction == word))
+    {
+        return iterator->expansion;
+    }
+    return {};
+}
+
+// Characters that make up words, in the sense of "\b" in regular expressions
+bool isWordCharacter(QChar character)
+{
+    return character.isLetterOrNumber() || (character == u'_');
+}
+
+// Expands all contractions in the text, in one pass over the text. Results
+// are cached.
+QString expandContractions(const QString& text)
+{
+    if (auto* cached = expansionCache->object(text))
+    {
+        return *cached;
+    }
+
+    const QStringView view(text);
+    const auto size = view.size();
+    QString result;
+    result.reserve(size + size/2);
+
+    qsizetype index = 0;
+    while (index < size)
+    {
+        if (!isWordCharacter(view[index]))
+        {
+            result += view[index];
+            index++;
+            continue;
+        }
+
+        auto wordEnd = index;
+        while ((wordEnd < size) && isWordCharacter(view[wordEnd]))
+        {
+            wordEnd++;
+        }
+
+        // Contractions such as "U/S" consist of two words, separated by a
+        // slash. They are checked first, so that "U/S" is expanded to
+        // "UNSERVICEABLE" and not to "U/SOUTH".
+        if ((wordEnd+1 < size) && (view[wordEnd] == u'/') && isWordCharacter(view[wordEnd+1]))
+        {
+            auto secondWordEnd = wordEnd+1;
+            while ((secondWordEnd < size) && isWordCharacter(view[secondWordEnd]))
+            {
+                secondWordEnd++;
+            }
+            auto exp = expansion(view.sliced(index, secondWordEnd-index));
+            if (!exp.isNull())
+            {
+                result += exp;
+                index = secondWordEnd;
+                continue;
+            }
+        }
+
+        auto word = view.sliced(index, wordEnd-index);
+        auto exp = expansion(word);
+        result += exp.isNull() ? word : exp;
+        index = wordEnd;
+    }
+
+    expansionCache->insert(text, new QString(result));
+    return result;
+}
+
 } // namespace
 
 
@@ -264,13 +353,7 @@ QString NOTAM::NOTAM::richText() const
 
     if (GlobalObject::globalSettings()->expandNotamAbbreviations())
     {
-        QString tmp = m_text;
-        foreach(auto contraction, *contractions)
-        {
-            tmp.replace(contraction.first, contraction.second);
-        }
-
-        result += tmp;
+        result += expandContractions(m_text);
     }
     else
     {
@@ -21,6 +21,7 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QtGlobal>
+#include <QtMath>
 
 #include "notam/NOTAMList.h"
 #include "notam/NOTAMProvider.h"
@@ -76,6 +77,7 @@ NOTAM::NOTAMList::NOTAMList(const QJsonDocument& jsonDoc, const QGeoCircle& regi
 
     m_retrieved = QDateTime::currentDateTimeUtc();
     m_region = region;
+    rebuildSpatialIndex();
 }
 
 
@@ -127,8 +129,10 @@ NOTAM::NOTAMList NOTAM::NOTAMList::cleaned(const QSet<QString>& cancelledNotamNu
     NOTAMList result;
     result.m_region = m_region;
     result.m_retrieved = m_retrieved;
+    result.m_notams.reserve(m_notams.size());
 
-    foreach(auto notam, m_notams)
+    QSet<QString> numbersSeen;
+    for(const auto& notam : m_notams)
     {
         if (!notam.isValid())
         {
@@ -142,12 +146,14 @@ NOTAM::NOTAMList NOTAM::NOTAMList::cleaned(const QSet<QString>& cancelledNotamNu
         {
             continue;
         }
-        if (result.m_notams.contains(notam))
+        if (numbersSeen.contains(notam.number()))
         {
             continue;
         }
+        numbersSeen += notam.number();
         result.m_notams.append(notam);
     }
+    result.rebuildSpatialIndex();
 
     return result;
 }
@@ -161,8 +167,30 @@ NOTAM::NOTAMList NOTAM::NOTAMList::restricted(const GeoMaps::Waypoint& waypoint)
 
     result.m_region = QGeoCircle(waypoint.coordinate(), radius);
 
-    foreach(auto notam, m_notams)
+    // Find the grid cells that might contain NOTAMs within restrictionRadius
+    // of the waypoint
+    const auto coordinate = waypoint.coordinate();
+    const auto latSpan = restrictionRadius.toM()/111000.0;
+    const auto lonSpan = qMin(180.0, latSpan/qMax(0.01, qCos(qDegreesToRadians(qMin(89.0, qAbs(coordinate.latitude())+latSpan)))));
+    const auto minLatCell = qFloor((coordinate.latitude()-latSpan)/spatialIndexCellSize);
+    const auto maxLatCell = qFloor((coordinate.latitude()+latSpan)/spatialIndexCellSize);
+    const auto minLonCell = qFloor((coordinate.longitude()-lonSpan)/spatialIndexCellSize);
+    const auto maxLonCell = qFloor((coordinate.longitude()+lonSpan)/spatialIndexCellSize);
+
+    QList<qsizetype> candidates;
+    for(auto latCell = minLatCell; latCell <= maxLatCell; latCell++)
+    {
+        for(auto lonCell = minLonCell; lonCell <= maxLonCell; lonCell++)
+        {
+            candidates += m_spatialIndex.value(spatialIndexKey(latCell, lonCell));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    QSet<QString> numbersSeen;
+    for(auto index : std::as_const(candidates))
     {
+        auto notam = m_notams.at(index);
         if (!notam.isValid())
         {
             continue;
@@ -171,18 +199,19 @@ NOTAM::NOTAMList NOTAM::NOTAMList::restricted(const GeoMaps::Waypoint& waypoint)
         {
             continue;
         }
-        if (notam.coordinate().distanceTo(waypoint.coordinate()) > restrictionRadius.toM())
+        if (notam.coordinate().distanceTo(coordinate) > restrictionRadius.toM())
         {
             continue;
         }
-        if (result.m_notams.contains(notam))
+        if (numbersSeen.contains(notam.number()))
         {
             continue;
         }
-        if (!notam.region().contains(waypoint.coordinate()))
+        if (!notam.region().contains(coordinate))
         {
             continue;
         }
+        numbersSeen += notam.number();
         notam.updateSectionTitle();
         result.m_notams.append(notam);
     }
@@ -207,11 +236,37 @@ NOTAM::NOTAMList NOTAM::NOTAMList::restricted(const GeoMaps::Waypoint& waypoint)
         }
         return first.effectiveEnd() < second.effectiveEnd();
     });
+    result.rebuildSpatialIndex();
 
     return result;
 }
 
 
+void NOTAM::NOTAMList::rebuildSpatialIndex()
+{
+    m_spatialIndex.clear();
+    for(qsizetype i = 0; i < m_notams.size(); i++)
+    {
+        auto coordinate = m_notams.at(i).coordinate();
+        if (!coordinate.isValid())
+        {
+            continue;
+        }
+        auto key = spatialIndexKey(qFloor(coordinate.latitude()/spatialIndexCellSize), qFloor(coordinate.longitude()/spatialIndexCellSize));
+        m_spatialIndex[key].append(i);
+    }
+}
+
+
+qint32 NOTAM::NOTAMList::spatialIndexKey(qint32 latCell, qint32 lonCell)
+{
+    // Wrap longitude cells around the antimeridian
+    const auto numLonCells = qRound(360.0/spatialIndexCellSize);
+    lonCell = ((lonCell % numLonCells) + numLonCells) % numLonCells;
+    return latCell*numLonCells + lonCell;
+}
+
+
 
 //
 // Non-Member Methods
@@ -232,6 +287,7 @@ QDataStream& NOTAM::operator>>(QDataStream& stream, NOTAMList& notamList)
     stream >> notamList.m_notams;
     stream >> notamList.m_region;
     stream >> notamList.m_retrieved;
+    notamList.rebuildSpatialIndex();
 
     return stream;
 }
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <QHash>
 #include <QQmlEngine>
 
 #include "geomaps/Waypoint.h"
@@ -184,9 +185,27 @@ public:
     static constexpr Units::Distance restrictionRadius = Units::Distance::fromNM(20.0);
 
 private:
+    /* Rebuilds m_spatialIndex from m_notams. This method must be called
+     * whenever m_notams changes.
+     */
+    void rebuildSpatialIndex();
+
+    /* Key of a grid cell in m_spatialIndex. Grid cells are squares of
+     * spatialIndexCellSize degrees, numbered by latitude and longitude.
+     */
+    static qint32 spatialIndexKey(qint32 latCell, qint32 lonCell);
+
+    /* Size of grid cells in m_spatialIndex, in degrees */
+    static constexpr double spatialIndexCellSize = 0.5;
+
     /* List of Notams */
     QList<NOTAM> m_notams;
 
+    /* Grid index over the coordinates of the NOTAMs in m_notams. Maps grid
+     * cells to indices in m_notams.
+     */
+    QHash<qint32, QList<qsizetype>> m_spatialIndex;
+
     /* Region */
     QGeoCircle m_region;
 
@@ -18,10 +18,17 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
 #include <QJsonArray>
+#include <QSaveFile>
 #include <QTimer>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
 #include <chrono>
+#include <optional>
 
 #include "config.h"
 #include "navigation/Navigator.h"
@@ -32,6 +39,121 @@ using namespace std::chrono_literals;
 using namespace Qt::Literals::StringLiterals;
 
 
+namespace {
+
+// Data read from a finished network reply, and the result of decoding it.
+// Decoding runs in the global thread pool.
+struct DecodedReply
+{
+    QByteArray data;
+    QGeoCircle region;
+    NOTAM::NOTAMList notamList;
+    QSet<QString> cancelledNotams;
+    bool valid {false};
+};
+
+DecodedReply decodeReply(const DecodedReply& reply)
+{
+    DecodedReply result;
+    result.region = reply.region;
+
+    auto jsonDoc = QJsonDocument::fromJson(reply.data);
+    if (jsonDoc.isNull())
+    {
+        return result;
+    }
+    NOTAM::NOTAMList const notamList(jsonDoc, reply.region, &result.cancelledNotams);
+    result.notamList = notamList.cleaned(result.cancelledNotams);
+    result.valid = true;
+    return result;
+}
+
+// Magic number and version of the NOTAM store files. The version must be
+// increased whenever the serialization of NOTAM or NOTAMList changes.
+constexpr quint32 storeMagic = 0x4E4F544D;
+constexpr quint32 storeVersion = 1;
+
+// File name of the segment that holds NOTAM data for a region
+QString segmentFileName(const QString& directory, const QGeoCircle& region)
+{
+    return u"%1/%2_%3_%4.dat"_s
+        .arg(directory)
+        .arg(region.center().latitude())
+        .arg(region.center().longitude())
+        .arg(qRound(region.radius()));
+}
+
+// Changes to the NOTAM store, computed on the GUI thread and written in the
+// global thread pool
+struct StoreUpdate
+{
+    QString directory;
+    std::optional<QList<QString>> readNotamNumbers;
+    QList<NOTAM::NOTAMList> segments;
+    QStringList removedSegments;
+};
+
+// Writes one store file, consisting of header and payload
+template<typename T>
+void writeStoreFile(const QString& fileName, const T& payload)
+{
+    auto outputFile = QSaveFile(fileName);
+    if (!outputFile.open(QIODevice::WriteOnly))
+    {
+        return;
+    }
+    QDataStream outputStream(&outputFile);
+    outputStream.setVersion(QDataStream::Qt_6_0);
+    outputStream << storeMagic << storeVersion;
+    outputStream << payload;
+    outputFile.commit();
+}
+
+// Reads one store file. Returns false if the file cannot be read or has a
+// different version.
+template<typename T>
+bool readStoreFile(const QString& fileName, T& payload)
+{
+    auto inputFile = QFile(fileName);
+    if (!inputFile.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    QDataStream inputStream(&inputFile);
+    inputStream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    inputStream >> magic >> version;
+    if ((magic != storeMagic) || (version != storeVersion))
+    {
+        return false;
+    }
+    inputStream >> payload;
+    return inputStream.status() == QDataStream::Ok;
+}
+
+// Applies a StoreUpdate. This method is called from a worker thread and must
+// not touch the NOTAMProvider.
+void writeStore(const StoreUpdate& update)
+{
+    QDir().mkpath(update.directory);
+    if (update.readNotamNumbers.has_value())
+    {
+        writeStoreFile(update.directory+u"/read.dat"_s, update.readNotamNumbers.value());
+    }
+    for(const auto& notamList : update.segments)
+    {
+        writeStoreFile(segmentFileName(update.directory, notamList.region()), notamList);
+    }
+    for(const auto& fileName : update.removedSegments)
+    {
+        QFile::remove(fileName);
+    }
+}
+
+} // namespace
+
+
 //
 // Constructor/Destructor
 //
@@ -39,26 +161,64 @@ using namespace Qt::Literals::StringLiterals;
 NOTAM::NOTAMProvider::NOTAMProvider(QObject* parent) :
     GlobalObject(parent)
 {
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(2s);
+    connect(&m_saveTimer, &QTimer::timeout, this, [this]() {save();});
 }
 
 void NOTAM::NOTAMProvider::deferredInitialization()
 {
-    // Load NOTAM data from file in stdFileName, then clean the data (which potentially triggers save()).
+    // Load NOTAM data from the store in m_storeDirectory, then clean the data
+    // (which potentially triggers save()).
     QList<NOTAMList> newNotamLists;
-    auto inputFile = QFile(m_stdFileName);
-    if (inputFile.open(QIODevice::ReadOnly))
+    readStoreFile(m_storeDirectory+u"/read.dat"_s, m_readNotamNumbers);
+    const auto segmentFiles = QDir(m_storeDirectory).entryInfoList({u"*_*_*.dat"_s}, QDir::Files);
+    for(const auto& segmentFile : segmentFiles)
+    {
+        NOTAMList notamList;
+        if (!readStoreFile(segmentFile.absoluteFilePath(), notamList))
+        {
+            QFile::remove(segmentFile.absoluteFilePath());
+            continue;
+        }
+        auto fileName = segmentFileName(m_storeDirectory, notamList.region());
+        if (QFileInfo(fileName).fileName() != segmentFile.fileName())
+        {
+            QFile::remove(segmentFile.absoluteFilePath());
+            continue;
+        }
+        m_savedSegments[fileName] = {notamList.retrieved(), notamList.notams().size()};
+        newNotamLists.append(notamList);
+    }
+    m_readNotamNumbersDirty = false;
+
+    // Migrate data from the file format used by earlier versions, which was
+    // only valid for one build
+    auto legacyFile = QFile(m_legacyFileName);
+    if (legacyFile.open(QIODevice::ReadOnly))
     {
-        QDataStream inputStream(&inputFile);
+        QDataStream inputStream(&legacyFile);
         QString magicString;
         inputStream >> magicString;
-        if (magicString == QStringLiteral(GIT_COMMIT))
+        if (newNotamLists.isEmpty() && (magicString == QStringLiteral(GIT_COMMIT)))
         {
             inputStream >> m_readNotamNumbers;
             inputStream >> newNotamLists;
+            m_readNotamNumbersDirty = true;
         }
+        legacyFile.close();
+        legacyFile.remove();
     }
+
+    // Newest lists come first
+    std::sort(newNotamLists.begin(), newNotamLists.end(), [](const NOTAMList& first, const NOTAMList& second) {
+        return first.retrieved() > second.retrieved();
+    });
     m_notamLists = cleaned(newNotamLists);
 
+    // Remove segments that were cleaned away, write migrated data
+    m_saveTimer.start();
+
     // Wire up updateData. Check NOTAM database after start, and whenever the flight route changes.
     QTimer::singleShot(0, this, &NOTAMProvider::updateData);
     connect(navigator()->flightRoute(), &Navigation::FlightRoute::waypointsChanged, this, &NOTAMProvider::updateData);
@@ -81,7 +241,9 @@ void NOTAM::NOTAMProvider::deferredInitialization()
 
     // Setup Notifiers
     // -- Save the NOTAM data every time that the database changes
-    m_saveNotifier = m_notamLists.addNotifier([this]() {save();});
+    m_saveNotifier = m_notamLists.addNotifier([this]() {m_saveTimer.start();});
+    // -- Restricted lists are computed from m_notamLists, drop them on change
+    m_restrictedCacheNotifier = m_notamLists.addNotifier([this]() {m_restrictedCache.clear();});
 }
 
 NOTAM::NOTAMProvider::~NOTAMProvider()
@@ -97,6 +259,14 @@ NOTAM::NOTAMProvider::~NOTAMProvider()
         delete networkReply;
     }
     m_networkReplies.clear();
+
+    // Write pending changes to disk before the data goes away
+    if (m_saveTimer.isActive())
+    {
+        m_saveTimer.stop();
+        save(true);
+    }
+    m_saveFuture.waitForFinished();
 }
 
 
@@ -129,7 +299,24 @@ NOTAM::NOTAMList NOTAM::NOTAMProvider::notams(const GeoMaps::Waypoint& waypoint)
             {
                 startRequest(waypoint.coordinate());
             }
-            return notamList.restricted(waypoint);
+
+            // The sort order and section titles of restricted lists depend on
+            // the current time, so cached entries are kept only for a short
+            // while.
+            auto now = QDateTime::currentDateTimeUtc();
+            if (!m_restrictedCacheTime.isValid() || (m_restrictedCacheTime.secsTo(now) > restrictedCacheLifetimeInS))
+            {
+                m_restrictedCache.clear();
+                m_restrictedCacheTime = now;
+            }
+            auto cached = m_restrictedCache.constFind(waypoint.coordinate());
+            if (cached != m_restrictedCache.constEnd())
+            {
+                return cached.value();
+            }
+            auto result = notamList.restricted(waypoint);
+            m_restrictedCache.insert(waypoint.coordinate(), result);
+            return result;
         }
     }
 
@@ -156,6 +343,13 @@ NOTAM::NOTAMList NOTAM::NOTAMProvider::notams(const GeoMaps::Waypoint& waypoint)
             return {};
         }
     }
+    for(const auto& area : m_decodingRegions)
+    {
+        if (area.contains(waypoint.coordinate()))
+        {
+            return {};
+        }
+    }
 
     // We have no data for the waypoint and no pending internet requests. So,
     // start a new internet request and return an empty list.
@@ -177,7 +371,9 @@ void NOTAM::NOTAMProvider::setRead(const QString& number, bool read)
     {
         m_readNotamNumbers.removeAll(number);
     }
-    save();
+    m_restrictedCache.clear();
+    m_readNotamNumbersDirty = true;
+    m_saveTimer.start();
 }
 
 
@@ -217,11 +413,11 @@ QList<NOTAM::NOTAMList> NOTAM::NOTAMProvider::cleaned(const QList<NOTAMList>& no
 
 void NOTAM::NOTAMProvider::downloadFinished()
 {
-    auto newNotamList = m_notamLists.value();
-    QSet<QString> cancelledNotams;
-
+    // Collect data from finished replies. Decoding JSON and constructing
+    // NOTAMs is expensive, so this is done in the global thread pool.
+    QList<DecodedReply> replies;
     m_networkReplies.removeAll(nullptr);
-    for(const auto& networkReply : m_networkReplies)
+    for(const auto& networkReply : std::as_const(m_networkReplies))
     {
         // Paranoid safety checks
         if (networkReply.isNull())
@@ -244,19 +440,51 @@ void NOTAM::NOTAMProvider::downloadFinished()
             continue;
         }
 
-        auto region = networkReply->property("area").value<QGeoCircle>();
-        auto data = networkReply->readAll();
+        DecodedReply reply;
+        reply.region = networkReply->property("area").value<QGeoCircle>();
+        reply.data = networkReply->readAll();
         networkReply->deleteLater();
+        replies.append(reply);
+    }
+    m_networkReplies.removeIf([](const QPointer<QNetworkReply>& networkReply) {
+        return networkReply.isNull() || networkReply->isFinished();
+    });
+    if (replies.isEmpty())
+    {
+        return;
+    }
+
+    QList<QGeoCircle> regions;
+    for(const auto& reply : std::as_const(replies))
+    {
+        regions.append(reply.region);
+    }
+    m_decodingRegions += regions;
 
-        auto jsonDoc = QJsonDocument::fromJson(data);
-        if (jsonDoc.isNull())
+    auto* watcher = new QFutureWatcher<DecodedReply>(this);
+    connect(watcher, &QFutureWatcher<DecodedReply>::finished, this, [this, watcher, regions]() {
+        for(const auto& region : regions)
         {
-            continue;
+            m_decodingRegions.removeOne(region);
         }
-        NOTAMList const notamList(jsonDoc, region, &cancelledNotams);
-        newNotamList.prepend(notamList);
-    }
-    m_notamLists = cleaned(newNotamList, cancelledNotams);
+
+        // Publish all decoded lists in one step
+        auto newNotamLists = m_notamLists.value();
+        QSet<QString> cancelledNotams;
+        const auto results = watcher->future().results();
+        for(const auto& result : results)
+        {
+            if (!result.valid)
+            {
+                continue;
+            }
+            newNotamLists.prepend(result.notamList);
+            cancelledNotams += result.cancelledNotams;
+        }
+        m_notamLists = cleaned(newNotamLists, cancelledNotams);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::mapped(replies, decodeReply));
 }
 
 bool NOTAM::NOTAMProvider::hasDataForPosition(const QGeoCoordinate& position, bool includeDataThatNeedsUpdate, bool includeRunningDownloads) const
@@ -307,21 +535,68 @@ bool NOTAM::NOTAMProvider::hasDataForPosition(const QGeoCoordinate& position, bo
                 return true;
             }
         }
+        for(const auto& region : m_decodingRegions)
+        {
+            if (region.radius() - region.center().distanceTo(position) >= minimumRadiusPoint.toM())
+            {
+                return true;
+            }
+        }
     }
 
     return false;
 }
 
-void NOTAM::NOTAMProvider::save() const
+void NOTAM::NOTAMProvider::save(bool synchronous)
 {
-    auto outputFile = QFile(m_stdFileName);
-    if (outputFile.open(QIODevice::WriteOnly))
+    // If a save operation is still running, try again later
+    if (m_saveFuture.isRunning() && !synchronous)
+    {
+        m_saveTimer.start();
+        return;
+    }
+    m_saveFuture.waitForFinished();
+
+    // Find segments that changed since the last save. Cleaning only ever
+    // removes NOTAMs from a list, so the retrieval time and the number of
+    // NOTAMs identify the content of a segment.
+    StoreUpdate update;
+    update.directory = m_storeDirectory;
+    if (m_readNotamNumbersDirty)
+    {
+        update.readNotamNumbers = m_readNotamNumbers;
+        m_readNotamNumbersDirty = false;
+    }
+    QHash<QString, std::pair<QDateTime, qsizetype>> segments;
+    for(const auto& notamList : m_notamLists.value())
     {
-        QDataStream outputStream(&outputFile);
-        outputStream << QStringLiteral(GIT_COMMIT);
-        outputStream << m_readNotamNumbers;
-        outputStream << m_notamLists.value();
+        auto fileName = segmentFileName(m_storeDirectory, notamList.region());
+        std::pair<QDateTime, qsizetype> signature {notamList.retrieved(), notamList.notams().size()};
+        if (m_savedSegments.value(fileName) != signature)
+        {
+            update.segments.append(notamList);
+        }
+        segments[fileName] = signature;
+    }
+    for(auto it = m_savedSegments.cbegin(); it != m_savedSegments.cend(); ++it)
+    {
+        if (!segments.contains(it.key()))
+        {
+            update.removedSegments.append(it.key());
+        }
+    }
+    m_savedSegments = segments;
+
+    if (!update.readNotamNumbers.has_value() && update.segments.isEmpty() && update.removedSegments.isEmpty())
+    {
+        return;
+    }
+    if (synchronous)
+    {
+        writeStore(update);
+        return;
     }
+    m_saveFuture = QtConcurrent::run(writeStore, update);
 }
 
 void NOTAM::NOTAMProvider::startRequest(const QGeoCoordinate& coordinate)
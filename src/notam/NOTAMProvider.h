@@ -21,9 +21,12 @@
 #pragma once
 
 #include <QBindable>
+#include <QFuture>
+#include <QHash>
 #include <QNetworkReply>
 #include <QQmlEngine>
 #include <QStandardPaths>
+#include <QTimer>
 
 #include "GlobalObject.h"
 #include "notam/NOTAMList.h"
@@ -196,8 +199,9 @@ private:
     // Removes outdated NOTAMs and outdated NOTAMLists.
     Q_REQUIRED_RESULT static QList<NOTAMList> cleaned(const QList<NOTAMList>& notamLists, const QSet<QString>& cancelledNotams = {});
 
-    // This method reads the incoming data from network replies and adds it to
-    // the database. It cleans up the list of network replies in
+    // This method reads the incoming data from network replies, decodes it in
+    // the global thread pool and adds the decoded NOTAM lists to the database
+    // in one step. It cleans up the list of network replies in
     // m_networkReplies. On error, it requests a call to updateData in five
     // minutes. This method is connected to signals QNetworkReply::finished and
     // QNetworkReply::errorOccurred of the QNetworkReply contained in the list
@@ -215,11 +219,16 @@ private:
     // NOTAM data
     Q_REQUIRED_RESULT bool hasDataForPosition(const QGeoCoordinate& position, bool includeDataThatNeedsUpdate, bool includeRunningDownloads) const;
 
-    // Save NOTAM data to a file, using the filename found in m_stdFileName.
-    // There are no error checks of any kind. The propertyNotifier ensures that
-    // the method save() is called whenever m_notamLists changes.
-    void save() const;
+    // Save NOTAM data to the store in m_storeDirectory. The store holds one
+    // segment file per region and one file with the read NOTAM numbers. Only
+    // files that changed since the last save are written, in the global thread
+    // pool unless synchronous is true. There are no error checks of any kind.
+    // The propertyNotifier starts m_saveTimer whenever m_notamLists changes, so
+    // that bursts of changes are saved only once.
+    void save(bool synchronous = false);
     QPropertyNotifier m_saveNotifier;
+    QTimer m_saveTimer;
+    QFuture<void> m_saveFuture;
 
     // Request NOTAM data from the FAA, for a circle of radius requestRadius
     // around the coordinate.  For performance reasons, the request will be
@@ -240,12 +249,32 @@ private:
     // List with numbers of notams that have been marked as read
     QList<QString> m_readNotamNumbers;
 
+    // Indicates that m_readNotamNumbers changed since the last save
+    bool m_readNotamNumbersDirty {false};
+
+    // Segment files in the store, with retrieval time and number of NOTAMs of
+    // the NOTAMList that was last saved there
+    QHash<QString, std::pair<QDateTime, qsizetype>> m_savedSegments;
+
     // List of pending network requests
     QList<QPointer<QNetworkReply>> m_networkReplies;
 
+    // Regions of network replies that have been downloaded, but are still
+    // being decoded
+    QList<QGeoCircle> m_decodingRegions;
+
     // List of NOTAMLists, sorted so that newest lists come first
     QProperty<QList<NOTAMList>> m_notamLists;
 
+    // Cache for the method notams(), mapping waypoint coordinates to
+    // restricted NOTAM lists. The cache is cleared whenever m_notamLists or
+    // m_readNotamNumbers change, and once restrictedCacheLifetimeInS seconds
+    // have passed since m_restrictedCacheTime.
+    QHash<QGeoCoordinate, NOTAMList> m_restrictedCache;
+    QDateTime m_restrictedCacheTime;
+    QPropertyNotifier m_restrictedCacheNotifier;
+    static constexpr qint64 restrictedCacheLifetimeInS = 60;
+
     // This is a list of control points.  The computing function guarantees that
     // the NOTAM data covers a region of at least marginRadiusFlightRoute around
     // the route if the data covers a circle of radius marginRadius around every
@@ -267,8 +296,11 @@ private:
     QProperty<QString> m_status;
     Q_REQUIRED_RESULT QString computeStatus() const;
 
-    // Filename for loading/saving NOTAM data
-    QString m_stdFileName { QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+u"/notam.dat"_s };
+    // Directory for loading/saving NOTAM data
+    QString m_storeDirectory { QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+u"/NOTAMs"_s };
+
+    // File used by earlier versions for saving NOTAM data
+    QString m_legacyFileName { QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+u"/notam.dat"_s };
 
     // NOTAM data is considered to cover the flight route if it covers a region
     // of at least marginRadiusFlightRoute around the route
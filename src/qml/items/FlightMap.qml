@@ -70,7 +70,9 @@ Map {
 
             property string url: {
                 var vac = Global.currentVAC
-                if (!vac.isValid)
+                // If the VAC comes with a tile pyramid, the chart is shown by the
+                // source "vacTiles" and the full image need not be decoded.
+                if (!vac.isValid || (vac.tilesFileName !== ""))
                     return "qrc:/icons/appIcon.png"
                 return "file://" + vac.fileName
             }
@@ -95,6 +97,14 @@ Map {
 
         }
 
+        SourceParameter {
+            id: approachChartTiles
+
+            styleId: "vacTiles"
+            type: "raster"
+            property string url: GeoMapProvider.serverUrl + "/vac/"
+        }
+
         SourceParameter {
             id: waypointLib
 
@@ -362,7 +372,19 @@ Map {
             property string source: "vac"
 
             layout: {
-                "visibility": Global.currentVAC.isValid ? 'visible' : 'none'
+                "visibility": (Global.currentVAC.isValid && (Global.currentVAC.tilesFileName === "")) ? 'visible' : 'none'
+            }
+        }
+
+        LayerParameter {
+            id: approachChartTilesLayer
+
+            styleId: "vacTilesLayer"
+            type: "raster"
+            property string source: "vacTiles"
+
+            layout: {
+                "visibility": (Global.currentVAC.isValid && (Global.currentVAC.tilesFileName !== "")) ? 'visible' : 'none'
             }
         }
 
@@ -33,6 +33,7 @@ Item {
     property Drawer drawer
     property var toast
     property vac currentVAC
+    onCurrentVACChanged: GeoMapProvider.setCurrentVAC(currentVAC)
     property vac defaultVAC
 
     // Warning
@@ -141,6 +141,57 @@ Item {
         }
     }
 
+    Connections {
+        target: WaypointLibrary
+
+        function onImportStatus(percent) {
+            if (percent < 1.0) {
+                waitTxtLbl.text = qsTr("Importing waypoints. Please do not interrupt or close the app.")
+                waitPbar.value = percent
+                importWaitDialog.open()
+            } else
+                importWaitDialog.close()
+            return
+        }
+
+        function onImportFinished(errorString) {
+            if (errorString !== "") {
+                errLbl.text = errorString
+                errorDialog.open()
+                return
+            }
+
+            if (!(importManager.stackView.currentItem instanceof WaypointLibraryPage)) {
+                importManager.stackView.pop()
+                importManager.stackView.push("../pages/WaypointLibraryPage.qml")
+            }
+            toast.doToast( qsTr("Waypoints imported") )
+        }
+    }
+
+    Connections {
+        target: DataManager
+
+        function onImportOpenAirStatus(percent) {
+            if (percent < 1.0) {
+                waitTxtLbl.text = qsTr("Importing airspace data. Please do not interrupt or close the app.")
+                waitPbar.value = percent
+                importWaitDialog.open()
+            } else
+                importWaitDialog.close()
+            return
+        }
+
+        function onImportOpenAirFinished(errorString) {
+            if (errorString !== "") {
+                errLbl.text = errorString
+                errorDialog.open()
+                return
+            }
+            importManager.toast.doToast( qsTr("Airspace data imported") )
+        }
+    }
+
     Connections {
         target: VACLibrary
 
@@ -152,6 +203,15 @@ Item {
                 importTripKitWaitDialog.close()
             return
         }
+
+        function onImportTripKitFinished(errorString) {
+            if (errorString !== "") {
+                errLbl.text = errorString
+                errorDialog.open()
+                return
+            }
+            importManager.toast.doToast( qsTr("Trip kit imported") )
+        }
     }
 
 /*
@@ -311,13 +371,7 @@ Item {
         onAccepted: {
             PlatformAdaptor.vibrateBrief()
 
-            var errorString = DataManager.importOpenAir(importManager.filePath, mapNameOpenAir.text)
-            if (errorString !== "") {
-                errLbl.text = errorString
-                errorDialog.open()
-                return
-            }
-            importManager.toast.doToast( qsTr("Airspace data imported") )
+            DataManager.startImportOpenAir(importManager.filePath, mapNameOpenAir.text)
         }
     }
 
@@ -521,18 +575,7 @@ Item {
         onAccepted: {
             PlatformAdaptor.vibrateBrief()
 
-            var errorString = WaypointLibrary.import(importManager.filePath, skip.checked)
-            if (errorString !== "") {
-                errLbl.text = errorString
-                errorDialog.open()
-                return
-            }
-
-            if (!(importManager.stackView.currentItem instanceof WaypointLibraryPage)) {
-                importManager.stackView.pop()
-                importManager.stackView.push("../pages/WaypointLibraryPage.qml")
-            }
-            toast.doToast( qsTr("Waypoints imported") )
+            WaypointLibrary.startImport(importManager.filePath, skip.checked)
         }
     }
 
@@ -579,13 +622,7 @@ Item {
             PlatformAdaptor.vibrateBrief()
             close()
 
-            var errorString = VACLibrary.importTripKit(importManager.filePath)
-            if (errorString !== "") {
-                errLbl.text = errorString
-                errorDialog.open()
-                return
-            }
-            importManager.toast.doToast( qsTr("Trip kit imported") )
+            VACLibrary.startImportTripKit(importManager.filePath)
         }
     }
 
@@ -638,4 +675,35 @@ Item {
 
         }
     }
+
+    CenteringDialog {
+        id: importWaitDialog
+        title: qsTr("Stand by")
+
+        modal: true
+        closePolicy: Popup.NoAutoClose
+
+        ColumnLayout {
+            anchors.fill: parent
+
+            Label {
+                id: waitTxtLbl
+                Layout.fillWidth: true
+
+                wrapMode: Text.Wrap
+                textFormat: Text.StyledText
+            }
+
+            Item {
+                height: waitTxtLbl.font.pixelSize
+            }
+
+            ProgressBar {
+                id: waitPbar
+                Layout.fillWidth: true
+                value: 0.0
+            }
+
+        }
+    }
 }
@@ -217,6 +217,17 @@ Page {
                     }
                 }
 
+                MenuItem {
+                    text: qsTr("Download maps along route")
+                    enabled: Navigator.flightRoute.size > 1
+
+                    onTriggered: {
+                        PlatformAdaptor.vibrateBrief()
+                        highlighted = false
+                        DataManager.corridorPlanner.prefetch()
+                    }
+                }
+
                 MenuSeparator { }
 
                 MenuItem {
@@ -308,11 +319,37 @@ Page {
     }
 
 
+    Label {
+        id: schedulerStatus
+
+        anchors.top: bar.bottom
+        anchors.left: parent.left
+        anchors.right: parent.right
+        leftPadding: SafeInsets.left + font.pixelSize
+        rightPadding: SafeInsets.right + font.pixelSize
+        topPadding: font.pixelSize*0.5
+        bottomPadding: font.pixelSize*0.5
+
+        visible: DataManager.downloadScheduler.pending > 0
+        height: visible ? implicitHeight : 0
+
+        wrapMode: Text.Wrap
+        text: {
+            var scheduler = DataManager.downloadScheduler
+            var result = qsTr("Downloads pending: %1").arg(scheduler.pending)
+            if (!scheduler.throughput.isNull())
+                result += " • " + qsTr("%1/s").arg(scheduler.throughput.toString())
+            if (scheduler.eta.isFinite())
+                result += " • " + qsTr("%1 h remaining").arg(scheduler.eta.toHoursAndMinutes())
+            return result
+        }
+    }
+
     SwipeView{
         id: sv
 
         currentIndex: bar.currentIndex
-        anchors.top: bar.bottom
+        anchors.top: schedulerStatus.bottom
         anchors.left: parent.left
         anchors.right: parent.right
         anchors.bottom: parent.bottom
@@ -276,6 +276,71 @@ Page {
                 }
             }
 
+            Label {
+                Layout.leftMargin: settingsPage.font.pixelSize
+                Layout.columnSpan: 2
+                text: qsTr("Map and Data Library")
+                font.pixelSize: settingsPage.font.pixelSize*1.2
+                font.bold: true
+            }
+
+            WordWrappingSwitchDelegate {
+                id: autoPrefetch
+                text: qsTr("Download Maps Along Route")
+                icon.source: "/icons/material/ic_file_download.svg"
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    autoPrefetch.checked = DataManager.corridorPlanner.autoPrefetch
+                }
+                onToggled: {
+                    PlatformAdaptor.vibrateBrief()
+                    DataManager.corridorPlanner.autoPrefetch = autoPrefetch.checked
+                }
+            }
+            ToolButton {
+                icon.source: "/icons/material/ic_info_outline.svg"
+                onClicked: {
+                    PlatformAdaptor.vibrateBrief()
+                    helpDialog.title = qsTr("Download Maps Along Route")
+                    helpDialog.text = "<p>" + qsTr("If this option is enabled, the app automatically downloads aviation maps, base maps and terrain maps for a corridor of 25 km around the current flight route whenever the route changes.") + "</p>"
+                            + "<p>" + qsTr("Depending on the route, this might download a large amount of data. You might wish to use this option only when connected to Wi-Fi.") + "</p>"
+                    helpDialog.open()
+                }
+            }
+
+            WordWrappingItemDelegate {
+                id: diskQuota
+                text: {
+                    var secondLineString = ""
+                    var quota = DataManager.corridorPlanner.diskQuota
+                    if (quota.isNull()) {
+                        secondLineString = qsTr("Currently no limit")
+                    } else {
+                        secondLineString = qsTr("Currently limited to %1").arg(quota.toString())
+                    }
+                    return qsTr("Storage Limit for Maps") +
+                            `<br><font color="#606060" size="2">` +
+                            secondLineString +
+                            `</font>`
+                }
+                icon.source: "/icons/material/ic_map.svg"
+                Layout.fillWidth: true
+                onClicked: {
+                    PlatformAdaptor.vibrateBrief()
+                    diskQuotaDialog.open()
+                }
+            }
+            ToolButton {
+                icon.source: "/icons/material/ic_info_outline.svg"
+                onClicked: {
+                    PlatformAdaptor.vibrateBrief()
+                    helpDialog.title = qsTr("Storage Limit for Maps")
+                    helpDialog.text = "<p>" + qsTr("Maps can take up a lot of storage space on your device. Once a storage limit is set, the app deletes the maps that have not been used for the longest time whenever the installed maps exceed the limit.") + "</p>"
+                            + "<p>" + qsTr("Maps that contain your current position or lie along the current flight route are never deleted, and neither are imported files. Deleted maps can be downloaded again at any time.") + "</p>"
+                    helpDialog.open()
+                }
+            }
+
             Label {
                 Layout.leftMargin: settingsPage.font.pixelSize
                 Layout.columnSpan: 2
@@ -603,6 +668,65 @@ Page {
 
     }
 
+    CenteringDialog {
+        id: diskQuotaDialog
+
+        modal: true
+        title: qsTr("Storage Limit for Maps")
+        standardButtons: Dialog.Ok|Dialog.Cancel
+
+        // Used internally
+        property byteSize staticByteSize
+
+        ColumnLayout {
+            width: diskQuotaDialog.availableWidth
+
+            Label {
+                text: qsTr("Once a storage limit is set, the app deletes the maps that have not been used for the longest time whenever the installed maps exceed the limit.")
+                Layout.fillWidth: true
+                wrapMode: Text.Wrap
+            }
+
+            SwitchDelegate {
+                id: diskQuotaCheck
+                text: qsTr("Set storage limit")
+                Layout.fillWidth: true
+            }
+
+            Slider {
+                id: diskQuotaSlider
+                Layout.fillWidth: true
+                enabled: diskQuotaCheck.checked
+                from: 500
+                to: 20000
+                stepSize: 500
+            }
+
+            Label {
+                text: {
+                    if (diskQuotaCheck.checked)
+                        return qsTr("Keep installed maps below %1.").arg(diskQuotaDialog.staticByteSize.fromMB(diskQuotaSlider.value).toString())
+                    return qsTr("No limit, maps are never deleted automatically")
+                }
+                Layout.fillWidth: true
+                wrapMode: Text.Wrap
+            }
+        }
+
+        onAboutToShow: {
+            var quota = DataManager.corridorPlanner.diskQuota
+            diskQuotaCheck.checked = !quota.isNull()
+            diskQuotaSlider.value = quota.isNull() ? 2000 : quota.toMB()
+        }
+
+        onAccepted: {
+            if (diskQuotaCheck.checked)
+                DataManager.corridorPlanner.diskQuota = staticByteSize.fromMB(diskQuotaSlider.value)
+            else
+                DataManager.corridorPlanner.diskQuota = staticByteSize.fromMB(0)
+        }
+    }
+
     CenteringDialog {
         id: primaryPositionDataSourceDialog
 
@@ -77,7 +77,11 @@ Page {
 
             Item {
                 width: stationList.width
-                height: idel.height
+                height: visible ? idel.height : 0
+
+                // Hide stations whose reports cannot be decoded. Reports are
+                // decoded here, when they are first shown.
+                visible: model.modelData.metar.isValid || model.modelData.taf.isValid
 
                 // Color according to METAR/FAA flight category
                 Rectangle {
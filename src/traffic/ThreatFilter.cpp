@@ -0,0 +1,153 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QtMath>
+#include <cmath>
+
+#include "traffic/ThreatFilter.h"
+
+
+namespace {
+
+// Distance used for targets whose relative position cannot be determined
+constexpr double farAwayInM = 1.0e7;
+
+// Meters per degree of latitude, sufficient for the short ranges of traffic
+// receivers
+constexpr double metersPerDegree = 111320.0;
+
+// Splits a speed/track pair into east and north components
+void velocityComponents(const Positioning::PositionInfo& info, double& vEast, double& vNorth)
+{
+    vEast = 0.0;
+    vNorth = 0.0;
+
+    auto GS = info.groundSpeed();
+    auto TT = info.trueTrack();
+    if (!GS.isFinite() || !TT.isFinite())
+    {
+        return;
+    }
+    vEast = GS.toMPS()*std::sin(TT.toRAD());
+    vNorth = GS.toMPS()*std::cos(TT.toRAD());
+}
+
+} // namespace
+
+
+void Traffic::ThreatFilter::resize(qsizetype newSize)
+{
+    auto size = static_cast<std::size_t>(newSize);
+    m_east.resize(size, farAwayInM);
+    m_north.resize(size, 0.0);
+    m_up.resize(size, 0.0);
+    m_vEast.resize(size, 0.0);
+    m_vNorth.resize(size, 0.0);
+    m_vUp.resize(size, 0.0);
+    m_tCPA.resize(size, 0.0);
+    m_hMiss.resize(size, farAwayInM);
+    m_vSep.resize(size, 0.0);
+    m_score.resize(size, farAwayInM);
+}
+
+
+void Traffic::ThreatFilter::setTarget(qsizetype index, const Positioning::PositionInfo& ownship, const Positioning::PositionInfo& target, Units::Distance vDist)
+{
+    auto idx = static_cast<std::size_t>(index);
+
+    auto ownCoordinate = ownship.coordinate();
+    auto targetCoordinate = target.coordinate();
+    if (!ownCoordinate.isValid() || !targetCoordinate.isValid())
+    {
+        m_east[idx] = farAwayInM;
+        m_north[idx] = 0.0;
+        m_up[idx] = 0.0;
+        m_vEast[idx] = 0.0;
+        m_vNorth[idx] = 0.0;
+        m_vUp[idx] = 0.0;
+        return;
+    }
+
+    // Local tangent plane around ownship
+    auto cosLat = std::cos(qDegreesToRadians(ownCoordinate.latitude()));
+    auto dLon = targetCoordinate.longitude()-ownCoordinate.longitude();
+    if (dLon > 180.0)
+    {
+        dLon -= 360.0;
+    }
+    if (dLon < -180.0)
+    {
+        dLon += 360.0;
+    }
+    m_east[idx] = dLon*metersPerDegree*cosLat;
+    m_north[idx] = (targetCoordinate.latitude()-ownCoordinate.latitude())*metersPerDegree;
+    m_up[idx] = vDist.isFinite() ? vDist.toM() : 0.0;
+
+    // Relative velocity
+    double ownEast = 0.0;
+    double ownNorth = 0.0;
+    double targetEast = 0.0;
+    double targetNorth = 0.0;
+    velocityComponents(ownship, ownEast, ownNorth);
+    velocityComponents(target, targetEast, targetNorth);
+    m_vEast[idx] = targetEast-ownEast;
+    m_vNorth[idx] = targetNorth-ownNorth;
+
+    auto ownVS = ownship.verticalSpeed();
+    auto targetVS = target.verticalSpeed();
+    m_vUp[idx] = (targetVS.isFinite() ? targetVS.toMPS() : 0.0) - (ownVS.isFinite() ? ownVS.toMPS() : 0.0);
+}
+
+
+void Traffic::ThreatFilter::compute()
+{
+    const auto size = m_east.size();
+
+    const double* east = m_east.data();
+    const double* north = m_north.data();
+    const double* up = m_up.data();
+    const double* vEast = m_vEast.data();
+    const double* vNorth = m_vNorth.data();
+    const double* vUp = m_vUp.data();
+    double* tCPA = m_tCPA.data();
+    double* hMiss = m_hMiss.data();
+    double* vSep = m_vSep.data();
+    double* score = m_score.data();
+
+    // Keep this loop free of branches, so that it can be vectorised. The
+    // division is guarded by a tiny epsilon: for targets without relative
+    // motion, the numerator vanishes as well and t evaluates to zero.
+    for(std::size_t i = 0; i < size; i++)
+    {
+        const double vv = vEast[i]*vEast[i] + vNorth[i]*vNorth[i];
+        double t = -(east[i]*vEast[i] + north[i]*vNorth[i])/(vv + 1.0e-9);
+        t = std::fmin(std::fmax(t, 0.0), lookAheadInS);
+
+        const double dx = east[i] + vEast[i]*t;
+        const double dy = north[i] + vNorth[i]*t;
+        const double dz = up[i] + vUp[i]*t;
+        const double h = std::sqrt(dx*dx + dy*dy);
+
+        tCPA[i] = t;
+        hMiss[i] = h;
+        vSep[i] = dz;
+        score[i] = std::sqrt(h*h + dz*dz);
+    }
+}
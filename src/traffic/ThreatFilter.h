@@ -0,0 +1,152 @@
+/***************************************************************************
+ *   Copyright (C) 2025 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include "positioning/PositionInfo.h"
+#include "units/Distance.h"
+
+
+namespace Traffic {
+
+/*! \brief Batch computation of closest points of approach
+ *
+ *  This class holds kinematic data of a number of traffic targets in packed
+ *  arrays: position and velocity relative to ownship, in a local east-north-up
+ *  frame. The method compute() finds time to closest point of approach (CPA),
+ *  horizontal miss distance and vertical separation at CPA for all targets in
+ *  one pass. The loop is free of branches and function calls, so that the
+ *  compiler can vectorise it.
+ *
+ *  The class is used by the TrafficDataProvider to decide which of the reported
+ *  targets are promoted to the QML-visible traffic objects, without touching
+ *  the QObject properties of every candidate.
+ */
+
+class ThreatFilter {
+
+public:
+    /*! \brief Time horizon for CPA prediction
+     *
+     *  Closest points of approach further in the future than this are not
+     *  considered. Targets that diverge are evaluated at their current position.
+     */
+    static constexpr double lookAheadInS = 120.0;
+
+    /*! \brief Default constructor */
+    ThreatFilter() = default;
+
+    /*! \brief Number of targets
+     *
+     *  @returns Number of targets
+     */
+    [[nodiscard]] qsizetype size() const { return static_cast<qsizetype>(m_east.size()); }
+
+    /*! \brief Set number of targets
+     *
+     *  Existing entries are kept, new entries are set to targets with unknown
+     *  position.
+     *
+     *  @param newSize New number of targets
+     */
+    void resize(qsizetype newSize);
+
+    /*! \brief Set kinematic data of a target
+     *
+     *  Positions are converted to a local tangent plane around ownship. Ground
+     *  speed, track and vertical speed are used where available and taken as
+     *  zero otherwise. If the ownship position or the target position is
+     *  unknown, the target is marked as far away.
+     *
+     *  @param index Index of the target, must be less than size()
+     *
+     *  @param ownship Position info of ownship
+     *
+     *  @param target Position info of the target
+     *
+     *  @param vDist Vertical distance from ownship to target, as reported by
+     *  the traffic receiver. This is used instead of the coordinate altitudes,
+     *  which are often not known.
+     */
+    void setTarget(qsizetype index, const Positioning::PositionInfo& ownship, const Positioning::PositionInfo& target, Units::Distance vDist);
+
+    /*! \brief Compute CPA for all targets
+     *
+     *  This method must be called after the target data has been set and
+     *  before the getter methods below are used.
+     */
+    void compute();
+
+    /*! \brief Time to closest point of approach
+     *
+     *  @param index Index of the target
+     *
+     *  @returns Time to CPA in seconds, in the range [0, lookAheadInS]
+     */
+    [[nodiscard]] double timeToCPA(qsizetype index) const { return m_tCPA.at(index); }
+
+    /*! \brief Horizontal distance at closest point of approach
+     *
+     *  @param index Index of the target
+     *
+     *  @returns Horizontal miss distance
+     */
+    [[nodiscard]] Units::Distance horizontalMissDistance(qsizetype index) const { return Units::Distance::fromM(m_hMiss.at(index)); }
+
+    /*! \brief Vertical separation at closest point of approach
+     *
+     *  @param index Index of the target
+     *
+     *  @returns Vertical separation, positive if the target is above
+     */
+    [[nodiscard]] Units::Distance verticalSeparation(qsizetype index) const { return Units::Distance::fromM(m_vSep.at(index)); }
+
+    /*! \brief Threat score
+     *
+     *  The threat score is the three-dimensional miss distance at CPA, in
+     *  meters. Smaller values indicate more threatening traffic.
+     *
+     *  @param index Index of the target
+     *
+     *  @returns Threat score
+     */
+    [[nodiscard]] double score(qsizetype index) const { return m_score.at(index); }
+
+private:
+    // Relative position in meters
+    std::vector<double> m_east;
+    std::vector<double> m_north;
+    std::vector<double> m_up;
+
+    // Relative velocity in meters per second
+    std::vector<double> m_vEast;
+    std::vector<double> m_vNorth;
+    std::vector<double> m_vUp;
+
+    // Results of compute()
+    std::vector<double> m_tCPA;
+    std::vector<double> m_hMiss;
+    std::vector<double> m_vSep;
+    std::vector<double> m_score;
+};
+
+} // namespace Traffic
@@ -22,6 +22,7 @@
 #include <QFile>
 
 #include "platform/PlatformAdaptor_Abstract.h"
+#include "positioning/PositionProvider.h"
 #include "traffic/TrafficDataProvider.h"
 
 #if __has_include(<QSerialPort>)
@@ -426,15 +427,30 @@ void Traffic::TrafficDataProvider::onTrafficFactorWithPosition(const Traffic::Tr
         }
     }
 
-    auto* lowestPriObject = m_trafficObjects.at(0);
-    for(auto* target : m_trafficObjects)
+    // Compute closest points of approach for all traffic objects and for the
+    // new factor in one pass. The new factor occupies the last slot of the
+    // threat filter.
+    const auto numTrafficObjects = m_trafficObjects.size();
+    const auto ownship = GlobalObject::positionProvider()->positionInfo();
+    m_threatFilter.resize(numTrafficObjects+1);
+    for(qsizetype i = 0; i < numTrafficObjects; i++)
+    {
+        const auto* target = m_trafficObjects.at(i);
+        m_threatFilter.setTarget(i, ownship, target->positionInfo(), target->vDist());
+    }
+    m_threatFilter.setTarget(numTrafficObjects, ownship, factor.positionInfo(), factor.vDist());
+    m_threatFilter.compute();
+
+    qsizetype lowestPriIndex = 0;
+    for(qsizetype i = 1; i < numTrafficObjects; i++)
     {
-        if (lowestPriObject->hasHigherPriorityThan(*target))
+        if (isMoreThreatening(*m_trafficObjects.at(lowestPriIndex), lowestPriIndex, *m_trafficObjects.at(i), i))
         {
-            lowestPriObject = target;
+            lowestPriIndex = i;
         }
     }
-    if (factor.hasHigherPriorityThan(*lowestPriObject))
+    auto* lowestPriObject = m_trafficObjects.at(lowestPriIndex);
+    if (isMoreThreatening(factor, numTrafficObjects, *lowestPriObject, lowestPriIndex))
     {
         lowestPriObject->setAnimate(false);
         lowestPriObject->copyFrom(factor);
@@ -442,6 +458,27 @@ void Traffic::TrafficDataProvider::onTrafficFactorWithPosition(const Traffic::Tr
     }
 }
 
+bool Traffic::TrafficDataProvider::isMoreThreatening(const Traffic::TrafficFactor_Abstract& lhs, qsizetype lhsIndex,
+                                                     const Traffic::TrafficFactor_Abstract& rhs, qsizetype rhsIndex) const
+{
+    // Criteria as in TrafficFactor_Abstract::hasHigherPriorityThan
+    if (lhs.valid() != rhs.valid())
+    {
+        return lhs.valid();
+    }
+    if (lhs.alarmLevel() != rhs.alarmLevel())
+    {
+        return lhs.alarmLevel() > rhs.alarmLevel();
+    }
+    if (lhs.relevant() != rhs.relevant())
+    {
+        return lhs.relevant();
+    }
+
+    // Criterion: Predicted miss distance at closest point of approach
+    return m_threatFilter.score(lhsIndex) < m_threatFilter.score(rhsIndex);
+}
+
 void Traffic::TrafficDataProvider::onTrafficReceiverRuntimeError()
 {
     QString result;
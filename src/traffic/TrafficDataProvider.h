@@ -27,6 +27,7 @@
 #include "GlobalObject.h"
 #include "positioning/PositionInfoSource_Abstract.h"
 #include "traffic/ConnectionInfo.h"
+#include "traffic/ThreatFilter.h"
 #include "traffic/TrafficDataSource_Abstract.h"
 
 namespace Traffic {
@@ -415,6 +416,11 @@ private:
 
     QString computeStatusString();
 
+    // Decides which of two traffic factors is more threatening. The indices
+    // refer to the slots in m_threatFilter, which must have been computed.
+    [[nodiscard]] bool isMoreThreatening(const Traffic::TrafficFactor_Abstract& lhs, qsizetype lhsIndex,
+                                         const Traffic::TrafficFactor_Abstract& rhs, qsizetype rhsIndex) const;
+
     // UDP Socket for ForeFlight Broadcast messages.
     // See https://www.foreflight.com/connect/spec/
     QNetworkDatagram foreFlightBroadcastDatagram {R"({"App":"Enroute Flight Navigation","GDL90":{"port":4000}})", QHostAddress::Broadcast, 63093};
@@ -425,6 +431,10 @@ private:
     QList<Traffic::TrafficFactor_WithPosition *> m_trafficObjects;
     QPointer<Traffic::TrafficFactor_DistanceOnly> m_trafficObjectWithoutPosition;
 
+    // Closest points of approach for m_trafficObjects, plus one slot for the
+    // candidate that is currently evaluated
+    Traffic::ThreatFilter m_threatFilter;
+
     // TrafficData Sources
     QProperty<QList<QPointer<Traffic::TrafficDataSource_Abstract>>> m_dataSources;
     QProperty<QPointer<Traffic::TrafficDataSource_Abstract>> m_currentSource;
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <QLocale>
 #include <QQmlEngine>
 
 /*! \brief Wrapper around size_t, to make it available to QML
@@ -51,12 +52,42 @@ namespace Units {
          */
         ByteSize(size_t val) : value(val) {}
 
+        /*! \brief Constructs a size from megabytes
+         *
+         *  @param sizeInMB Size in megabytes (10^6 bytes). Negative values are
+         *  treated as zero.
+         *
+         *  @returns Units::ByteSize
+         */
+        Q_INVOKABLE static Units::ByteSize fromMB(double sizeInMB)
+        {
+            return {static_cast<size_t>(qMax(0.0, sizeInMB)*1000.0*1000.0)};
+        }
+
         /*! \brief Check if zero
          *
          *  @returns True is size is zero
          */
         [[nodiscard]] Q_INVOKABLE bool isNull() const { return value == 0; }
 
+        /*! \brief Convert to megabytes
+         *
+         *  @returns Size in megabytes (10^6 bytes)
+         */
+        [[nodiscard]] Q_INVOKABLE double toMB() const
+        {
+            return static_cast<double>(value)/(1000.0*1000.0);
+        }
+
+        /*! \brief Human-readable string, such as "1.2 GB"
+         *
+         *  @returns String, formatted according to the system locale
+         */
+        [[nodiscard]] Q_INVOKABLE QString toString() const
+        {
+            return QLocale::system().formattedDataSize(static_cast<qint64>(value), 1, QLocale::DataSizeSIFormat);
+        }
+
         /*! \brief Conversion from Units::ByteSize to size_t
          *
          * @returns Value
@@ -35,13 +35,24 @@ using namespace Qt::Literals::StringLiterals;
 
 
 Weather::Decoder::Decoder(const QString &rawText, const QDate &referenceDate)
-    : m_referenceDate(referenceDate)
+    : m_rawText(rawText), m_referenceDate(referenceDate)
 {
-    m_parseResult = metaf::Parser::parse(rawText.toStdString());
+}
+
+void Weather::Decoder::parse() const
+{
+    if (m_parsed)
+    {
+        return;
+    }
+    m_parseResult = metaf::Parser::parse(m_rawText.toStdString());
+    m_parsed = true;
 }
 
 QString Weather::Decoder::decodedText(const Navigation::Aircraft& act, const QDateTime& time)
 {
+    parse();
+
     m_aircraft = act;
     m_currentTime = time;
 
@@ -54,6 +54,8 @@ public:
     // This constructor creates an invalid Decoder instance.
     Decoder() = default;
 
+    // This constructor is cheap. The raw text is parsed only when one of the
+    // methods below is first called.
     explicit Decoder(const QString& rawText, const QDate& referenceDate);
 
     virtual ~Decoder() = default;
@@ -94,11 +96,14 @@ public:
     [[nodiscard]] QString decodedText(const Navigation::Aircraft& act, const QDateTime& time);
 
     /*! \brief Indicates if raw text could be parsed correctly
+     *
+     * This method is not thread-safe.
      *
      * @returns True if no error
      */
     [[nodiscard]] bool isValid() const
     {
+        parse();
         return (m_parseResult.reportMetadata.error == metaf::ReportError::NONE);
     }
 
@@ -106,6 +111,9 @@ public:
 private:
     Q_DISABLE_COPY_MOVE(Decoder)
 
+    // Runs the metaf parser, unless this has already been done
+    void parse() const;
+
     // Explanation functions
     static QString explainCloudType(const metaf::CloudType &ct);
     static QString explainDirection(metaf::Direction direction, bool trueCardinalDirections=true);
@@ -180,11 +188,15 @@ private:
     // Current weather, as read from METAR
     QString m_currentWeather;
 
+    // Raw text, as passed to the constructor
+    QString m_rawText;
+
     // Reference date
     QDate m_referenceDate;
 
-    // Result of the parser
-    ParseResult m_parseResult;
+    // Result of the parser, computed lazily by parse()
+    mutable bool m_parsed {false};
+    mutable ParseResult m_parseResult;
 };
 
 } // namespace Weather
@@ -26,95 +26,163 @@
 using namespace Qt::Literals::StringLiterals;
 
 
-Weather::METAR::METAR(QXmlStreamReader& xml)
+namespace {
+
+// Elements of the Aviation Weather Center's METAR format that are read
+enum class Element : quint8
+{
+    unknown,
+    altim_in_hg,
+    dewpoint_c,
+    elevation_m,
+    flight_category,
+    latitude,
+    longitude,
+    observation_time,
+    raw_text,
+    station_id,
+    temp_c,
+    wind_gust_kt,
+    wind_speed_kt
+};
+
+// Maps element names to the enum above. The switch on the name length leaves
+// at most two string comparisons per element, and no QString is allocated.
+Element element(QStringView name)
 {
-    while (true)
+    switch(name.size())
     {
-        xml.readNextStartElement();
-        QString const name = xml.name().toString();
-
-        // Read Station_ID
-        if (xml.isStartElement() && name == u"station_id"_s) {
-            m_ICAOCode = xml.readElementText();
-            continue;
+    case 6:
+        if (name == u"temp_c")
+        {
+            return Element::temp_c;
         }
-
-        // Read location
-        if (xml.isStartElement() && name == u"latitude"_s)
+        break;
+    case 8:
+        if (name == u"latitude")
         {
-            m_location.setLatitude(xml.readElementText().toDouble());
-            continue;
+            return Element::latitude;
         }
-        if (xml.isStartElement() && name == u"longitude"_s)
+        if (name == u"raw_text")
         {
-            m_location.setLongitude(xml.readElementText().toDouble());
-            continue;
+            return Element::raw_text;
         }
-        if (xml.isStartElement() && name == u"elevation_m"_s)
+        break;
+    case 9:
+        if (name == u"longitude")
         {
-            m_location.setAltitude(xml.readElementText().toDouble());
-            continue;
+            return Element::longitude;
         }
-
-        // Read raw text
-        if (xml.isStartElement() && name == u"raw_text"_s)
+        break;
+    case 10:
+        if (name == u"station_id")
         {
-            m_rawText = xml.readElementText();
-            continue;
+            return Element::station_id;
         }
-
-        // Read temperature
-        if (xml.isStartElement() && name == u"temp_c"_s)
+        if (name == u"dewpoint_c")
         {
-            m_temperature = Units::Temperature::fromDegreeCelsius(xml.readElementText().toDouble());
-            continue;
+            return Element::dewpoint_c;
         }
-
-        // Read dewpoint
-        if (xml.isStartElement() && name == u"dewpoint_c"_s)
+        break;
+    case 11:
+        if (name == u"elevation_m")
         {
-            m_dewpoint = Units::Temperature::fromDegreeCelsius(xml.readElementText().toDouble());
-            continue;
+            return Element::elevation_m;
+        }
+        if (name == u"altim_in_hg")
+        {
+            return Element::altim_in_hg;
+        }
+        break;
+    case 12:
+        if (name == u"wind_gust_kt")
+        {
+            return Element::wind_gust_kt;
+        }
+        break;
+    case 13:
+        if (name == u"wind_speed_kt")
+        {
+            return Element::wind_speed_kt;
+        }
+        break;
+    case 15:
+        if (name == u"flight_category")
+        {
+            return Element::flight_category;
+        }
+        break;
+    case 16:
+        if (name == u"observation_time")
+        {
+            return Element::observation_time;
         }
+        break;
+    default:
+        break;
+    }
+    return Element::unknown;
+}
+
+} // namespace
+
 
-        // QNH
-        if (xml.isStartElement() && name == u"altim_in_hg"_s)
+Weather::METAR::METAR(QXmlStreamReader& xml)
+{
+    // Read child elements until the end element of the METAR is reached
+    while (xml.readNextStartElement())
+    {
+        switch(element(xml.name()))
         {
-            auto content = xml.readElementText();
-            m_qnh = Units::Pressure::fromInHg(content.toDouble());
+        case Element::station_id:
+            m_ICAOCode = xml.readElementText();
+            break;
+
+        case Element::latitude:
+            m_location.setLatitude(xml.readElementText().toDouble());
+            break;
+
+        case Element::longitude:
+            m_location.setLongitude(xml.readElementText().toDouble());
+            break;
+
+        case Element::elevation_m:
+            m_location.setAltitude(xml.readElementText().toDouble());
+            break;
+
+        case Element::raw_text:
+            m_rawText = xml.readElementText();
+            break;
+
+        case Element::temp_c:
+            m_temperature = Units::Temperature::fromDegreeCelsius(xml.readElementText().toDouble());
+            break;
+
+        case Element::dewpoint_c:
+            m_dewpoint = Units::Temperature::fromDegreeCelsius(xml.readElementText().toDouble());
+            break;
+
+        case Element::altim_in_hg:
+            m_qnh = Units::Pressure::fromInHg(xml.readElementText().toDouble());
             if ((m_qnh.toHPa() < 800) || (m_qnh.toHPa() > 1200))
             {
                 m_qnh = Units::Pressure::fromPa(qQNaN());
             }
-            continue;
-        }
+            break;
 
-        // Wind
-        if (xml.isStartElement() && name == u"wind_speed_kt"_s)
-        {
-            auto content = xml.readElementText();
-            m_wind = Units::Speed::fromKN(content.toDouble());
-            continue;
-        }
+        case Element::wind_speed_kt:
+            m_wind = Units::Speed::fromKN(xml.readElementText().toDouble());
+            break;
 
-        // Gust
-        if (xml.isStartElement() && name == u"wind_gust_kt"_s)
-        {
-            auto content = xml.readElementText();
-            m_gust = Units::Speed::fromKN(content.toDouble());
-            continue;
-        }
+        case Element::wind_gust_kt:
+            m_gust = Units::Speed::fromKN(xml.readElementText().toDouble());
+            break;
 
-        // Observation Time
-        if (xml.isStartElement() && name == u"observation_time"_s)
-        {
-            auto content = xml.readElementText();
-            m_observationTime = QDateTime::fromString(content, Qt::ISODate);
-            continue;
-        }
+        case Element::observation_time:
+            m_observationTime = QDateTime::fromString(xml.readElementText(), Qt::ISODate);
+            break;
 
-        // Flight category
-        if (xml.isStartElement() && name == u"flight_category"_s)
+        case Element::flight_category:
         {
             auto content = xml.readElementText();
             if (content == u"VFR"_s) {
@@ -129,15 +197,13 @@ Weather::METAR::METAR(QXmlStreamReader& xml)
             if (content == u"LIFR"_s) {
                 m_flightCategory = LIFR;
             }
-            continue;
+            break;
         }
 
-        if (xml.isEndElement() && name == u"METAR"_s)
-        {
+        case Element::unknown:
+            xml.skipCurrentElement();
             break;
         }
-
-        xml.skipCurrentElement();
     }
 
     // Calculate density altitude
@@ -147,7 +213,8 @@ Weather::METAR::METAR(QXmlStreamReader& xml)
         m_densityAltitude = Weather::DensityAltitude::calculateDensityAltitude(m_temperature, m_qnh, altitude, m_dewpoint);
     }
 
-    // Interpret the METAR message
+    // Prepare interpretation of the METAR message. The metaf parser runs only
+    // once the decoded text is actually needed.
     m_decoder = QSharedPointer<Weather::Decoder>(new Weather::Decoder(m_rawText, m_observationTime.date()));
 }
 
@@ -181,6 +248,12 @@ QString Weather::METAR::flightCategoryColor() const
 
 
 bool Weather::METAR::isValid() const
+{
+    return isWellFormed() && m_decoder->isValid();
+}
+
+
+bool Weather::METAR::isWellFormed() const
 {
     if (m_ICAOCode.isEmpty())
     {
@@ -218,10 +291,6 @@ bool Weather::METAR::isValid() const
     {
         return false;
     }
-    if (!m_decoder->isValid())
-    {
-        return false;
-    }
 
     return true;
 }
@@ -224,11 +224,24 @@ public:
     }
 
     /*! \brief Getter function for property with the same name
+     *
+     * The raw text is decoded when this method is first called. Reports that
+     * the decoder cannot parse are not valid.
      *
      * @returns Property isValid
      */
     [[nodiscard]] bool isValid() const;
 
+    /*! \brief Check the data read from XML
+     *
+     * This method checks that all data required for a METAR report is present,
+     * without decoding the raw text. It is meant for code that handles large
+     * numbers of reports, most of which are never displayed.
+     *
+     * @returns True if all required data is present
+     */
+    [[nodiscard]] bool isWellFormed() const;
+
     /*! \brief Getter function for property with the same name
      *
      * @returns Property observationTime
@@ -23,70 +23,128 @@
 using namespace Qt::Literals::StringLiterals;
 
 
-Weather::TAF::TAF(QXmlStreamReader &xml)
+namespace {
+
+// Elements of the Aviation Weather Center's TAF format that are read
+enum class Element : quint8
 {
-    while (true)
+    unknown,
+    elevation_m,
+    issue_time,
+    latitude,
+    longitude,
+    raw_text,
+    station_id,
+    valid_time_to
+};
+
+// Maps element names to the enum above. The switch on the name length leaves
+// at most two string comparisons per element, and no QString is allocated.
+Element element(QStringView name)
+{
+    switch(name.size())
     {
-        xml.readNextStartElement();
-        QString const name = xml.name().toString();
-
-        // Read Station_ID
-        if (xml.isStartElement() && name == u"station_id"_s)
+    case 8:
+        if (name == u"latitude")
         {
-            m_ICAOCode = xml.readElementText();
-            continue;
+            return Element::latitude;
         }
-
-        // Read location
-        if (xml.isStartElement() && name == u"latitude"_s)
+        if (name == u"raw_text")
         {
-            m_location.setLatitude(xml.readElementText().toDouble());
-            continue;
+            return Element::raw_text;
         }
-        if (xml.isStartElement() && name == u"longitude"_s)
+        break;
+    case 9:
+        if (name == u"longitude")
         {
-            m_location.setLongitude(xml.readElementText().toDouble());
-            continue;
+            return Element::longitude;
         }
-        if (xml.isStartElement() && name == u"elevation_m"_s)
+        break;
+    case 10:
+        if (name == u"station_id")
         {
-            m_location.setAltitude(xml.readElementText().toDouble());
-            continue;
+            return Element::station_id;
         }
-
-        // Read raw text
-        if (xml.isStartElement() && name == u"raw_text"_s)
+        if (name == u"issue_time")
         {
-            m_rawText = xml.readElementText();
-            continue;
+            return Element::issue_time;
         }
-
-        // Read issue time
-        if (xml.isStartElement() && name == u"issue_time"_s)
+        break;
+    case 11:
+        if (name == u"elevation_m")
         {
-            m_issueTime = QDateTime::fromString(xml.readElementText(), Qt::ISODate);
-            continue;
+            return Element::elevation_m;
         }
-
-        // Read expiration date
-        if (xml.isStartElement() && name == u"valid_time_to"_s)
+        break;
+    case 13:
+        if (name == u"valid_time_to")
         {
-            m_expirationTime = QDateTime::fromString(xml.readElementText(), Qt::ISODate);
-            continue;
+            return Element::valid_time_to;
         }
+        break;
+    default:
+        break;
+    }
+    return Element::unknown;
+}
 
-        if (xml.isEndElement() && name == u"TAF"_s)
+} // namespace
+
+
+Weather::TAF::TAF(QXmlStreamReader &xml)
+{
+    // Read child elements until the end element of the TAF is reached
+    while (xml.readNextStartElement())
+    {
+        switch(element(xml.name()))
         {
+        case Element::station_id:
+            m_ICAOCode = xml.readElementText();
+            break;
+
+        case Element::latitude:
+            m_location.setLatitude(xml.readElementText().toDouble());
+            break;
+
+        case Element::longitude:
+            m_location.setLongitude(xml.readElementText().toDouble());
+            break;
+
+        case Element::elevation_m:
+            m_location.setAltitude(xml.readElementText().toDouble());
+            break;
+
+        case Element::raw_text:
+            m_rawText = xml.readElementText();
+            break;
+
+        case Element::issue_time:
+            m_issueTime = QDateTime::fromString(xml.readElementText(), Qt::ISODate);
             break;
-        }
 
-        xml.skipCurrentElement();
+        case Element::valid_time_to:
+            m_expirationTime = QDateTime::fromString(xml.readElementText(), Qt::ISODate);
+            break;
+
+        case Element::unknown:
+            xml.skipCurrentElement();
+            break;
+        }
     }
+
+    // Prepare interpretation of the TAF message. The metaf parser runs only
+    // once the decoded text is actually needed.
     m_decoder = QSharedPointer<Weather::Decoder>(new Weather::Decoder(m_rawText, m_issueTime.date().addDays(5)));
 }
 
 
 bool Weather::TAF::isValid() const
+{
+    return isWellFormed() && m_decoder->isValid();
+}
+
+
+bool Weather::TAF::isWellFormed() const
 {
     if (!m_expirationTime.isValid())
     {
@@ -108,10 +166,6 @@ bool Weather::TAF::isValid() const
     {
         return false;
     }
-    if (!m_decoder->isValid())
-    {
-        return false;
-    }
 
     return true;
 }
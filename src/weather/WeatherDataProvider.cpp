@@ -36,6 +36,9 @@ using namespace Qt::Literals::StringLiterals;
 
 Weather::WeatherDataProvider::WeatherDataProvider(QObject *parent) : QObject(parent)
 {
+    // Keep the index of stations with QNH up to date
+    m_METARsNotifier = m_METARs.addNotifier([this]() {updateQNHStations();});
+
     QTimer::singleShot(0, this, &Weather::WeatherDataProvider::deferredInitialization);
 }
 
@@ -82,7 +85,7 @@ void Weather::WeatherDataProvider::deleteExpiredMesages()
 {
     {
         auto tmpMETARs = m_METARs.value();
-        tmpMETARs.removeIf([](const std::pair<const QString&, METAR&>& pair) {return !pair.second.isValid();});
+        tmpMETARs.removeIf([](const std::pair<const QString&, METAR&>& pair) {return !pair.second.isWellFormed();});
         tmpMETARs.removeIf([](const std::pair<const QString&, METAR&>& pair) {return pair.second.expiration() < QDateTime::currentDateTime();});
         if (tmpMETARs.size() < m_METARs.value().size())
         {
@@ -92,7 +95,7 @@ void Weather::WeatherDataProvider::deleteExpiredMesages()
 
     {
         auto tmpTAFs = m_TAFs.value();
-        tmpTAFs.removeIf([](const std::pair<const QString&, TAF&>& pair) {return !pair.second.isValid();});
+        tmpTAFs.removeIf([](const std::pair<const QString&, TAF&>& pair) {return !pair.second.isWellFormed();});
         tmpTAFs.removeIf([](const std::pair<const QString&, TAF&>& pair) {return pair.second.expiration() < QDateTime::currentDateTime();});
         if (tmpTAFs.size() < m_TAFs.value().size())
         {
@@ -164,20 +167,20 @@ void Weather::WeatherDataProvider::downloadFinished()
             }
 
             // Read METAR
-            if (xml.isStartElement() && (xml.name() == QStringLiteral("METAR")))
+            if (xml.isStartElement() && (xml.name() == u"METAR"))
             {
                 Weather::METAR const metar(xml);
-                if (metar.isValid())
+                if (metar.isWellFormed())
                 {
                     newMETARs << metar;
                 }
             }
 
             // Read TAF
-            if (xml.isStartElement() && (xml.name() == QStringLiteral("TAF")))
+            if (xml.isStartElement() && (xml.name() == u"TAF"))
             {
                 Weather::TAF const taf(xml);
-                if (taf.isValid())
+                if (taf.isWellFormed())
                 {
                     newTAFs << taf;
                 }
@@ -231,6 +234,75 @@ void Weather::WeatherDataProvider::downloadFinished()
 }
 
 
+namespace {
+
+// Magic number and version of the file "weather.dat". Version 1 files hold a
+// single snapshot, version 2 files hold a sequence of records.
+constexpr quint32 weatherFileMagic = 0x31415;
+constexpr quint32 weatherFileVersion = 2;
+
+// Kinds of records in version 2 files. Later records override earlier ones.
+enum RecordKind : quint8
+{
+    UpdateLogRecord,
+    METARRecord,
+    TAFRecord,
+    METARRemovedRecord,
+    TAFRemovedRecord
+};
+
+// Decides whether two reports are the same. The defaulted operator== of METAR
+// and TAF cannot be used here: unset numerical fields are NaN, so a report
+// with any unset field never equals itself.
+bool sameReport(const Weather::METAR& a, const Weather::METAR& b)
+{
+    return (a.ICAOCode() == b.ICAOCode())
+           && (a.observationTime() == b.observationTime())
+           && (a.rawText() == b.rawText());
+}
+
+bool sameReport(const Weather::TAF& a, const Weather::TAF& b)
+{
+    return (a.ICAOCode() == b.ICAOCode())
+           && (a.issueTime() == b.issueTime())
+           && (a.rawText() == b.rawText());
+}
+
+// Returns the keys whose values differ between the maps. Both maps are sorted
+// by key, so this runs in linear time.
+template<typename T>
+QStringList changedKeys(const QMap<QString, T>& before, const QMap<QString, T>& after)
+{
+    QStringList result;
+    auto b = before.cbegin();
+    auto a = after.cbegin();
+    while ((b != before.cend()) || (a != after.cend()))
+    {
+        if ((a == after.cend()) || ((b != before.cend()) && (b.key() < a.key())))
+        {
+            result << b.key();
+            ++b;
+            continue;
+        }
+        if ((b == before.cend()) || (a.key() < b.key()))
+        {
+            result << a.key();
+            ++a;
+            continue;
+        }
+        if (!sameReport(a.value(), b.value()))
+        {
+            result << a.key();
+        }
+        ++a;
+        ++b;
+    }
+    return result;
+}
+
+} // namespace
+
+
 bool Weather::WeatherDataProvider::load()
 {
     auto stdFileName = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+"/weather.dat";
@@ -256,41 +328,132 @@ bool Weather::WeatherDataProvider::load()
     // Check magic number and version
     quint32 magic = 0;
     inputStream >> magic;
-    if (magic != static_cast<quint32>(0x31415))
+    if (magic != weatherFileMagic)
     {
         lockFile.unlock();
         return false;
     }
     quint32 version = 0;
     inputStream >> version;
-    if (version != static_cast<quint32>(1))
+
+    QMap<QString, Weather::METAR> newMETARs;
+    QMap<QString, Weather::TAF> newTAFs;
+    if (version == 1)
+    {
+        // Read snapshot. The file will be rewritten in the current format
+        // on the next save.
+        inputStream >> updateLog;
+        inputStream >> newMETARs;
+        inputStream >> newTAFs;
+        m_recordsInFile = std::numeric_limits<qsizetype>::max();
+    }
+    else if (version == weatherFileVersion)
+    {
+        // Read records. A record that is incomplete, for instance because the
+        // app was killed while appending, ends the file. It will be removed
+        // on the next save.
+        inputStream.setVersion(QDataStream::Qt_6_0);
+        m_recordsInFile = 0;
+        while (!inputStream.atEnd())
+        {
+            inputStream.startTransaction();
+            quint8 kind = 0;
+            QString ICAOCode;
+            inputStream >> kind;
+            switch(kind)
+            {
+            case UpdateLogRecord:
+            {
+                QList<updateLogEntry> newUpdateLog;
+                inputStream >> newUpdateLog;
+                if (inputStream.commitTransaction())
+                {
+                    updateLog = newUpdateLog;
+                }
+                break;
+            }
+            case METARRecord:
+            {
+                Weather::METAR metar;
+                inputStream >> ICAOCode >> metar;
+                if (inputStream.commitTransaction())
+                {
+                    newMETARs[ICAOCode] = metar;
+                }
+                break;
+            }
+            case TAFRecord:
+            {
+                Weather::TAF taf;
+                inputStream >> ICAOCode >> taf;
+                if (inputStream.commitTransaction())
+                {
+                    newTAFs[ICAOCode] = taf;
+                }
+                break;
+            }
+            case METARRemovedRecord:
+                inputStream >> ICAOCode;
+                if (inputStream.commitTransaction())
+                {
+                    newMETARs.remove(ICAOCode);
+                }
+                break;
+            case TAFRemovedRecord:
+                inputStream >> ICAOCode;
+                if (inputStream.commitTransaction())
+                {
+                    newTAFs.remove(ICAOCode);
+                }
+                break;
+            default:
+                inputStream.abortTransaction();
+                break;
+            }
+            if (inputStream.status() != QDataStream::Ok)
+            {
+                m_recordsInFile = std::numeric_limits<qsizetype>::max();
+                break;
+            }
+            m_recordsInFile++;
+        }
+    }
+    else
     {
         lockFile.unlock();
         return false;
     }
 
-    // Read time of last update
-    inputStream >> updateLog;
-
-    // Read file
-    QMap<QString, Weather::METAR> newMETARs;
-    inputStream >> newMETARs;
+    // Set data. Reports are not decoded here; this happens only once their
+    // text is displayed.
     m_METARs = newMETARs;
-
-    QMap<QString, Weather::TAF> newTAFs;
-    inputStream >> newTAFs;
     m_TAFs = newTAFs;
+    m_savedMETARs = newMETARs;
+    m_savedTAFs = newTAFs;
+    m_savedUpdateLog = updateLog;
 
     // Ok, done
     lockFile.unlock();
     deleteExpiredMesages();
 
-    return (inputStream.status() == QDataStream::Ok);
+    return (m_recordsInFile != std::numeric_limits<qsizetype>::max());
 }
 
 
 void Weather::WeatherDataProvider::save()
 {
+    // Find out what has changed since the last save. If nothing has changed,
+    // there is nothing to do.
+    const auto METARs = m_METARs.value();
+    const auto TAFs = m_TAFs.value();
+    const auto changedMETARs = changedKeys(m_savedMETARs, METARs);
+    const auto changedTAFs = changedKeys(m_savedTAFs, TAFs);
+    const bool updateLogChanged = (updateLog != m_savedUpdateLog);
+    if (changedMETARs.isEmpty() && changedTAFs.isEmpty() && !updateLogChanged)
+    {
+        return;
+    }
+
     auto stdFileName = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+"/weather.dat";
 
     // Use LockFile. If lock could not be obtained, do nothing.
@@ -300,28 +463,98 @@ void Weather::WeatherDataProvider::save()
         return;
     }
 
-    // Open file
-    auto outputFile = QSaveFile(stdFileName);
-    if (!outputFile.open(QIODevice::WriteOnly))
+    // If the file holds many outdated records, or does not exist, write a
+    // fresh file. Otherwise, append records for the changed stations.
+    auto numLiveRecords = METARs.size() + TAFs.size() + 1;
+    if ((m_recordsInFile > 2*numLiveRecords + 64) || !QFile::exists(stdFileName))
     {
-        lockFile.unlock();
-        return;
-    }
+        auto outputFile = QSaveFile(stdFileName);
+        if (!outputFile.open(QIODevice::WriteOnly))
+        {
+            lockFile.unlock();
+            return;
+        }
 
-    // Generate output stream
-    QDataStream outputStream(&outputFile);
-    outputStream.setVersion(QDataStream::Qt_4_0);
+        // Generate output stream
+        QDataStream outputStream(&outputFile);
+        outputStream.setVersion(QDataStream::Qt_4_0);
 
-    // Write magic number and version
-    outputStream << static_cast<quint32>(0x31415);
-    outputStream << static_cast<quint32>(1);
-    outputStream << updateLog;
+        // Write magic number and version
+        outputStream << weatherFileMagic;
+        outputStream << weatherFileVersion;
 
-    outputStream << m_METARs.value();
-    outputStream << m_TAFs.value();
+        // Write records
+        outputStream.setVersion(QDataStream::Qt_6_0);
+        outputStream << static_cast<quint8>(UpdateLogRecord) << updateLog;
+        for (auto i = METARs.cbegin(), end = METARs.cend(); i != end; ++i)
+        {
+            outputStream << static_cast<quint8>(METARRecord) << i.key() << i.value();
+        }
+        for (auto i = TAFs.cbegin(), end = TAFs.cend(); i != end; ++i)
+        {
+            outputStream << static_cast<quint8>(TAFRecord) << i.key() << i.value();
+        }
+        if (!outputFile.commit())
+        {
+            lockFile.unlock();
+            return;
+        }
+        m_recordsInFile = numLiveRecords;
+    }
+    else
+    {
+        auto outputFile = QFile(stdFileName);
+        if (!outputFile.open(QIODevice::WriteOnly|QIODevice::Append))
+        {
+            lockFile.unlock();
+            return;
+        }
 
-    outputFile.commit();
+        QDataStream outputStream(&outputFile);
+        outputStream.setVersion(QDataStream::Qt_6_0);
+        if (updateLogChanged)
+        {
+            outputStream << static_cast<quint8>(UpdateLogRecord) << updateLog;
+            m_recordsInFile++;
+        }
+        for(const auto& ICAOCode : changedMETARs)
+        {
+            if (METARs.contains(ICAOCode))
+            {
+                outputStream << static_cast<quint8>(METARRecord) << ICAOCode << METARs.value(ICAOCode);
+            }
+            else
+            {
+                outputStream << static_cast<quint8>(METARRemovedRecord) << ICAOCode;
+            }
+            m_recordsInFile++;
+        }
+        for(const auto& ICAOCode : changedTAFs)
+        {
+            if (TAFs.contains(ICAOCode))
+            {
+                outputStream << static_cast<quint8>(TAFRecord) << ICAOCode << TAFs.value(ICAOCode);
+            }
+            else
+            {
+                outputStream << static_cast<quint8>(TAFRemovedRecord) << ICAOCode;
+            }
+            m_recordsInFile++;
+        }
+        outputFile.close();
+        if (outputStream.status() != QDataStream::Ok)
+        {
+            // Force a full rewrite on the next save
+            m_recordsInFile = std::numeric_limits<qsizetype>::max();
+            lockFile.unlock();
+            return;
+        }
+    }
     lockFile.unlock();
+
+    m_savedMETARs = METARs;
+    m_savedTAFs = TAFs;
+    m_savedUpdateLog = updateLog;
 }
 
 
@@ -400,43 +633,67 @@ QString Weather::WeatherDataProvider::sunInfo()
 }
 
 
-Units::Pressure Weather::WeatherDataProvider::QNH() const
+Weather::METAR Weather::WeatherDataProvider::nearestMETARWithQNH() const
 {
-    // Paranoid safety checks
-    auto *positionProvider = GlobalObject::positionProvider();
-    if (positionProvider == nullptr)
+    if (m_QNHStations.isEmpty())
     {
         return {};
     }
 
-    // Find QNH of nearest airfield
-    METAR closestMETARWithQNH;
-    for (auto i = m_METARs.value().cbegin(), end = m_METARs.value().cend(); i != end; ++i)
+    // If the position is unknown, return the first station
+    QGeoCoordinate const here = Positioning::PositionProvider::lastValidCoordinate();
+    if (!here.isValid())
     {
-        if (!i.value().isValid())
-        {
-            continue;
-        }
-        if (!i.value().QNH().isFinite())
-        {
-            continue;
-        }
-        if (!i.value().coordinate().isValid())
-        {
-            continue;
-        }
-        if (!closestMETARWithQNH.isValid()) {
-            closestMETARWithQNH = i.value();
-            continue;
-        }
+        return m_METARs.value().value(m_QNHStations.constFirst().ICAOCode);
+    }
+
+    // Check cache
+    QPoint const cell(qFloor(here.latitude()/QNHCacheCellSize), qFloor(here.longitude()/QNHCacheCellSize));
+    if (!m_nearestQNHStation.isEmpty() && (cell == m_nearestQNHCell))
+    {
+        return m_METARs.value().value(m_nearestQNHStation);
+    }
+
+    // Find nearest station. For points on the unit sphere, the great-circle
+    // distance decreases as the scalar product increases, so that no
+    // trigonometric functions need to be evaluated per station.
+    auto lat = qDegreesToRadians(here.latitude());
+    auto lon = qDegreesToRadians(here.longitude());
+    auto x = qCos(lat)*qCos(lon);
+    auto y = qCos(lat)*qSin(lon);
+    auto z = qSin(lat);
 
-        QGeoCoordinate const here = Positioning::PositionProvider::lastValidCoordinate();
-        if (here.distanceTo(i.value().coordinate()) < here.distanceTo(closestMETARWithQNH.coordinate()))
+    const QNHStation* nearest = nullptr;
+    double bestProduct = -2.0;
+    for(const auto& station : m_QNHStations)
+    {
+        auto product = x*station.x + y*station.y + z*station.z;
+        if (product > bestProduct)
         {
-            closestMETARWithQNH = i.value();
+            bestProduct = product;
+            nearest = &station;
         }
     }
-    if (closestMETARWithQNH.isValid())
+
+    m_nearestQNHCell = cell;
+    m_nearestQNHStation = nearest->ICAOCode;
+    return m_METARs.value().value(m_nearestQNHStation);
+}
+
+
+Units::Pressure Weather::WeatherDataProvider::QNH() const
+{
+    // Paranoid safety checks
+    auto *positionProvider = GlobalObject::positionProvider();
+    if (positionProvider == nullptr)
+    {
+        return {};
+    }
+
+    // Find QNH of nearest airfield. The QNH comes from the XML data, so the
+    // raw text of the report need not be decodable.
+    auto closestMETARWithQNH = nearestMETARWithQNH();
+    if (closestMETARWithQNH.isWellFormed())
     {
         return closestMETARWithQNH.QNH();
     }
@@ -453,35 +710,10 @@ QString Weather::WeatherDataProvider::QNHInfo() const
         return {};
     }
 
-    // Find QNH of nearest airfield
-    METAR closestMETARWithQNH;
-    for (auto i = m_METARs.value().cbegin(), end = m_METARs.value().cend(); i != end; ++i)
-    {
-        if (!i.value().isValid())
-        {
-            continue;
-        }
-        if (!i.value().QNH().isFinite())
-        {
-            continue;
-        }
-        if (!i.value().coordinate().isValid())
-        {
-            continue;
-        }
-        if (!closestMETARWithQNH.isValid()) {
-            closestMETARWithQNH = i.value();
-            continue;
-        }
-
-        QGeoCoordinate const here = Positioning::PositionProvider::lastValidCoordinate();
-        if (here.distanceTo(i.value().coordinate()) < here.distanceTo(closestMETARWithQNH.coordinate()))
-        {
-            closestMETARWithQNH = i.value();
-        }
-    }
-
-    if (closestMETARWithQNH.isValid())
+    // Find QNH of nearest airfield. The QNH comes from the XML data, so the
+    // raw text of the report need not be decodable.
+    auto closestMETARWithQNH = nearestMETARWithQNH();
+    if (closestMETARWithQNH.isWellFormed())
     {
         return tr("%1 hPa in %2, %3").arg(qRound(closestMETARWithQNH.QNH().toHPa()))
         .arg(closestMETARWithQNH.ICAOCode(),
@@ -611,6 +843,35 @@ void Weather::WeatherDataProvider::startDownload(const QGeoRectangle& _bBox)
 }
 
 
+void Weather::WeatherDataProvider::updateQNHStations()
+{
+    m_QNHStations.clear();
+    m_nearestQNHStation.clear();
+
+    const auto METARs = m_METARs.value();
+    for (auto i = METARs.cbegin(), end = METARs.cend(); i != end; ++i)
+    {
+        if (!i.value().isWellFormed())
+        {
+            continue;
+        }
+        if (!i.value().QNH().isFinite())
+        {
+            continue;
+        }
+        auto coordinate = i.value().coordinate();
+        if (!coordinate.isValid())
+        {
+            continue;
+        }
+
+        auto lat = qDegreesToRadians(coordinate.latitude());
+        auto lon = qDegreesToRadians(coordinate.longitude());
+        m_QNHStations.append({qCos(lat)*qCos(lon), qCos(lat)*qSin(lon), qSin(lat), i.key()});
+    }
+}
+
+
 QDataStream& Weather::operator<<(QDataStream& stream, const WeatherDataProvider::updateLogEntry& ule)
 {
     stream << ule.m_time;
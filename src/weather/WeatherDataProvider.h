@@ -21,9 +21,12 @@
 #pragma once
 
 #include <QGeoRectangle>
+#include <QPoint>
 #include <QProperty>
 #include <QTimer>
 
+#include <limits>
+
 #include "GlobalObject.h"
 #include "geomaps/Waypoint.h"
 #include "navigation/Atmosphere.h"
@@ -264,12 +267,24 @@ private:
     // Returns true on success and false on failure.
     bool load();
 
-    // This method saves all METAR/TAFs that are valid and not yet expired to a
-    // file "weather.dat" in QStandardPaths::AppDataLocation.  There is locking
-    // to ensure that no two processes access the file. The method will fail
-    // silently on error.
+    // This method saves METAR/TAFs to a file "weather.dat" in
+    // QStandardPaths::AppDataLocation.  There is locking to ensure that no two
+    // processes access the file. The method will fail silently on error.
+    //
+    // The file is a sequence of records. Only records for stations that have
+    // changed since the last save are appended; the method does nothing if
+    // nothing has changed. The file is rewritten from scratch once it holds
+    // too many outdated records.
     void save();
 
+    // Returns the METAR of the station with QNH that is closest to the last
+    // valid position, or an invalid METAR if there is none. Results are cached
+    // per cell of size QNHCacheCellSize.
+    [[nodiscard]] METAR nearestMETARWithQNH() const;
+
+    // Rebuilds m_QNHStations. This method is called whenever m_METARs changes.
+    void updateQNHStations();
+
     // List of replies from aviationweather.com
     QList<QPointer<QNetworkReply>> m_networkReplies;
 
@@ -282,14 +297,43 @@ private:
     // METARs and TAFs by ICAO Code
     QProperty<QMap<QString, Weather::METAR>> m_METARs;
     QProperty<QMap<QString, Weather::TAF>> m_TAFs;
+    QPropertyNotifier m_METARsNotifier;
+
+    // Index of all stations with valid METAR, QNH and coordinate. Coordinates
+    // are stored as unit vectors in Earth-centered coordinates.
+    struct QNHStation
+    {
+        double x {0.0};
+        double y {0.0};
+        double z {0.0};
+        QString ICAOCode;
+    };
+    QList<QNHStation> m_QNHStations;
+
+    // Cache for nearestMETARWithQNH(). The cache is invalid if
+    // m_nearestQNHStation is empty. Cell size in degrees.
+    static constexpr double QNHCacheCellSize = 0.05;
+    mutable QPoint m_nearestQNHCell;
+    mutable QString m_nearestQNHStation;
 
     // Time and BBox of the last succesful METAR update for the current region and flight route
     struct updateLogEntry
     {
         QDateTime m_time;
         QGeoRectangle m_bBox;
+
+        bool operator==(const updateLogEntry& other) const = default;
     };
     QList<updateLogEntry> updateLog;
+
+    // Data as last written to or read from "weather.dat", used by save() to
+    // find the changes that need to be written
+    QMap<QString, Weather::METAR> m_savedMETARs;
+    QMap<QString, Weather::TAF> m_savedTAFs;
+    QList<updateLogEntry> m_savedUpdateLog;
+
+    // Number of records in "weather.dat"
+    qsizetype m_recordsInFile {std::numeric_limits<qsizetype>::max()};
 };
 
 QDataStream& operator<<(QDataStream& stream, const WeatherDataProvider::updateLogEntry& ule);